@@ -0,0 +1,761 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	arch
+ *
+ * @Description: Compressed output archive
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <sys/stat.h>
+
+#include "arch.h"
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+/* Parses a duration, in comm.c */
+long parse_since(char *str);
+
+/* Block waiting to be compressed */
+typedef struct ablock {
+	char		*buf;
+	int		len;
+	long long	first;
+	long long	last;
+} ablock;
+
+/* Archive directory, archiving is off if NULL */
+char *arch_dir = NULL;
+
+static long long arch_size = (long long)ARCH_SIZE << 20;
+static long arch_age = ARCH_AGE;
+
+/* Block being filled by the main loop */
+static char *fill = NULL;
+static int used = 0;
+static long long first, last;
+
+/* Handed over to the thread */
+static ablock queue[ARCH_QUEUE];
+static int qhead = 0, qcount = 0, busy = 0, stop = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t more = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;
+static pthread_t worker;
+
+/* File being written by the thread, opened is the time of its first line */
+static int seq = 0, fd = -1, ifd = -1;
+static long long off = 0, opened = 0;
+
+/*
+ * arch_path
+ *
+ * Builds path of archive file seq, ext being gz or idx.
+ *
+ */
+
+static void arch_path(char *path, int size, int n, char *ext) {
+
+	snprintf(path, size, "%s/%08d.%s", arch_dir, n, ext);
+
+}
+
+/*
+ * scan
+ *
+ * Finds oldest and newest files in archive. Returns 0 if there are none.
+ *
+ */
+
+static int scan(int *lo, int *hi) {
+
+	DIR *d;
+	struct dirent *e;
+	char ext[8];
+	int n, found = 0;
+
+	if ((d = opendir(arch_dir)) == NULL) return 0;
+
+	while ((e = readdir(d))) {
+
+		if (sscanf(e->d_name, "%d.%7s", &n, ext) != 2 || strcmp(ext, "idx")) continue;
+
+		if (!found || n < *lo) *lo = n;
+		if (!found || n > *hi) *hi = n;
+
+		found = 1;
+
+	}
+
+	closedir(d);
+
+	return found;
+
+}
+
+/*
+ * open_file
+ *
+ * Opens current file and its index for appending. Returns 0 on success, -1
+ * with neither open otherwise.
+ *
+ */
+
+static int open_file() {
+
+	char path[512];
+	struct stat st;
+	aidx rec;
+
+	arch_path(path, sizeof(path), seq, "gz");
+	fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+	arch_path(path, sizeof(path), seq, "idx");
+	ifd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+	if (fd == -1 || ifd == -1) {
+
+		if (fd != -1) close(fd);
+		if (ifd != -1) close(ifd);
+
+		fd = ifd = -1;
+		return -1;
+
+	}
+
+	off = !fstat(fd, &st) ? st.st_size : 0;
+
+	/* Carrying on with a file, its age runs from its first block */
+	if (pread(ifd, &rec, sizeof(aidx), 0) == sizeof(aidx)) opened = rec.first;
+
+	return 0;
+
+}
+
+/*
+ * rotate
+ *
+ * Starts next file, removing the one ARCH_KEEP back. If it can't be opened,
+ * put tries again with the next block.
+ *
+ */
+
+static void rotate() {
+
+	char path[512];
+
+	close(fd);
+	close(ifd);
+
+	seq++;
+	off = 0;
+
+	if (seq >= ARCH_KEEP) {
+
+		arch_path(path, sizeof(path), seq - ARCH_KEEP, "gz");
+		unlink(path);
+		arch_path(path, sizeof(path), seq - ARCH_KEEP, "idx");
+		unlink(path);
+
+	}
+
+	open_file();
+
+}
+
+/*
+ * put
+ *
+ * Compresses block into a gzip member of its own, appends it to current file
+ * and indexes it. Runs on the thread.
+ *
+ */
+
+static void put(ablock *b) {
+
+	z_stream z;
+	aidx rec;
+	char *out;
+	int bound;
+
+	memset(&z, 0, sizeof(z));
+
+	/* 31 asks for a gzip header and trailer */
+	if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return;
+
+	bound = deflateBound(&z, b->len);
+
+	if (!(out = malloc(bound))) {
+
+		deflateEnd(&z);
+		return;
+
+	}
+
+	z.next_in = (unsigned char *)b->buf;
+	z.avail_in = b->len;
+	z.next_out = (unsigned char *)out;
+	z.avail_out = bound;
+
+	deflate(&z, Z_FINISH);
+	deflateEnd(&z);
+
+	/* Current file is full or too old */
+	if (off && (off >= arch_size || b->first - opened >= arch_age)) rotate();
+
+	/* File that could not be opened, block is lost if it still can't */
+	if (fd == -1 && open_file()) {
+
+		mstat.arch_dropped++;
+		free(out);
+		return;
+
+	}
+
+	if (!off) opened = b->first;
+
+	rec.first = b->first;
+	rec.last = b->last;
+	rec.off = off;
+	rec.clen = z.total_out;
+	rec.ulen = b->len;
+
+	/* Index only points at blocks written whole */
+	if (write(fd, out, rec.clen) == rec.clen) {
+
+		write(ifd, &rec, sizeof(aidx));
+
+		off += rec.clen;
+		mstat.arch_out += rec.clen;
+
+	} else mstat.arch_dropped++;
+
+	free(out);
+
+}
+
+/*
+ * run
+ *
+ * Body of the thread, compresses blocks as they are handed over until told
+ * to stop and none are left.
+ *
+ */
+
+static void* run(void *arg) {
+
+	ablock b;
+
+	pthread_mutex_lock(&lock);
+
+	while (1) {
+
+		while (!qcount && !stop) pthread_cond_wait(&more, &lock);
+
+		if (!qcount) break;
+
+		b = queue[qhead];
+		qhead = (qhead + 1) % ARCH_QUEUE;
+		qcount--;
+		busy = 1;
+
+		pthread_mutex_unlock(&lock);
+
+		put(&b);
+		free(b.buf);
+
+		pthread_mutex_lock(&lock);
+
+		busy = 0;
+		pthread_cond_broadcast(&idle);
+
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+
+}
+
+/*
+ * handover
+ *
+ * Queues block being filled for the thread and starts a new one. Drops it if
+ * the thread is too far behind.
+ *
+ */
+
+static void handover() {
+
+	char *next;
+
+	if (!used) return;
+
+	if (!(next = malloc(ARCH_BLOCK))) return;
+
+	pthread_mutex_lock(&lock);
+
+	if (qcount == ARCH_QUEUE) {
+
+		pthread_mutex_unlock(&lock);
+
+		free(next);
+		mstat.arch_dropped++;
+		used = 0;
+
+		return;
+
+	}
+
+	queue[(qhead + qcount) % ARCH_QUEUE] = (ablock){fill, used, first, last};
+	qcount++;
+
+	pthread_cond_signal(&more);
+	pthread_mutex_unlock(&lock);
+
+	fill = next;
+	used = 0;
+
+}
+
+/*
+ * sync_archive
+ *
+ * Hands over block being filled and waits until the thread wrote everything.
+ *
+ */
+
+static void sync_archive() {
+
+	handover();
+
+	pthread_mutex_lock(&lock);
+
+	while (qcount || busy) pthread_cond_wait(&idle, &lock);
+
+	pthread_mutex_unlock(&lock);
+
+}
+
+/*
+ * arch_init
+ *
+ * Parses spec, a directory then optionally size in MB and age, creates the
+ * directory, carries on with its newest file and starts the thread, which
+ * never takes signals. Returns 0 on success, -1 with error set otherwise.
+ *
+ */
+
+int arch_init(char *spec) {
+
+	char *dir = strdup(spec), *size, *age = NULL, *end;
+	sigset_t all, old;
+	int lo, hi;
+	long n;
+
+	if ((size = strchr(dir, ','))) {
+
+		*size++ = 0;
+
+		if ((age = strchr(size, ','))) *age++ = 0;
+
+		n = strtol(size, &end, 10);
+
+		if (end == size || *end || n <= 0) {
+
+			sprintf(errstr, "ERROR: Archive must be <dir>[,<size MB>[,<age>]].");
+			return -1;
+
+		}
+
+		arch_size = (long long)n << 20;
+
+	}
+
+	if (age && (arch_age = parse_since(age)) <= 0) {
+
+		sprintf(errstr, "ERROR: Archive must be <dir>[,<size MB>[,<age>]].");
+		return -1;
+
+	}
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: Could not create archive directory '%s'.", dir);
+		return -1;
+
+	}
+
+	arch_dir = dir;
+
+	if (scan(&lo, &hi)) seq = hi;
+
+	if (open_file() || !(fill = malloc(ARCH_BLOCK))) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: Could not open archive in '%s'.", dir);
+		arch_dir = NULL;
+		return -1;
+
+	}
+
+	/* Thread inherits the mask, clock and child signals stay on the main loop */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	pthread_create(&worker, NULL, run, NULL);
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	return 0;
+
+}
+
+/*
+ * arch_write
+ *
+ * Adds line logged by process to block being filled, stamped with time and
+ * pid, handing block over first if line doesn't fit.
+ *
+ */
+
+void arch_write(pnode *proc, char *line, int len) {
+
+	long long now;
+	int n;
+
+	if (!arch_dir) return;
+
+	now = time(NULL);
+
+	if (used + len + 32 > ARCH_BLOCK) handover();
+
+	if (!used) first = now;
+	last = now;
+
+	n = snprintf(fill + used, 32, "%lld %d ", now, proc->pid);
+
+	memcpy(fill + used + n, line, len);
+
+	used += n + len;
+	mstat.arch_in += n + len;
+
+}
+
+/*
+ * arch_tick
+ *
+ * Hands over block being filled once its first line is ARCH_FLUSH old, so
+ * little output still reaches the archive soon.
+ *
+ */
+
+void arch_tick() {
+
+	if (arch_dir && used && time(NULL) - first >= ARCH_FLUSH) handover();
+
+}
+
+/*
+ * arch_timeout
+ *
+ * Returns ms until block being filled is due to be handed over, -1 if it is
+ * empty, so sleeping doesn't keep it back.
+ *
+ */
+
+int arch_timeout() {
+
+	long long left;
+
+	if (!arch_dir || !used) return -1;
+
+	left = first + ARCH_FLUSH - time(NULL);
+
+	return left > 0 ? left * 1000 : 0;
+
+}
+
+/*
+ * arch_close
+ *
+ * Hands over last block, lets the thread write everything and waits for it.
+ *
+ */
+
+void arch_close() {
+
+	if (!arch_dir) return;
+
+	handover();
+
+	pthread_mutex_lock(&lock);
+
+	stop = 1;
+	pthread_cond_signal(&more);
+
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(worker, NULL);
+
+	close(fd);
+	close(ifd);
+
+	arch_dir = NULL;
+
+}
+
+/*
+ * open_seq
+ *
+ * Opens file of cursor and its index for reading. Returns 0 on success.
+ *
+ */
+
+static int open_seq(acursor *cur) {
+
+	char path[512];
+	struct stat st;
+
+	if (cur->fd != -1) close(cur->fd);
+	if (cur->ifd != -1) close(cur->ifd);
+
+	cur->blk = cur->nblk = 0;
+
+	arch_path(path, sizeof(path), cur->seq, "gz");
+	cur->fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	arch_path(path, sizeof(path), cur->seq, "idx");
+	cur->ifd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (cur->fd == -1 || cur->ifd == -1) return -1;
+
+	cur->nblk = !fstat(cur->ifd, &st) ? st.st_size / sizeof(aidx) : 0;
+
+	return 0;
+
+}
+
+/*
+ * load
+ *
+ * Inflates next block of cursor, moving on to next file as needed. Returns
+ * -1 once past the last file or until.
+ *
+ */
+
+static int load(acursor *cur) {
+
+	z_stream z;
+	aidx rec;
+	char *in;
+
+	while (cur->blk >= cur->nblk) {
+
+		if (cur->seq >= cur->last_seq) return -1;
+
+		cur->seq++;
+		open_seq(cur);
+
+	}
+
+	if (pread(cur->ifd, &rec, sizeof(aidx), cur->blk++ * sizeof(aidx)) != sizeof(aidx))
+		return -1;
+
+	if (rec.first > cur->until) return -1;
+
+	cur->len = cur->pos = 0;
+
+	if (rec.ulen > ARCH_BLOCK || !(in = malloc(rec.clen))) return 0;
+
+	memset(&z, 0, sizeof(z));
+
+	if (pread(cur->fd, in, rec.clen, rec.off) == rec.clen &&
+			inflateInit2(&z, 31) == Z_OK) {
+
+		z.next_in = (unsigned char *)in;
+		z.avail_in = rec.clen;
+		z.next_out = (unsigned char *)cur->data;
+		z.avail_out = ARCH_BLOCK;
+
+		/* A damaged block reads as empty */
+		if (inflate(&z, Z_FINISH) == Z_STREAM_END) cur->len = z.total_out;
+
+		inflateEnd(&z);
+
+	}
+
+	free(in);
+
+	return 0;
+
+}
+
+/*
+ * arch_find
+ *
+ * Writes out everything archived so far, then finds the first file holding
+ * lines at or after since and binary searches its index for the first block
+ * reaching since. Returns 0 on success, -1 if there is no archive or nothing
+ * was logged in range.
+ *
+ */
+
+int arch_find(acursor *cur, long long since, long long until) {
+
+	long lo, hi, mid;
+	int first_seq, last_seq;
+	aidx rec;
+
+	memset(cur, 0, sizeof(acursor));
+
+	cur->fd = cur->ifd = -1;
+	cur->since = since;
+	cur->until = until;
+
+	if (!arch_dir) return -1;
+
+	sync_archive();
+
+	if (!scan(&first_seq, &last_seq) || !(cur->data = malloc(ARCH_BLOCK))) return -1;
+
+	cur->last_seq = last_seq;
+
+	for (cur->seq = first_seq; cur->seq <= last_seq; cur->seq++) {
+
+		if (open_seq(cur) || !cur->nblk) continue;
+
+		/* Whole file is older */
+		if (pread(cur->ifd, &rec, sizeof(aidx), (cur->nblk - 1) * sizeof(aidx)) != sizeof(aidx)
+				|| rec.last < since)
+			continue;
+
+		/* First block with last >= since */
+		for (lo = 0, hi = cur->nblk - 1; lo < hi; ) {
+
+			mid = (lo + hi) / 2;
+
+			if (pread(cur->ifd, &rec, sizeof(aidx), mid * sizeof(aidx)) != sizeof(aidx)) break;
+
+			if (rec.last < since) lo = mid + 1;
+			else hi = mid;
+
+		}
+
+		pread(cur->ifd, &rec, sizeof(aidx), lo * sizeof(aidx));
+
+		if (rec.first > until) break;
+
+		cur->blk = lo;
+
+		return 0;
+
+	}
+
+	arch_end(cur);
+
+	return -1;
+
+}
+
+/*
+ * arch_gets
+ *
+ * Reads next line in range, formatted with its time and pid.
+ *
+ */
+
+char* arch_gets(acursor *cur, char *buf, int size) {
+
+	char *line, *end, stamp[16];
+	long long sec;
+	int pid, n, skip;
+	time_t t;
+
+	while (cur->data) {
+
+		if (cur->pos >= cur->len) {
+
+			if (load(cur)) return NULL;
+			continue;
+
+		}
+
+		line = cur->data + cur->pos;
+		end = memchr(line, '\n', cur->len - cur->pos);
+		n = end ? end - line + 1 : cur->len - cur->pos;
+
+		cur->pos += n;
+
+		if (sscanf(line, "%lld %d%n", &sec, &pid, &skip) != 2 || sec < cur->since) continue;
+
+		if (sec > cur->until) return NULL;
+
+		t = sec;
+		strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&t));
+
+		snprintf(buf, size, "%s %6d %.*s", stamp, pid, n - skip - 1, line + skip + 1);
+
+		return buf;
+
+	}
+
+	return NULL;
+
+}
+
+/*
+ * arch_end
+ *
+ * Closes archive opened by arch_find.
+ *
+ */
+
+void arch_end(acursor *cur) {
+
+	if (cur->fd != -1) close(cur->fd);
+	if (cur->ifd != -1) close(cur->ifd);
+
+	free(cur->data);
+
+	cur->fd = cur->ifd = -1;
+	cur->data = NULL;
+
+}
+
+/*
+ * arch_status
+ *
+ * Formats number of files, bytes archived before and after compression, and
+ * blocks dropped into buf.
+ *
+ */
+
+char* arch_status(char *buf, int size) {
+
+	int lo = 0, hi = -1;
+
+	scan(&lo, &hi);
+
+	snprintf(buf, size, "%d files, %lu KB in, %lu KB out (%.1fx), %lu blocks dropped.",
+			hi - lo + 1, mstat.arch_in >> 10, mstat.arch_out >> 10,
+			mstat.arch_out ? (double)mstat.arch_in / mstat.arch_out : 0.0,
+			mstat.arch_dropped);
+
+	return buf;
+
+}
+
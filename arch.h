@@ -0,0 +1,123 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	arch.h
+ *
+ * @Description: Output archive. With -A, every line processes log, from all of
+ * 		them, is stamped with the time and pid and packed into blocks
+ * 		of ARCH_BLOCK bytes, instead of only going through the output
+ * 		window. A full block, or one ARCH_FLUSH seconds old, is handed
+ * 		to a thread of its own, which compresses it and appends it to
+ * 		the current archive file, <seq>.gz in the archive directory,
+ * 		so the main loop never waits on zlib or the disk. Each block
+ * 		is a gzip member of its own, so zcat reads a whole file.
+ *
+ * 		A new file is started once the current one reaches size, or
+ * 		is older than age, and only the last ARCH_KEEP are kept.
+ *
+ * 		Next to every file, <seq>.idx holds a fixed size record per
+ * 		block giving the time of its first and last lines and where it
+ * 		sits in the file. Reading back a time range binary searches the
+ * 		index and only inflates the blocks overlapping it.
+ *
+ * 		Blocks are dropped, and counted, if the thread falls more than
+ * 		ARCH_QUEUE behind, or if the archive file can't be opened or
+ * 		written. Opening is tried again with every block.
+ *
+ * @Constants:
+ *
+ * 	ARCH_BLOCK	Block size before compression
+ *
+ * 	ARCH_QUEUE	Most blocks waiting to be compressed
+ *
+ * 	ARCH_FLUSH	Seconds before a block is handed over even if not full
+ *
+ * 	ARCH_SIZE	Default file size in MB
+ *
+ * 	ARCH_AGE	Default file age in seconds
+ *
+ * 	ARCH_KEEP	Files kept
+ *
+ * @Functions:
+ *
+ * 	arch_init	Parses directory, size and age, like logs,64,1h, and
+ * 			starts the thread. Returns 0 on success, -1 with
+ * 			error set otherwise.
+ *
+ * 	arch_write	Adds a line logged by a process.
+ *
+ * 	arch_tick	Hands over block once old enough.
+ *
+ * 	arch_timeout	Returns ms until block is due, -1 if there is none.
+ *
+ * 	arch_close	Hands over last block and waits for the thread.
+ *
+ * 	arch_find	Opens archive at first line logged at or after since,
+ * 			up to until (seconds since epoch). Returns 0 on
+ * 			success.
+ *
+ * 	arch_gets	Reads next line of an opened archive, with its time
+ * 			and pid. Returns NULL past until.
+ *
+ * 	arch_end	Closes an opened archive.
+ *
+ * 	arch_status	Formats files and bytes in and out.
+ *
+ */
+
+#define __arch_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define ARCH_BLOCK	65536
+#define ARCH_QUEUE	16
+#define ARCH_FLUSH	5
+#define ARCH_SIZE	64
+#define ARCH_AGE	3600
+#define ARCH_KEEP	24
+
+/* Index record */
+typedef struct aidx {
+	long long	first;
+	long long	last;
+	long long	off;
+	int		clen;
+	int		ulen;
+} aidx;
+
+/* Archive being read */
+typedef struct acursor {
+	long long	since;
+	long long	until;
+	int		seq;
+	int		last_seq;
+	int		blk;
+	int		nblk;
+	int		ifd;
+	int		fd;
+	char		*data;
+	int		len;
+	int		pos;
+} acursor;
+
+extern char *arch_dir;
+
+int arch_init(char *spec);
+
+void arch_write(pnode *proc, char *line, int len);
+
+void arch_tick();
+
+int arch_timeout();
+
+void arch_close();
+
+int arch_find(acursor *cur, long long since, long long until);
+
+char* arch_gets(acursor *cur, char *buf, int size);
+
+void arch_end(acursor *cur);
+
+char* arch_status(char *buf, int size);
+
@@ -6,164 +6,646 @@
  *
  */
 
+#include <unistd.h>
+
 #include "comm.h"
 
+/* Command line being executed, kept for recording */
+static char cmdline[sizeof(comm)];
+
+/* Logs a line and shows windows, in ui.c */
+void history_add(char *buffer);
+void show_help();
+void show_log(int pid, long long since);
+void show_archive(long long since, long long until);
+void end_ncurses();
+
 /*
- * validate_command()
- *
- * Compares args[0] to list of valid commands.
- *
- * Returns a constant corresponding to the command code or -1 if an error occured
+ * Command handlers
  *
  */
 
-int validate_command() {
+static int cmd_spawn(int argc, char **argv) {
 
-	char cb[64] = {0};
-	int i = 0;
+	int count = argc > 2 ? atoi(argv[2]) : 1, pid = -1;
 
-	/* Iterate through and put command in cb in lowercase */
-	while (args[0][i] != 0) {
+	/* Max length is 8 characters */
+	if (strlen(argv[1]) > 8) {
+
+		sprintf(errstr, "ERROR: Maximum process name length is 8 characters");
+		return -1;
 
-		cb[i] = tolower(args[0][i]);
-		i++;
-	
 	}
 
-	/* Return appropriate constant */
-	if (!strcmp(cb, "spawn")) return SPAWN;
-	
-	else if (!strcmp(cb, "exec")) return EXEC;
-	
-	else if (!strcmp(cb, "block")) return BLOCK;
+	if (count < 1) {
 
-	else if (!strcmp(cb, "run")) return RUN;
+		sprintf(errstr, "ERROR: Invalid count \"%s\".", argv[2]);
+		return -1;
 
-	else if (!strcmp(cb, "kill")) return KILL;
-	
-	else if (!strcmp(cb, "help")) return HELP;
-	
-	else if (!strcmp(cb, "quit")) return QUIT;
-	
-	else return -1;
+	}
+
+	while (count-- && (pid = spawn_process(argv[1])) != -1);
+
+	return pid;
+
+}
+
+static int cmd_exec(int argc, char **argv) {
+
+	if (access(argv[1], X_OK)) {
+
+		sprintf(errstr, "ERROR: Could not find executable '%s'.", argv[1]);
+		return -1;
+
+	}
+
+	return exec_process(argv + 1);
+
+}
+
+static int cmd_kill(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+
+	if (!proc) return -1;
+
+	kill_node(proc);
+
+	return 0;
+
+}
+
+static int cmd_block(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+
+	if (!proc) return -1;
+
+	/* Blocked until run */
+	if (argc == 2) {
+
+		block_node(proc);
+		return 0;
+
+	}
+
+	if (argc != 4) {
+
+		sprintf(errstr, "ERROR: Event needs an argument.");
+		return -1;
+
+	}
+
+	if (sim_mode) {
+
+		sprintf(errstr, "ERROR: Events are not simulated.");
+		return -1;
+
+	}
+
+	return event_block(proc, argv[2], argv[3]);
+
+}
+
+static int cmd_run(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+
+	if (!proc) return -1;
+
+	run_node(proc);
+
+	return 0;
+
+}
+
+static int cmd_throttle(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+	char *end;
+	long budget = -1;
+
+	if (!proc) return -1;
+
+	/* Budget must be a number and policy drop or sample */
+	if (argc > 2 && ((budget = strtol(argv[2], &end, 10)) < 0 || *end)) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid number.", argv[2]);
+		return -1;
+
+	} else if (argc > 3 && strcmp(argv[3], "drop") && strcmp(argv[3], "sample")) {
+
+		sprintf(errstr, "ERROR: Policy must be drop or sample.");
+		return -1;
+
+	}
+
+	throttle_process(proc->pid, budget, 
+			argc > 3 && !strcmp(argv[3], "sample") ? OUT_SAMPLING : OUT_DROP);
+
+	return 0;
+
+}
+
+static int cmd_prio(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+	char *end;
+	long prio;
+
+	if (!proc) return -1;
+
+	/* Show priority */
+	if (argc == 2) {
 
+		sprintf(errstr, "Process %d: priority %d, effective %d.", 
+				proc->pid, proc->prio, proc->eprio);
+		return 0;
+
+	}
+
+	if ((prio = strtol(argv[2], &end, 10)) < 0 || prio >= PRIO_LEVELS || *end || end == argv[2]) {
+
+		sprintf(errstr, "ERROR: Priority must be 0 to %d.", PRIO_LEVELS - 1);
+		return -1;
+
+	}
+
+	prio_set(proc, prio);
+
+	return 0;
+
+}
+
+static int cmd_wait(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]), *on;
+
+	if (!proc || !(on = parse_pid(argv[2]))) return -1;
+
+	return prio_wait(proc, on);
+
+}
+
+static int cmd_hold(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+
+	if (!proc) return -1;
+
+	return prio_hold(proc, argv[2]);
+
+}
+
+static int cmd_release(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+
+	if (!proc) return -1;
+
+	return prio_release(proc, argv[2]);
+
+}
+
+static int cmd_limit(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+	int res;
+	long value;
+
+	if (!proc) return -1;
+
+	if (sim_mode) {
+
+		sprintf(errstr, "ERROR: Limits are not simulated.");
+		return -1;
+
+	}
+
+	/* Show limits */
+	if (argc == 2) {
+
+		limit_show(proc, errstr, sizeof(errstr));
+		return 0;
+
+	}
+
+	if (argc != 4 || (res = limit_res(argv[2])) < 0) {
+
+		sprintf(errstr, "ERROR: Resource must be rss, cpu or fds.");
+		return -1;
+
+	}
+
+	if ((value = limit_value(argv[3])) < 0) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid limit.", argv[3]);
+		return -1;
+
+	}
+
+	return limit_set(proc, res, value);
 
 }
 
+static int cmd_affinity(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+
+	if (!proc) return -1;
+
+	if (sim_mode) {
+
+		sprintf(errstr, "ERROR: Placement is not simulated.");
+		return -1;
+
+	}
+
+	return topo_set_cpus(proc, argv[2]);
+
+}
+
+static int cmd_numa(int argc, char **argv) {
+
+	pnode *proc = parse_pid(argv[1]);
+	char *end;
+	long node;
+
+	if (!proc) return -1;
+
+	if (sim_mode) {
+
+		sprintf(errstr, "ERROR: Placement is not simulated.");
+		return -1;
+
+	}
+
+	if ((node = strtol(argv[2], &end, 10)) < 0 || *end || end == argv[2]) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid number.", argv[2]);
+		return -1;
+
+	}
+
+	return topo_set_node(proc, node);
+
+}
+
+static int cmd_dag(int argc, char **argv) {
+
+	char *end;
+	long max = DAG_JOBS;
+
+	/* Show progress */
+	if (argc == 1) {
+
+		dag_status(errstr, sizeof(errstr));
+		return 0;
+
+	}
+
+	if (sim_mode) {
+
+		sprintf(errstr, "ERROR: Jobs are not simulated.");
+		return -1;
+
+	}
+
+	if (argc > 2 && ((max = strtol(argv[2], &end, 10)) <= 0 || *end)) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid number.", argv[2]);
+		return -1;
+
+	}
+
+	return dag_load(argv[1], max);
+
+}
+
+static int cmd_log(int argc, char **argv) {
+
+	int pid;
+	long since = 0;
+
+	/* Process may be gone, only check the numbers */
+	if (sscanf(argv[1], "%i", &pid) != 1) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid number.", argv[1]);
+		return -1;
+
+	} else if (argc > 2 && (since = parse_since(argv[2])) < 0) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid duration.", argv[2]);
+		return -1;
+
+	} else if (!plog_dir) {
+
+		sprintf(errstr, "ERROR: Logging is off, start with -L <dir>.");
+		return -1;
+
+	}
+
+	show_log(pid, argc > 2 ? time(NULL) - since : 0);
+
+	return 0;
+
+}
+
+static int cmd_archive(int argc, char **argv) {
+
+	long since, until = 0;
+
+	if (!arch_dir) {
+
+		sprintf(errstr, "ERROR: Archive is off, start with -A <dir>.");
+		return -1;
+
+	}
+
+	if (argc == 1) {
+
+		arch_status(errstr, sizeof(errstr));
+		return 0;
+
+	}
+
+	if ((since = parse_since(argv[1])) < 0 || (argc > 2 && (until = parse_since(argv[2])) < 0)) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid duration.", argv[argc > 2 && since >= 0 ? 2 : 1]);
+		return -1;
+
+	}
+
+	show_archive(time(NULL) - since, time(NULL) - until);
+
+	return 0;
+
+}
+
+static int cmd_jitter(int argc, char **argv) {
+
+	metrics_jitter(errstr, sizeof(errstr));
+
+	return 0;
+
+}
+
+static int cmd_trigger(int argc, char **argv) {
+
+	pnode *proc;
+	int target = 0;
+
+	if (argc == 1) {
+
+		trig_status(errstr, sizeof(errstr));
+		return 0;
+
+	}
+
+	/* Pattern alone drops its rules */
+	if (argc == 2) return trig_remove(argv[1]);
+
+	if (argc > 3) {
+
+		if (!(proc = parse_pid(argv[3]))) return -1;
+		target = proc->pid;
+
+	}
+
+	return trig_add(argv[1], argv[2], target);
+
+}
+
+static int cmd_green(int argc, char **argv) {
+
+	green_bench(errstr, sizeof(errstr));
+
+	return 0;
+
+}
+
+static int cmd_help(int argc, char **argv) {
+
+	show_help();
+
+	return 0;
+
+}
+
+static int cmd_quit(int argc, char **argv) {
+
+	sim_record(cmdline, 0);
+	end_ncurses();
+	arch_close();
+	spage_close();
+	exit(0);
+
+	return 0;
+
+}
+
+/* Command table, also drives the help window */
+command commands[] = {
+	{ "spawn",	1, 2, cmd_spawn,	"spawn <name> [count]",	"Spawns new processes. Output <name>." },
+	{ "exec",	1, ARGS_MAX, cmd_exec,	"exec <file> [args]",	"Exec program. Pipes output." },
+	{ "kill",	1, 1, cmd_kill,		"kill <pid>",		"Kills process using pid." },
+	{ "block",	1, 3, cmd_block,	"block <pid> [fd|timer|exit|file <arg>]",
+										"Blocks process, until event if given." },
+	{ "run",	1, 1, cmd_run,		"run <pid>",		"Puts process back in ready queue." },
+	{ "throttle",	1, 3, cmd_throttle,	"throttle <pid> [<bytes> [drop|sample]]", 
+										"Output budget per second." },
+	{ "prio",	1, 2, cmd_prio,		"prio <pid> [level]",	"Priority, 0 lowest to 9." },
+	{ "wait",	2, 2, cmd_wait,		"wait <pid> <pid>",	"Blocks process until other exits." },
+	{ "hold",	2, 2, cmd_hold,		"hold <pid> <name>",	"Takes resource, waits if held." },
+	{ "release",	2, 2, cmd_release,	"release <pid> <name>",	"Releases resource." },
+	{ "limit",	1, 3, cmd_limit,	"limit <pid> [rss|cpu|fds <value>]",	"Resource limit, 0 for none." },
+	{ "affinity",	2, 2, cmd_affinity,	"affinity <pid> <cpus>",	"Pins process to cpus, like 0-3,8." },
+	{ "numa",	2, 2, cmd_numa,		"numa <pid> <node>",	"Moves process and memory to node." },
+	{ "dag",	0, 2, cmd_dag,		"dag [<file> [max]]",	"Runs job file, see dag.h." },
+	{ "log",	1, 2, cmd_log,		"log <pid> [since]",	"Pages through process log." },
+	{ "archive",	0, 2, cmd_archive,	"archive [<since> [until]]",	"Pages through archived output." },
+	{ "jitter",	0, 0, cmd_jitter,	"jitter",		"Histogram of tick lateness." },
+	{ "trigger",	0, 3, cmd_trigger,	"trigger [<pattern> [block|run|kill [pid]]]",
+										"Acts on output, see trig.h." },
+	{ "green",	0, 0, cmd_green,	"green",		"Times green task switches." },
+	{ "quit",	0, 0, cmd_quit,		"quit",			"Quits." },
+	{ "help",	0, 0, cmd_help,		"help",			"This window." },
+};
+
+int ncommands = sizeof(commands) / sizeof(command);
+
+/* Trie over command names, letters only, case insensitive. Node 0 is root */
+#define TRIE_MAX	256
+
+typedef struct tnode {
+	unsigned char	next[26];
+	signed char	cmd;
+} tnode;
+
+static tnode trie[TRIE_MAX];
+static int ntrie = 0;
+
 /*
- * validate_param()
+ * trie_build
  *
- * Validates parameter after command. 
- *
- * Returns 1 on success, 0 on error.
+ * Builds trie from command table.
  *
  */
 
-int validate_param() {
+static void trie_build() {
+
+	int i, n;
+	char *c;
+
+	memset(trie, 0, sizeof(trie));
+	trie[0].cmd = -1;
+	ntrie = 1;
+
+	for (i = 0; i < ncommands; i++) {
+
+		for (n = 0, c = commands[i].name; *c; c++) {
+
+			if (!trie[n].next[*c - 'a']) {
+
+				trie[ntrie].cmd = -1;
+				trie[n].next[*c - 'a'] = ntrie++;
 
-	switch (validate_command(args[0])) {
-	
-		case SPAWN: ;
-			
-			/* Test string length. Max length is 8 characters */
-			int i = 0;
-			
-			while (args[1][i] != 0) i++;
-			
-			if (i <= 8) return 1;
-			
-			/* If string exceeds length */
-			else {
-			
-				sprintf(errstr, "ERROR: Maximum process name length is 8 characters");
-				
-				return 0;	
 			}
-			
-			break;
 
-		case EXEC: ;
-			
-			FILE *exe;
+			n = trie[n].next[*c - 'a'];
 
-			if ((exe = fopen(args[1], "r")) == NULL) {
-				
-				sprintf(errstr, "ERROR: Could not find executable '%s'.",
-						args[1]);
-				
-				return 0;
+		}
 
-			} else return 1;
+		trie[n].cmd = i;
 
-			break;
+	}
 
-		case KILL: ;
+}
 
-			/* Parse string to int */
-			int arg_pid;
+/*
+ * comm_lookup
+ *
+ * Walks trie with word. Returns command or NULL if word is not a command.
+ *
+ */
+
+command* comm_lookup(char *word) {
 
-			/* If cannot parse parameter to int */
-			if (sscanf(args[1], "%i", &arg_pid) != 1) {
-			
-				sprintf(errstr, "ERROR: \"%s\" is not a valid number.",
-						args[1]);
+	int n = 0, c;
 
-				return 0;
+	if (!ntrie) trie_build();
 
-			/* If cannot find pid in process list */
-			} else if (!pnode_get_node_by_pid(arg_pid)) {
-						
-				sprintf(errstr,	"ERROR: Could not find process %d.",
-						arg_pid);
-			
-			/* Else success */
-			} else return 1;
+	for (; *word; word++) {
 
-			break;
-		
-		default:
-			return 1;
-			break;
+		c = tolower(*word) - 'a';
+
+		if (c < 0 || c >= 26 || !(n = trie[n].next[c])) return NULL;
 
 	}
 
+	return trie[n].cmd >= 0 ? &commands[(int)trie[n].cmd] : NULL;
+
 }
 
 /*
- * parse_command()
+ * tokenize()
  *
- * Splits command string on spaces and returns pointer to array of strings
+ * Splits line into words stored in buf, pointed to by argv. Words are separated
+ * by spaces, double quotes group words. argv is NULL terminated. Returns number
+ * of words.
  *
  */
 
-void parse_command() {
+int tokenize(char *line, char *buf, char **argv) {
 
-	/* Variables to parse string into array */
-	int spaces = 0, i = 0, j = 0;
+	int argc = 0, quoted;
 
-	/* Remove leading white space until first alpha character */
-	while (i < sizeof(comm) && comm[i] == ' ' && comm[i] != 0) i++;
-	
-	/* Store command */
-	while (i < sizeof(comm) && comm[i] != ' ' && comm[i] != 0) {
-		
-		args[0][j++] = comm[i];
-		i++;
+	while (argc < ARGS_MAX - 1) {
+
+		/* Remove white space before word */
+		while (*line == ' ' || *line == '\t') line++;
+
+		if (!*line) break;
+
+		argv[argc++] = buf;
+		quoted = 0;
+
+		/* Store word */
+		while (*line && (quoted || (*line != ' ' && *line != '\t'))) {
+
+			if (*line == '"') quoted = !quoted;
+			else *buf++ = *line;
+
+			line++;
+
+		}
+
+		*buf++ = 0;
 
 	}
 
-	/* Remove white space between command and argument */
-	while (i < sizeof(comm) && comm[i] == ' ' && comm[i] != 0) i++;
+	argv[argc] = NULL;
 
-	j = 0;
+	return argc;
 
-	/* Store argument */
-	while (i < sizeof(comm) && comm[i] != ' ' && comm[i] != 0) {
-	
-		args[1][j++] = comm[i];
-		i++;
+}
+
+/*
+ * parse_pid()
+ *
+ * Parses pid argument. Returns process or NULL, with error set, if argument
+ * isn't a number or no such process is scheduled.
+ *
+ */
+
+pnode* parse_pid(char *arg) {
+
+	int pid;
+	pnode *proc;
+
+	/* If cannot parse parameter to int */
+	if (sscanf(arg, "%i", &pid) != 1) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid number.", arg);
+		return NULL;
+
+	}
+
+	/* If cannot find pid in process list */
+	if (!(proc = pnode_get_node_by_pid(pid)))
+		sprintf(errstr, "ERROR: Could not find process %d.", pid);
+
+	return proc;
+
+}
+
+/*
+ * parse_since()
+ *
+ * Parses a duration like 90, 90s, 15m or 2h into seconds. Returns -1 if
+ * string is not a duration.
+ *
+ */
+
+long parse_since(char *str) {
+
+	char *end;
+	long n = strtol(str, &end, 10);
+
+	if (end == str || n < 0) return -1;
+
+	switch (*end) {
+
+		case 0:
+		case 's':	break;
+		case 'm':	n *= 60; break;
+		case 'h':	n *= 3600; break;
+		case 'd':	n *= 86400; break;
+		default:	return -1;
+
+	}
 
-	}	
+	return end[*end ? 1 : 0] ? -1 : n;
 
 }
 
@@ -176,77 +658,36 @@ void parse_command() {
 
 void exec_command() {
 
-	int c_code, arg_pid;
-	char *arg1;
+	char buf[sizeof(comm) + 1];
+	char *argv[ARGS_MAX];
+	int argc, new_pid;
+	command *cmd;
 	
 	/* Reset error string on new command */
 	memset(errstr, 0, sizeof(errstr));
 
 	/* Save command in history */
 	history_add(comm);
+	strcpy(cmdline, comm);
 
-	parse_command();
-	c_code = validate_command();
+	argc = tokenize(comm, buf, argv);
 	
 	/* Reset command buffer and pointer */
 	memset(comm, 0, sizeof(comm));
 	comm_ptr = 0;
 
-	/* Execute command */
-	if (c_code != -1 && validate_param()) {
+	if (!argc) return;
 
-		switch (c_code) {
-	
-			case SPAWN:
-				/* Copy argument into pointer */
-				arg1 = malloc(strlen(args[1]));
-			        strcpy(arg1, args[1]);	
-
-				/* Spawn new process */
-				spawn_process(arg1);
-				break;
-
-			case EXEC:
-				exec_process(args[1]);
-				break;
-
-			case BLOCK: ;
-				sscanf(args[1], "%d", &arg_pid);
-				block_process(arg_pid);
-				break;
-
-			case RUN: ;
-				sscanf(args[1], "%d", &arg_pid);
-				run_process(arg_pid);
-				break;
-
-			case KILL: ;
-				sscanf(args[1], "%d", &arg_pid);
-				kill_process(arg_pid);
-				break;
-
-			case HELP:
-				show_help();
-				break;
-
-			case QUIT:
-				end_ncurses();
-				exit(0);
-				break;
-	
-		}
+	/* Find command */
+	if (!(cmd = comm_lookup(argv[0]))) 
+		sprintf(errstr, "ERROR: \"%s\" is not a valid command.", argv[0]);
 
-	} else if (c_code == -1) {
-	
-		sprintf(errstr, "ERROR: \"%s\" is not a valid command.", args[0]);	
+	/* Check argument count */
+	else if (argc - 1 < cmd->min || argc - 1 > cmd->max)
+		snprintf(errstr, sizeof(errstr), "Usage: %s", cmd->usage);
 
-	} 
+	/* Execute command and record it in trace if recording */
+	else if ((new_pid = cmd->handler(argc, argv)) >= 0)
+		sim_record(cmdline, new_pid);
 
-	/* Reset arguments array */
-	memset(args[0], 0, sizeof(args[0]));
-	memset(args[1], 0, sizeof(args[1]));
-	
 }
-
-
-
@@ -4,29 +4,120 @@
  *
  * @Description: Contains all the command processing functions
  *
+ * 		Commands are described once in a table (name, argument counts,
+ * 		handler, usage and help). Names are looked up through a trie built
+ * 		from the table the first time a command runs, without copying or
+ * 		lowercasing the word. Each handler validates its arguments once and
+ * 		runs the command.
+ *
+ * @Constants:
+ *
+ * 	ARGS_MAX	Most words on a command line
+ *
+ * @Functions:
+ *
+ * 	tokenize	Splits a command line into words. Double quotes
+ * 			group words. Returns number of words.
+ *
+ * 	comm_lookup	Returns table entry of a command name, or NULL.
+ *
+ * 	parse_pid	Parses a pid argument and finds its process.
+ *
+ * 	parse_since	Parses a duration like 90, 15m or 2h.
+ *
+ * 	exec_command	Tokenizes, looks up and runs the command sitting on
+ * 			the command line.
+ *
  */
 
+#define __comm_h_
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+
+#include "proc.h"
+
+#ifndef __sim_h_
+	#include "sim.h"
+#endif
+
+#ifndef __output_h_
+	#include "output.h"
+#endif
+
+#ifndef __plog_h_
+	#include "plog.h"
+#endif
+
+#ifndef __topo_h_
+	#include "topo.h"
+#endif
+
+#ifndef __limit_h_
+	#include "limit.h"
+#endif
+
+#ifndef __prio_h_
+	#include "prio.h"
+#endif
+
+#ifndef __event_h_
+	#include "event.h"
+#endif
+
+#ifndef __dag_h_
+	#include "dag.h"
+#endif
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+#ifndef __green_h_
+	#include "green.h"
+#endif
+
+#ifndef __trig_h_
+	#include "trig.h"
+#endif
+
+#ifndef __arch_h_
+	#include "arch.h"
+#endif
+
+#ifndef __spage_h_
+	#include "spage.h"
+#endif
+
+#define ARGS_MAX	32
+
+/* A command and its handler. Handlers return -1 if arguments are invalid,
+ * otherwise pid of process created or 0 */
+typedef struct command {
+	char	*name;
+	int	min;		/* Argument count, not counting name */
+	int	max;
+	int	(*handler)(int argc, char **argv);
+	char	*usage;
+	char	*help;
+} command;
 
 extern char errstr[128];
 extern char comm[64];
-extern char args[2][64];
 extern int comm_ptr;
 
-#define SPAWN	1
-#define EXEC	2
-#define	BLOCK	3
-#define RUN	4
-#define KILL	5
-#define HELP	6
-#define QUIT	7
+extern command commands[];
+extern int ncommands;
+
+int tokenize(char *line, char *buf, char **argv);
 
-int validate_command();
+command* comm_lookup(char *word);
 
-int validate_param();
+pnode* parse_pid(char *arg);
 
-void parse_command();
+long parse_since(char *str);
 
 void exec_command();
+
@@ -0,0 +1,307 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	cosched
+ *
+ * @Description: Co-scheduling
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cosched.h"
+#include "proc.h"
+
+#ifndef __sim_h_
+	#include "sim.h"
+#endif
+
+#ifndef __perf_h_
+	#include "perf.h"
+#endif
+
+int cosched_width = 1;
+
+static int pairing = 1;
+
+/* Companions of the running process, flagged co in their nodes */
+static pnode *co[COSCHED_MAX];
+static int nco = 0;
+
+/*
+ * cosched_init
+ *
+ * Parses width, followed by rr for plain round robin or pair for pairing
+ * by cache misses, the default. Returns 0 on success, -1 otherwise.
+ *
+ */
+
+int cosched_init(char *spec) {
+
+	char *end;
+	long w = strtol(spec, &end, 10);
+
+	if (w < 1 || w > COSCHED_MAX) return -1;
+
+	if (!*end) pairing = 1;
+	else if (!strcmp(end, ",rr")) pairing = 0;
+	else if (!strcmp(end, ",pair")) pairing = 1;
+	else return -1;
+
+	cosched_width = w;
+
+	return 0;
+
+}
+
+/*
+ * load
+ *
+ * Cache misses per second of process, modelled ones in simulation mode. 0
+ * when not known, so unknown processes are all alike.
+ *
+ */
+
+static double load(pnode *proc) {
+
+	if (sim_mode) return sim_load(proc);
+
+	return proc->perf && proc->perf->miss_rate > 0 ? proc->perf->miss_rate : 0;
+
+}
+
+/*
+ * move_after
+ *
+ * Moves process in the ready queue to right after another one. Both are in
+ * the queue and apart, so it holds at least three processes.
+ *
+ */
+
+static void move_after(pnode *proc, pnode *after) {
+
+	if (after->next == proc) return;
+
+	if (tail == proc) tail = proc->prev;
+
+	proc->prev->next = proc->next;
+	proc->next->prev = proc->prev;
+
+	proc->next = after->next;
+	proc->prev = after;
+	after->next->prev = proc;
+	after->next = proc;
+
+	if (tail == after) tail = proc;
+
+}
+
+/*
+ * pick
+ *
+ * Adds up to want companions to those of head. Candidates are the processes
+ * after head of its priority. Round robin takes them in order. Pairing takes,
+ * one at a time, the candidate that brings the total load closest to the
+ * average load times the number running, the first one on a tie. Returns
+ * number added.
+ *
+ */
+
+static int pick(int want) {
+
+	pnode *cand[COSCHED_SCAN], *tmp, *last = head;
+	double sum = load(head), avg = sum, best, d;
+	int n = 0, added = 0, i, b;
+
+	for (tmp = head->next; tmp != head && n < COSCHED_SCAN; tmp = tmp->next) {
+
+		if (tmp->co) {
+
+			sum += load(tmp);
+			last = tmp;
+
+		} else if (tmp->eprio == head->eprio) {
+
+			cand[n++] = tmp;
+			avg += load(tmp);
+
+		}
+
+	}
+
+	avg /= n + nco + 1;
+
+	for (; added < want && n; added++) {
+
+		b = 0;
+
+		if (pairing) {
+
+			best = fabs(sum + load(cand[0]) - avg * (nco + 2));
+
+			for (i = 1; i < n; i++)
+				if ((d = fabs(sum + load(cand[i]) - avg * (nco + 2))) < best) {
+
+					best = d;
+					b = i;
+
+				}
+
+		}
+
+		tmp = cand[b];
+		memmove(cand + b, cand + b + 1, (--n - b) * sizeof(pnode *));
+
+		/* Run right behind head and its other companions */
+		move_after(tmp, last);
+		last = tmp;
+
+		tmp->co = 1;
+		co[nco++] = tmp;
+		sum += load(tmp);
+
+	}
+
+	return added;
+
+}
+
+/*
+ * cosched_skip
+ *
+ * Moves head past companions of the last quantum, which ran their turn.
+ * Called once head moved on.
+ *
+ */
+
+void cosched_skip() {
+
+	int i;
+
+	for (i = 0; i < nco && head->co; i++) {
+
+		tail = head;
+		head = head->next;
+
+	}
+
+}
+
+/*
+ * cosched_select
+ *
+ * Picks companions of proc, which is about to run. Companions that are not
+ * picked again are stopped unless proc is one, new ones are continued
+ * unless already running.
+ *
+ */
+
+void cosched_select(pnode *proc) {
+
+	pnode *old[COSCHED_MAX];
+	int nold = nco, i, j;
+
+	if (cosched_width == 1 && !nco) return;
+
+	memcpy(old, co, nco * sizeof(pnode *));
+
+	for (i = 0; i < nco; i++) co[i]->co = 0;
+	nco = 0;
+
+	/* Only the head of the ready queue runs with companions, not idle */
+	if (proc && proc == head) pick(cosched_width - 1);
+
+	for (i = 0; i < nold; i++) {
+
+		if (old[i]->co || old[i] == proc) continue;
+
+		proc_signal(old[i], SIGSTOP);
+		ctx_switches++;
+
+	}
+
+	for (i = 0; i < nco; i++) {
+
+		for (j = 0; j < nold && old[j] != co[i]; j++);
+
+		if (j == nold && co[i] != running_proc) proc_signal(co[i], SIGCONT);
+
+	}
+
+}
+
+/*
+ * cosched_fill
+ *
+ * Runs companions in free places, if the head is running.
+ *
+ */
+
+void cosched_fill() {
+
+	int i, n;
+
+	if (!head || head != running_proc || nco >= cosched_width - 1) return;
+
+	n = pick(cosched_width - 1 - nco);
+
+	for (i = nco - n; i < nco; i++) proc_signal(co[i], SIGCONT);
+
+}
+
+/*
+ * cosched_drop
+ *
+ * Takes process leaving the ready queue out of the companions, running
+ * another one in its place. Process is stopped or gone already.
+ *
+ */
+
+void cosched_drop(pnode *proc) {
+
+	int i;
+
+	for (i = 0; i < nco && co[i] != proc; i++);
+
+	if (i == nco) return;
+
+	memmove(co + i, co + i + 1, (--nco - i) * sizeof(pnode *));
+	proc->co = 0;
+
+	cosched_fill();
+
+}
+
+/*
+ * cosched_running
+ *
+ * Fills procs with companions of the running process. Returns their number.
+ *
+ */
+
+int cosched_running(pnode **procs) {
+
+	memcpy(procs, co, nco * sizeof(pnode *));
+
+	return nco;
+
+}
+
+/*
+ * cosched_status
+ *
+ * Formats width and policy into buf.
+ *
+ */
+
+char* cosched_status(char *buf, int size) {
+
+	snprintf(buf, size, "%d wide, %s", cosched_width,
+			cosched_width == 1 ? "one at a time" : pairing ? "pairing" : "round robin");
+
+	return buf;
+
+}
+
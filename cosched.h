@@ -0,0 +1,81 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	cosched.h
+ *
+ * @Description: Co-scheduling. With -w, each quantum runs up to width
+ * 		processes at once instead of only the head of the ready queue:
+ * 		the head, picked in turns as before, plus companions of the
+ * 		same priority from the processes after it. Companions are moved
+ * 		right behind the head, and the next quantum starts past them,
+ * 		so every ready process still runs once per pass.
+ *
+ * 		Two memory bound processes running at once slow each other
+ * 		down, competing for the last level cache and memory bandwidth.
+ * 		When pairing, companions are chosen by their cache miss rate
+ * 		measured with -P, so each quantum's total stays close to the
+ * 		average: a heavy head runs with light companions, a light head
+ * 		pulls heavy ones forward. Without counters every process
+ * 		weighs the same, and companions are taken in queue order like
+ * 		plain round robin does.
+ *
+ * 		A companion that blocks or goes away is replaced right away,
+ * 		and a process becoming ready runs at once if there is room.
+ *
+ * 		Companions are moved and picked inside the clock interrupt, by
+ * 		next(). Everything else changing or walking the ring does so
+ * 		with the clock held, see clock_hold.
+ *
+ * 		Traces replayed with -s can set width and policy, and model
+ * 		memory bound processes, to compare both policies, see sim.c.
+ *
+ * @Constants:
+ *
+ * 	COSCHED_MAX	Widest run
+ *
+ * 	COSCHED_SCAN	Processes after the head considered as companions
+ *
+ * @Functions:
+ *
+ * 	cosched_init	Parses width and policy, like 4 or 4,rr. Returns 0
+ * 			on success.
+ *
+ * 	cosched_skip	Moves head past companions of the last quantum.
+ *
+ * 	cosched_select	Picks companions of process about to run, stopping
+ * 			and continuing processes as the set changes.
+ *
+ * 	cosched_fill	Runs newly ready processes in free places.
+ *
+ * 	cosched_drop	Replaces companion leaving the ready queue.
+ *
+ * 	cosched_running	Fills array with companions. Returns their number.
+ *
+ * 	cosched_status	Formats width and policy.
+ *
+ */
+
+#define __cosched_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define COSCHED_MAX	16
+#define COSCHED_SCAN	64
+
+extern int cosched_width;
+
+int cosched_init(char *spec);
+
+void cosched_skip();
+
+void cosched_select(pnode *proc);
+
+void cosched_fill();
+
+void cosched_drop(pnode *proc);
+
+int cosched_running(pnode **procs);
+
+char* cosched_status(char *buf, int size);
+
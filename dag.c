@@ -0,0 +1,488 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	dag
+ *
+ * @Description: Job launcher
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "dag.h"
+#include "proc.h"
+#include "comm.h"
+
+/* Logs a line in the output window, in ui.c */
+void log_add_line(char *buffer);
+
+/* Current job, stages in file order and topological order */
+static stage stages[DAG_MAX];
+static int order[DAG_MAX];
+static int nstages = 0, running = 0, maxrun = 1, active = 0;
+static struct timespec started;
+
+/*
+ * elapsed
+ *
+ * Returns seconds between two times.
+ *
+ */
+
+static double elapsed(struct timespec *from, struct timespec *to) {
+
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+
+}
+
+/*
+ * find_stage
+ *
+ * Returns index of stage, -1 if none.
+ *
+ */
+
+static int find_stage(char *name) {
+
+	int i;
+
+	for (i = 0; i < nstages; i++)
+		if (!strcmp(stages[i].name, name)) return i;
+
+	return -1;
+
+}
+
+/*
+ * dag_free
+ *
+ * Frees stages of last job.
+ *
+ */
+
+static void dag_free() {
+
+	int i;
+
+	for (i = 0; i < nstages; i++) {
+
+		free(stages[i].buf);
+		free(stages[i].argv);
+		free(stages[i].after);
+
+	}
+
+	nstages = 0;
+
+}
+
+/*
+ * dag_sort
+ *
+ * Sorts stages topologically (Kahn). Returns -1 with error set if there is a
+ * cycle.
+ *
+ */
+
+static int dag_sort() {
+
+	int pending[DAG_MAX], i, j, k, n = 0, head = 0;
+
+	for (i = 0; i < nstages; i++)
+		if (!(pending[i] = stages[i].ndeps)) order[n++] = i;
+
+	/* Order doubles as queue */
+	while (head < n) {
+
+		i = order[head++];
+
+		for (j = 0; j < nstages; j++)
+			for (k = 0; k < stages[j].ndeps; k++)
+				if (stages[j].deps[k] == i && !--pending[j]) order[n++] = j;
+
+	}
+
+	if (n == nstages) return 0;
+
+	for (i = 0; i < nstages && !pending[i]; i++);
+
+	sprintf(errstr, "ERROR: Stage %s is part of a cycle.", stages[i].name);
+
+	return -1;
+
+}
+
+/*
+ * dag_parse
+ *
+ * Parses one line of job file. Returns -1 with error set on failure.
+ *
+ */
+
+static int dag_parse(char *line, int lineno) {
+
+	char *words[ARGS_MAX], buf[512];
+	stage *s;
+	int argc, i;
+
+	if (strlen(line) > sizeof(buf) - ARGS_MAX) {
+
+		sprintf(errstr, "ERROR: Line %d is too long.", lineno);
+		return -1;
+
+	}
+
+	argc = tokenize(line, buf, words);
+
+	if (!argc || words[0][0] == '#') return 0;
+
+	if (!strcmp(words[0], "max") && argc == 2) {
+
+		maxrun = atoi(words[1]) > 0 ? atoi(words[1]) : 1;
+		return 0;
+
+	}
+
+	if (argc < 3 || nstages == DAG_MAX || strlen(words[0]) >= sizeof(s->name) ||
+			find_stage(words[0]) != -1) {
+
+		sprintf(errstr, "ERROR: Invalid stage on line %d.", lineno);
+		return -1;
+
+	}
+
+	if (access(words[2], X_OK)) {
+
+		sprintf(errstr, "ERROR: Could not find executable '%s'.", words[2]);
+		return -1;
+
+	}
+
+	s = &stages[nstages];
+	memset(s, 0, sizeof(stage));
+	strcpy(s->name, words[0]);
+
+	/* Parents may come later in the file, resolved once all is read */
+	if (strcmp(words[1], "-")) s->after = strdup(words[1]);
+
+	/* Keep command words */
+	s->argv = malloc((argc - 1) * sizeof(char *));
+	s->buf = malloc(sizeof(buf));
+	memcpy(s->buf, buf, sizeof(buf));
+
+	for (i = 2; i < argc; i++) s->argv[i - 2] = s->buf + (words[i] - buf);
+	s->argv[argc - 2] = NULL;
+
+	nstages++;
+
+	return 0;
+
+}
+
+/*
+ * dag_resolve
+ *
+ * Resolves parent names of every stage. Returns -1 with error set if one is
+ * unknown.
+ *
+ */
+
+static int dag_resolve() {
+
+	char *dep, *save;
+	stage *s;
+	int i, d;
+
+	for (i = 0; i < nstages; i++) {
+
+		s = &stages[i];
+
+		if (!s->after) continue;
+
+		for (dep = strtok_r(s->after, ",", &save); dep; dep = strtok_r(NULL, ",", &save)) {
+
+			if ((d = find_stage(dep)) == -1 || s->ndeps == DAG_DEPS) {
+
+				sprintf(errstr, "ERROR: Unknown stage %s after %s.", dep, s->name);
+				return -1;
+
+			}
+
+			s->deps[s->ndeps++] = d;
+
+		}
+
+	}
+
+	return 0;
+
+}
+
+/*
+ * skip_after
+ *
+ * Skips every waiting stage that has a failed or skipped parent. Stages are
+ * visited in topological order, so one pass reaches all descendants.
+ *
+ */
+
+static void skip_after() {
+
+	int i, k;
+	stage *s;
+
+	for (i = 0; i < nstages; i++) {
+
+		s = &stages[order[i]];
+
+		for (k = 0; k < s->ndeps && s->state == JOB_WAITING; k++)
+			if (stages[s->deps[k]].state >= JOB_FAILED) s->state = JOB_SKIPPED;
+
+	}
+
+}
+
+/*
+ * dag_report
+ *
+ * Logs outcome, makespan and critical path. The critical path is the chain
+ * of stages, each a parent of the next, with the most run time.
+ *
+ */
+
+static void dag_report() {
+
+	double cp[DAG_MAX], best = 0;
+	int from[DAG_MAX], path[DAG_MAX], count[5] = {0}, i, k, n, last = -1;
+	struct timespec end = started;
+	char line[256];
+	stage *s;
+
+	for (i = 0; i < nstages; i++) {
+
+		s = &stages[order[i]];
+		count[s->state]++;
+
+		cp[order[i]] = 0;
+		from[order[i]] = -1;
+
+		if (s->state != JOB_DONE && s->state != JOB_FAILED) continue;
+
+		if (elapsed(&end, &s->end) > 0) end = s->end;
+
+		for (k = 0; k < s->ndeps; k++) {
+
+			if (cp[s->deps[k]] > cp[order[i]]) {
+
+				cp[order[i]] = cp[s->deps[k]];
+				from[order[i]] = s->deps[k];
+
+			}
+
+		}
+
+		cp[order[i]] += elapsed(&s->start, &s->end);
+
+		if (cp[order[i]] > best) best = cp[order[i]], last = order[i];
+
+	}
+
+	snprintf(line, sizeof(line), "Job done: %d ok, %d failed, %d skipped, makespan %.2f s.",
+			count[JOB_DONE], count[JOB_FAILED], count[JOB_SKIPPED], elapsed(&started, &end));
+	log_add_line(line);
+
+	for (n = 0; last != -1; last = from[last]) path[n++] = last;
+
+	k = snprintf(line, sizeof(line), "Critical path %.2f s:", best);
+
+	while (n-- && k < sizeof(line))
+		k += snprintf(line + k, sizeof(line) - k, " %s%s", stages[path[n]].name, n ? " ->" : "");
+
+	log_add_line(line);
+
+	active = 0;
+
+}
+
+/*
+ * dag_launch
+ *
+ * Launches stages whose parents are done, as many as allowed. Reports once
+ * nothing is running and nothing can be launched.
+ *
+ */
+
+static void dag_launch() {
+
+	int i, k;
+	stage *s;
+
+	for (i = 0; i < nstages && running < maxrun; i++) {
+
+		s = &stages[order[i]];
+
+		if (s->state != JOB_WAITING) continue;
+
+		for (k = 0; k < s->ndeps && stages[s->deps[k]].state == JOB_DONE; k++);
+
+		if (k < s->ndeps) continue;
+
+		clock_gettime(CLOCK_MONOTONIC, &s->start);
+
+		if ((s->pid = exec_process(s->argv)) == -1) {
+
+			s->end = s->start;
+			s->state = JOB_FAILED;
+			skip_after();
+
+			continue;
+
+		}
+
+		s->state = JOB_RUNNING;
+		running++;
+
+	}
+
+	if (!running) dag_report();
+
+}
+
+/*
+ * dag_load
+ *
+ * Loads job file and launches its first stages. Returns 0 on success, -1 with
+ * error set otherwise.
+ *
+ */
+
+int dag_load(char *path, int max) {
+
+	char line[512];
+	FILE *f;
+	int lineno = 0;
+
+	if (active) {
+
+		sprintf(errstr, "ERROR: A job is already running.");
+		return -1;
+
+	}
+
+	if ((f = fopen(path, "r")) == NULL) {
+
+		sprintf(errstr, "ERROR: Could not open job file '%s'.", path);
+		return -1;
+
+	}
+
+	dag_free();
+	maxrun = max;
+
+	while (fgets(line, sizeof(line), f)) {
+
+		line[strcspn(line, "\r\n")] = 0;
+
+		if (dag_parse(line, ++lineno)) {
+
+			fclose(f);
+			dag_free();
+			return -1;
+
+		}
+
+	}
+
+	fclose(f);
+
+	if (!nstages || dag_resolve() || dag_sort()) {
+
+		if (!nstages) sprintf(errstr, "ERROR: Job file '%s' has no stages.", path);
+		dag_free();
+		return -1;
+
+	}
+
+	active = 1;
+	running = 0;
+	clock_gettime(CLOCK_MONOTONIC, &started);
+
+	dag_launch();
+
+	return 0;
+
+}
+
+/*
+ * dag_exited
+ *
+ * Marks stage of reaped pid done or failed and launches what depended on it.
+ *
+ */
+
+void dag_exited(int pid, int status) {
+
+	char line[128];
+	stage *s;
+	int i;
+
+	if (!active) return;
+
+	for (i = 0; i < nstages && stages[i].pid != pid; i++);
+
+	if (i == nstages || stages[i].state != JOB_RUNNING) return;
+
+	s = &stages[i];
+	s->status = status;
+	clock_gettime(CLOCK_MONOTONIC, &s->end);
+	running--;
+
+	if (WIFEXITED(status) && !WEXITSTATUS(status)) s->state = JOB_DONE;
+	else {
+
+		s->state = JOB_FAILED;
+		skip_after();
+
+	}
+
+	if (WIFEXITED(status))
+		snprintf(line, sizeof(line), "Stage %s exited %d after %.2f s.", 
+				s->name, WEXITSTATUS(status), elapsed(&s->start, &s->end));
+	else
+		snprintf(line, sizeof(line), "Stage %s killed by signal %d after %.2f s.", 
+				s->name, WTERMSIG(status), elapsed(&s->start, &s->end));
+
+	log_add_line(line);
+
+	dag_launch();
+
+}
+
+/*
+ * dag_status
+ *
+ * Formats number of stages in each state.
+ *
+ */
+
+void dag_status(char *buf, int size) {
+
+	int count[5] = {0}, i;
+
+	if (!nstages) {
+
+		snprintf(buf, size, "No job loaded.");
+		return;
+
+	}
+
+	for (i = 0; i < nstages; i++) count[stages[i].state]++;
+
+	snprintf(buf, size, "Job %s: %d waiting, %d running, %d ok, %d failed, %d skipped.",
+			active ? "running" : "done", count[JOB_WAITING], count[JOB_RUNNING], 
+			count[JOB_DONE], count[JOB_FAILED], count[JOB_SKIPPED]);
+
+}
@@ -0,0 +1,75 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	dag.h
+ *
+ * @Description: Job launcher. A job file describes stages and the stages they
+ * 		need to exit successfully before they start:
+ *
+ * 			# name	after		command
+ * 			max	2
+ * 			fetch	-		/usr/bin/curl -so src.tgz http://...
+ * 			unpack	fetch		/bin/tar xzf src.tgz
+ * 			build	unpack		/usr/bin/make -C src
+ * 			lint	unpack		./lint.sh src
+ * 			test	build,lint	./run_tests
+ *
+ * 		A max line sets how many stages may run at once. Stages are
+ * 		sorted topologically when the file is loaded, which also finds
+ * 		cycles and unknown names. Stages whose parents are all done are
+ * 		launched through exec_process() in that order, as many as max
+ * 		allows, and the next ones as soon as a stage is reaped. A stage
+ * 		that fails (non zero exit or killed) skips everything after it.
+ *
+ * 		Once nothing is left to run, the makespan (first launch to last
+ * 		exit) and the critical path (the chain of stages with the
+ * 		longest total run time) are logged.
+ *
+ * @Constants:
+ *
+ * 	DAG_MAX		Most stages in a job file
+ *
+ * 	DAG_DEPS	Most parents of a stage
+ *
+ * 	DAG_JOBS	Default number of stages run at once
+ *
+ * @Functions:
+ *
+ * 	dag_load	Loads job file and launches it, max stages at once
+ * 			unless the file says otherwise. Returns 0 on success.
+ *
+ * 	dag_exited	Records exit of a reaped pid and launches what it
+ * 			held back.
+ *
+ * 	dag_status	Formats progress of current job.
+ *
+ */
+
+#define __dag_h_
+
+#include <time.h>
+
+#define DAG_MAX		256
+#define DAG_DEPS	16
+#define DAG_JOBS	4
+
+typedef enum jstate {JOB_WAITING, JOB_RUNNING, JOB_DONE, JOB_FAILED, JOB_SKIPPED} jstate;
+
+typedef struct stage {
+	char		name[32];
+	char		*buf;			/* Command words */
+	char		**argv;
+	char		*after;			/* Parent names, until resolved */
+	int		deps[DAG_DEPS];		/* Parents */
+	int		ndeps;
+	int		pid;
+	int		status;
+	jstate		state;
+	struct timespec	start, end;
+} stage;
+
+int dag_load(char *path, int max);
+
+void dag_exited(int pid, int status);
+
+void dag_status(char *buf, int size);
+
@@ -0,0 +1,450 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	event
+ *
+ * @Description: Blocking on events
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "event.h"
+#include "proc.h"
+
+static int ev_epfd = -1;
+static int ev_wheel = 0;
+
+/*
+ * watch_fd
+ *
+ * Opens descriptor event is read from. Returns -1 with error set on failure.
+ * For a file, the name is kept so only that name wakes the process.
+ *
+ */
+
+static int watch_fd(pnode *proc, evtype type, char *arg, char **name) {
+
+	char path[64], dir[256], *end;
+	long n = strtol(arg, &end, 10);
+	int fd = -1;
+
+	switch (type) {
+
+		/* Descriptor of process is reopened through /proc */
+		case EV_FD:
+
+			if (!*end && n >= 0) {
+
+				snprintf(path, sizeof(path), "/proc/%d/fd/%ld", proc->pid, n);
+				arg = path;
+
+			}
+
+			fd = open(arg, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			break;
+
+		/* Pidfd polls readable once process exits */
+		case EV_EXIT:
+
+			if (*end || n <= 0) {
+
+				sprintf(errstr, "ERROR: \"%s\" is not a valid number.", arg);
+				return -1;
+
+			}
+
+			fd = syscall(SYS_pidfd_open, (int)n, 0);
+			break;
+
+		/* Watch directory for file to be created or moved in */
+		case EV_FILE:
+
+			strncpy(dir, arg, sizeof(dir) - 1);
+			dir[sizeof(dir) - 1] = 0;
+
+			if ((fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) != -1 &&
+					inotify_add_watch(fd, dirname(dir), IN_CREATE | IN_MOVED_TO) == -1) {
+
+				close(fd);
+				fd = -1;
+
+			}
+
+			/* Checked once watched, so it can't appear in between */
+			if (fd != -1 && !access(arg, F_OK)) {
+
+				close(fd);
+				sprintf(errstr, "ERROR: %s already exists.", arg);
+				return -1;
+
+			}
+
+			strncpy(dir, arg, sizeof(dir) - 1);
+			*name = strdup(basename(dir));
+			break;
+
+		/* Timers go on the wheel, they have no descriptor of their own.
+		 * Exit watches on pidfds are added by event_track */
+		case EV_TIMER:
+		case EV_REAP:
+
+			sprintf(errstr, "ERROR: Can't block on that event.");
+			return -1;
+
+	}
+
+	if (fd == -1) sprintf(errstr, "ERROR: Could not watch %s.", arg);
+
+	return fd;
+
+}
+
+/*
+ * timer_fired
+ *
+ * Wheel callback of a timer watch.
+ *
+ */
+
+static void timer_fired(void *arg) {
+
+	run_node(((evwatch *)arg)->proc);
+
+}
+
+/*
+ * open_set
+ *
+ * Creates epoll set of all watches, once. Returns -1 with error set on
+ * failure.
+ *
+ */
+
+static int open_set() {
+
+	if (ev_epfd == -1 && (ev_epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+
+		sprintf(errstr, "ERROR: Could not create epoll set.");
+		return -1;
+
+	}
+
+	return 0;
+
+}
+
+/*
+ * event_block
+ *
+ * Blocks process until event fires. Returns 0 on success, -1 with error set
+ * otherwise.
+ *
+ */
+
+int event_block(pnode *proc, char *type, char *arg) {
+
+	static char *types[] = {"fd", "timer", "exit", "file"};
+	struct epoll_event ev;
+	evwatch *w;
+	char *name = NULL, *end;
+	long ms = 0;
+	int i, fd = -1;
+
+	for (i = 0; i < 4 && strcasecmp(type, types[i]); i++);
+
+	if (i == 4) {
+
+		sprintf(errstr, "ERROR: Event must be fd, timer, exit or file.");
+		return -1;
+
+	}
+
+	if (proc->state == BLOCKED) {
+
+		sprintf(errstr, "ERROR: Process %d is already blocked.", proc->pid);
+		return -1;
+
+	}
+
+	if (open_set()) return -1;
+
+	/* Timers share the wheel, no descriptor of their own */
+	if (i == EV_TIMER) {
+
+		ms = strtol(arg, &end, 10);
+
+		if (*end || ms <= 0) {
+
+			sprintf(errstr, "ERROR: \"%s\" is not a valid delay.", arg);
+			return -1;
+
+		}
+
+	} else if ((fd = watch_fd(proc, i, arg, &name)) == -1) return -1;
+
+	w = malloc(sizeof(evwatch));
+	w->proc = proc;
+	w->type = i;
+	w->fd = fd;
+	w->name = name;
+	w->timer.next = NULL;
+
+	ev.events = EPOLLIN;
+
+	if (i == EV_TIMER) {
+
+		/* Process stays ready if it would never be woken */
+		if (wheel_add(&w->timer, ms, timer_fired, w)) {
+
+			free(w);
+			sprintf(errstr, "ERROR: Could not start timer.");
+			return -1;
+
+		}
+
+		/* Wheel timerfd exists once the first timer is added, tagged
+		 * with a NULL watch */
+		if (!ev_wheel && wheel_pollfd() != -1) {
+
+			ev.data.ptr = NULL;
+			epoll_ctl(ev_epfd, EPOLL_CTL_ADD, wheel_pollfd(), &ev);
+			ev_wheel = 1;
+
+		}
+
+	} else {
+
+		ev.data.ptr = w;
+		epoll_ctl(ev_epfd, EPOLL_CTL_ADD, fd, &ev);
+
+	}
+
+	block_node(proc);
+
+	proc->cause = BC_EVENT;
+	proc->ev = w;
+
+	return 0;
+
+}
+
+/*
+ * event_cancel
+ *
+ * Closes watch of process. Closing the descriptor drops it from the set.
+ *
+ */
+
+void event_cancel(pnode *proc) {
+
+	evwatch *w = proc->ev;
+
+	if (!w) return;
+
+	if (w->type == EV_TIMER) wheel_cancel(&w->timer);
+	else close(w->fd);
+	free(w->name);
+	free(w);
+
+	proc->ev = NULL;
+
+}
+
+/*
+ * event_track
+ *
+ * Adds exit watch on pidfd of process, which it takes over.
+ *
+ */
+
+int event_track(pnode *proc, int pidfd) {
+
+	struct epoll_event ev;
+	evwatch *w;
+
+	if (open_set()) return -1;
+
+	w = calloc(1, sizeof(evwatch));
+	w->proc = proc;
+	w->type = EV_REAP;
+	w->pid = proc->pid;
+	w->fd = pidfd;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = w;
+
+	if (epoll_ctl(ev_epfd, EPOLL_CTL_ADD, pidfd, &ev) == -1) {
+
+		free(w);
+		return -1;
+
+	}
+
+	proc->pidfd = pidfd;
+	proc->reap = w;
+
+	return 0;
+
+}
+
+/*
+ * event_untrack
+ *
+ * Node is being destroyed. A process still alive keeps its watch, so it is
+ * reaped once gone.
+ *
+ */
+
+void event_untrack(pnode *proc) {
+
+	if (!proc->reap) return;
+
+	proc->reap->proc = NULL;
+	proc->reap = NULL;
+
+}
+
+/*
+ * reap
+ *
+ * Exit watch fired. Collects status if process is a child, then lets go of
+ * node and watch. The idle process is never let go of, its pidfd is kept
+ * to tell it died.
+ *
+ */
+
+static void reap(evwatch *w) {
+
+	siginfo_t info;
+	int status = -1;
+
+	memset(&info, 0, sizeof(info));
+
+	/* Adopted processes are no children, nor those reaped already */
+	if (!waitid(P_PIDFD, w->fd, &info, WEXITED | WNOHANG)) {
+
+		/* Not gone after all */
+		if (!info.si_pid) return;
+
+		status = info.si_code == CLD_EXITED ? W_EXITCODE(info.si_status, 0) :
+			info.si_status | (info.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+
+	}
+
+	epoll_ctl(ev_epfd, EPOLL_CTL_DEL, w->fd, NULL);
+
+	proc_exited(w->proc, w->pid, status);
+
+	if (w->proc) return;
+
+	close(w->fd);
+	free(w);
+
+}
+
+/*
+ * file_created
+ *
+ * Reads inotify events, returns 1 if the file watched for was among them.
+ *
+ */
+
+static int file_created(evwatch *w) {
+
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ie;
+	ssize_t len;
+	char *p;
+	int found = 0;
+
+	while ((len = read(w->fd, buf, sizeof(buf))) > 0) {
+
+		for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ie->len) {
+
+			ie = (struct inotify_event *)p;
+			if (ie->len && !strcmp(ie->name, w->name)) found = 1;
+
+		}
+
+	}
+
+	return found;
+
+}
+
+/*
+ * event_poll
+ *
+ * Puts processes whose event fired back in the ready queue.
+ *
+ */
+
+void event_poll() {
+
+	struct epoll_event ev[64];
+	evwatch *w;
+	int n, i, nexit;
+
+	if (ev_epfd == -1) return;
+
+	/* Exits can launch stages waiting on them, which may be gone already */
+	do {
+
+		nexit = 0;
+		n = epoll_wait(ev_epfd, ev, 64, 0);
+
+		for (i = 0; i < n; i++) {
+
+			w = ev[i].data.ptr;
+
+			/* Exits go last, letting go of a node drops its other watches */
+			if (w && w->type == EV_REAP) {
+
+				ev[nexit++].data.ptr = w;
+				continue;
+
+			}
+
+			/* Wheel runs all timers due in one go */
+			if (!w) {
+
+				wheel_run();
+				continue;
+
+			}
+
+			/* Another file showed up in the directory */
+			if (w->type == EV_FILE && !file_created(w)) continue;
+
+			run_node(w->proc);
+
+		}
+
+		for (i = 0; i < nexit; i++) reap(ev[i].data.ptr);
+
+	} while (nexit);
+
+}
+
+/*
+ * event_pollfd
+ *
+ * Returns epoll set of all watches.
+ *
+ */
+
+int event_pollfd() {
+
+	return ev_epfd;
+
+}
@@ -0,0 +1,78 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	event.h
+ *
+ * @Description: Blocking on events. A process can be blocked until one event
+ * 		fires:
+ *
+ * 			fd <n|path>	A descriptor of the process, or a file
+ * 					like a FIFO, becomes readable
+ * 			timer <ms>	Time elapses, on the timer wheel
+ * 			exit <pid>	Another process exits, through a pidfd
+ * 			file <path>	A file appears, through inotify
+ *
+ * 		Every other event is turned into a descriptor and added to one
+ * 		epoll set, pointing back at its watch, so a fired event puts its
+ * 		process back in the ready queue in O(1) without scanning the
+ * 		blocked queue. Timers all go on the wheel, whose one timerfd is
+ * 		in the set too. The watch is closed once it fires, or if the
+ * 		process is run or killed first.
+ *
+ * 		Processes are tracked the same way. The pidfd of every process
+ * 		is in the set with an exit watch, so an exit is handled once it
+ * 		fires instead of by polling waitpid(). The watch owns the pidfd
+ * 		and outlives the node of a process killed, reaping it once it is
+ * 		gone.
+ *
+ * @Functions:
+ *
+ * 	event_block	Blocks a process until an event. Returns 0 on
+ * 			success.
+ *
+ * 	event_cancel	Drops watch of a process, if any.
+ *
+ * 	event_track	Watches pidfd of a process for its exit. Returns 0
+ * 			on success.
+ *
+ * 	event_untrack	Detaches exit watch from a node being destroyed.
+ *
+ * 	event_poll	Runs processes whose event fired. Never blocks.
+ *
+ * 	event_pollfd	Returns descriptor that polls readable when an event
+ * 			fired, -1 if nothing was ever watched.
+ *
+ */
+
+#define __event_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#ifndef __wheel_h_
+	#include "wheel.h"
+#endif
+
+typedef enum evtype {EV_FD, EV_TIMER, EV_EXIT, EV_FILE, EV_REAP} evtype;
+
+typedef struct evwatch {
+	pnode	*proc;			/* NULL once node is gone */
+	evtype	type;
+	int	pid;			/* Process reaped */
+	int	fd;			/* -1 for a timer */
+	char	*name;			/* File waited for */
+	wtimer	timer;
+} evwatch;
+
+int event_block(pnode *proc, char *type, char *arg);
+
+void event_cancel(pnode *proc);
+
+int event_track(pnode *proc, int pidfd);
+
+void event_untrack(pnode *proc);
+
+void event_poll();
+
+int event_pollfd();
+
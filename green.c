@@ -0,0 +1,471 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	green
+ *
+ * @Description: Green tasks
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__)
+	#define GREEN_X86
+#else
+	#include <ucontext.h>
+#endif
+
+#include "green.h"
+#include "proc.h"
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
+
+#ifndef __output_h_
+	#include "output.h"
+#endif
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+/* Room for signal handlers, which never run on a task stack */
+#define GREEN_ALTSTACK	65536
+
+typedef struct gtask {
+#ifdef GREEN_X86
+	void		*sp;			/* Saved while switched out */
+#else
+	ucontext_t	uc;
+#endif
+	char		*stack;
+	pnode		*proc;			/* NULL for the bench task */
+	long		wake;			/* Due time in ms */
+	void		(*body)(struct gtask *t);
+} gtask;
+
+int green_mode = 0;
+
+static int ntasks = 0, npids = 0, ready = 0;
+
+/* Task switched into, NULL in the scheduler */
+static gtask *cur = NULL;
+
+/* Stacks given back, linked through their top word, then the untouched
+ * rest of the last chunk */
+static char *freel = NULL, *fresh = NULL;
+static int nfresh = 0;
+
+#ifdef GREEN_X86
+
+/* Saved while a task runs */
+static void *main_sp;
+
+/* Pushes registers a call keeps, stores stack pointer in *from, then pops
+ * them off the stack at to and returns where it was switched out */
+__attribute__((visibility("hidden"))) void green_swap(void **from, void *to);
+
+/* First return into a new task lands here, task in rbx and entry in r12 */
+__attribute__((visibility("hidden"))) void green_start();
+
+__asm__(
+	".text\n"
+	".globl green_swap\n"
+	".hidden green_swap\n"
+	".type green_swap, @function\n"
+	"green_swap:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size green_swap, .-green_swap\n"
+	".globl green_start\n"
+	".hidden green_start\n"
+	".type green_start, @function\n"
+	"green_start:\n"
+	"	movq %rbx, %rdi\n"
+	"	call *%r12\n"
+	"	ud2\n"
+	".size green_start, .-green_start\n"
+);
+
+#else
+
+static ucontext_t main_uc;
+
+#endif
+
+/*
+ * now_ms
+ *
+ * Returns monotonic time in ms.
+ *
+ */
+
+static long now_ms() {
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+}
+
+/*
+ * setup
+ *
+ * Moves clock interrupt and resize handlers to a stack of their own, so a
+ * signal landing while a task runs doesn't overflow the task's stack.
+ *
+ */
+
+static void setup() {
+
+	stack_t ss;
+	struct sigaction sa;
+	int sigs[] = {SIGALRM, SIGWINCH}, i;
+
+	ready = 1;
+
+	if (!(ss.ss_sp = malloc(GREEN_ALTSTACK))) return;
+
+	ss.ss_size = GREEN_ALTSTACK;
+	ss.ss_flags = 0;
+	sigaltstack(&ss, NULL);
+
+	for (i = 0; i < 2; i++) {
+
+		sigaction(sigs[i], NULL, &sa);
+		sa.sa_flags |= SA_ONSTACK;
+		sigaction(sigs[i], &sa, NULL);
+
+	}
+
+}
+
+/*
+ * take_stack
+ *
+ * Returns a stack, NULL if no more can be mapped.
+ *
+ */
+
+static char* take_stack() {
+
+	char *s;
+
+	if (freel) {
+
+		s = freel;
+		freel = *(char **)(s + GREEN_STACK - sizeof(char *));
+		return s;
+
+	}
+
+	if (!nfresh) {
+
+		fresh = mmap(NULL, (size_t)GREEN_STACK * GREEN_CHUNK, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+		if (fresh == MAP_FAILED) return NULL;
+
+		nfresh = GREEN_CHUNK;
+
+	}
+
+	s = fresh;
+	fresh += GREEN_STACK;
+	nfresh--;
+
+	return s;
+
+}
+
+/*
+ * give_stack
+ *
+ * Puts stack back for the next task.
+ *
+ */
+
+static void give_stack(char *s) {
+
+	*(char **)(s + GREEN_STACK - sizeof(char *)) = freel;
+	freel = s;
+
+}
+
+/*
+ * resume
+ *
+ * Switches from the scheduler into task, until it yields.
+ *
+ */
+
+static void resume(gtask *t) {
+
+	cur = t;
+
+#ifdef GREEN_X86
+	green_swap(&main_sp, t->sp);
+#else
+	swapcontext(&main_uc, &t->uc);
+#endif
+
+	cur = NULL;
+
+}
+
+/*
+ * yield
+ *
+ * Switches from the running task back to the scheduler.
+ *
+ */
+
+static void yield() {
+
+#ifdef GREEN_X86
+	green_swap(&cur->sp, main_sp);
+#else
+	swapcontext(&cur->uc, &main_uc);
+#endif
+
+}
+
+/*
+ * entry
+ *
+ * Runs body of a new task, which never returns.
+ *
+ */
+
+static void entry(gtask *t) {
+
+	t->body(t);
+
+}
+
+#ifndef GREEN_X86
+
+static void uc_entry() {
+
+	entry(cur);
+
+}
+
+#endif
+
+/*
+ * prepare
+ *
+ * Lays out stack of a new task so the first switch into it calls entry.
+ *
+ */
+
+static void prepare(gtask *t) {
+
+#ifdef GREEN_X86
+	/* Aligned for the call in green_start */
+	void **sp = (void **)(t->stack + GREEN_STACK - 16);
+
+	*--sp = (void *)green_start;
+	*--sp = NULL;			/* rbp */
+	*--sp = t;			/* rbx */
+	*--sp = (void *)entry;		/* r12 */
+	*--sp = NULL;			/* r13 */
+	*--sp = NULL;			/* r14 */
+	*--sp = NULL;			/* r15 */
+
+	t->sp = sp;
+#else
+	getcontext(&t->uc);
+	t->uc.uc_stack.ss_sp = t->stack;
+	t->uc.uc_stack.ss_size = GREEN_STACK;
+	t->uc.uc_link = NULL;
+	makecontext(&t->uc, uc_entry, 0);
+#endif
+
+}
+
+/*
+ * logger
+ *
+ * Body of a spawned task, logs its name every second.
+ *
+ */
+
+static void logger(gtask *t) {
+
+	char line[34];
+	int len = snprintf(line, sizeof(line), "%s\n", t->proc->name);
+
+	while (1) {
+
+		out_write(t->proc, line, len);
+
+		t->wake = now_ms() + 1000;
+		yield();
+
+	}
+
+}
+
+/*
+ * pinger
+ *
+ * Body of the bench task, yields right back.
+ *
+ */
+
+static void pinger(gtask *t) {
+
+	while (1) yield();
+
+}
+
+/*
+ * green_spawn
+ *
+ * Creates task and adds it to the ready queue. Returns its pid, -1 with
+ * error set on failure.
+ *
+ */
+
+int green_spawn(char *name) {
+
+	gtask *t = calloc(1, sizeof(gtask));
+
+	if (!ready) setup();
+
+	if (!t || !(t->stack = take_stack())) {
+
+		free(t);
+		sprintf(errstr, "ERROR: Could not create task.");
+		return -1;
+
+	}
+
+	t->body = logger;
+	prepare(t);
+
+	t->proc = pnode_create(GREEN_PID_BASE + npids++, name);
+	t->proc->green = t;
+	ntasks++;
+
+	pnode_add_ready(t->proc);
+
+	return t->proc->pid;
+
+}
+
+/*
+ * green_run
+ *
+ * Switches into the running process and its companions, those that are
+ * tasks and due.
+ *
+ */
+
+void green_run() {
+
+	pnode *run[COSCHED_MAX + 1];
+	long now;
+	int n = 0, i;
+
+	if (!ntasks) return;
+
+	if (running_proc) run[n++] = running_proc;
+	n += cosched_running(run + n);
+
+	for (i = 0, now = now_ms(); i < n; i++) {
+
+		if (!run[i]->green || run[i]->green->wake > now) continue;
+
+		resume(run[i]->green);
+		mstat.green_switches += 2;
+
+	}
+
+}
+
+/*
+ * green_free
+ *
+ * Gives back stack of task going away. Nothing for a process.
+ *
+ */
+
+void green_free(pnode *proc) {
+
+	if (!proc->green) return;
+
+	give_stack(proc->green->stack);
+	free(proc->green);
+
+	proc->green = NULL;
+	ntasks--;
+
+}
+
+/*
+ * green_bench
+ *
+ * Bounces GREEN_ROUNDS times between the scheduler and a task that yields
+ * right back, and formats the time a switch takes into buf.
+ *
+ */
+
+void green_bench(char *buf, int size) {
+
+	struct timespec start, end;
+	gtask t;
+	double ns;
+	int i;
+
+	if (!ready) setup();
+
+	memset(&t, 0, sizeof(t));
+
+	if (!(t.stack = take_stack())) {
+
+		snprintf(buf, size, "ERROR: Could not create task.");
+		return;
+
+	}
+
+	t.body = pinger;
+	prepare(&t);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < GREEN_ROUNDS; i++) resume(&t);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	give_stack(t.stack);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+	snprintf(buf, size, "%d tasks, %.1f ns per switch, %lu switches so far.",
+			ntasks, ns / (2.0 * GREEN_ROUNDS), mstat.green_switches);
+
+}
+
@@ -0,0 +1,66 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	green.h
+ *
+ * @Description: Green tasks. With -g, spawn creates a task running inside the
+ * 		scheduler instead of forking a process. A task has its own
+ * 		small stack and a process node like any other, so it sits in
+ * 		the same queues, is picked by the same policies and shows in
+ * 		the same table, under a pid above any the kernel hands out.
+ * 		Like a spawned process, it logs its name every second.
+ *
+ * 		Stopping and continuing a task costs no signal: the main loop
+ * 		switches into the tasks that run, the head and its companions,
+ * 		whenever they are due, and they switch back once they logged.
+ * 		On x86-64 a switch only saves the registers a call would keep
+ * 		and swaps stacks, without entering the kernel, elsewhere it
+ * 		goes through ucontext. The green command times it.
+ *
+ * 		Stacks are carved out of GREEN_CHUNK at a time from one
+ * 		mapping, which only takes memory for the pages a task touches,
+ * 		and are reused once a task is killed.
+ *
+ * @Constants:
+ *
+ * 	GREEN_PID_BASE	First pid handed out to tasks, over pid_max
+ *
+ * 	GREEN_STACK	Stack size of a task
+ *
+ * 	GREEN_CHUNK	Stacks mapped at once
+ *
+ * 	GREEN_ROUNDS	Switches timed by green_bench
+ *
+ * @Functions:
+ *
+ * 	green_spawn	Creates a task and adds it to the ready queue.
+ * 			Returns its pid, -1 with error set on failure.
+ *
+ * 	green_run	Switches into running tasks that are due.
+ *
+ * 	green_free	Gives back stack of a task going away.
+ *
+ * 	green_bench	Times switches, formats result into buf.
+ *
+ */
+
+#define __green_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define GREEN_PID_BASE	5000000
+#define GREEN_STACK	32768
+#define GREEN_CHUNK	256
+#define GREEN_ROUNDS	1000000
+
+extern int green_mode;
+
+int green_spawn(char *name);
+
+void green_run();
+
+void green_free(pnode *proc);
+
+void green_bench(char *buf, int size);
+
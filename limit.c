@@ -0,0 +1,240 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	limit
+ *
+ * @Description: Resource limits per process
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "limit.h"
+
+long limit_default[LIM_COUNT] = {0};
+int limit_rss_used = 0;
+
+static char *names[LIM_COUNT] = {"rss", "cpu", "fds"};
+static int rlims[LIM_COUNT] = {-1, RLIMIT_CPU, RLIMIT_NOFILE};
+
+/*
+ * limit_res
+ *
+ * Returns resource named by string, -1 if none.
+ *
+ */
+
+int limit_res(char *name) {
+
+	int i;
+
+	for (i = 0; i < LIM_COUNT; i++)
+		if (!strcasecmp(name, names[i])) return i;
+
+	return -1;
+
+}
+
+/*
+ * limit_value
+ *
+ * Parses value with optional K, M or G suffix. Returns -1 on error.
+ *
+ */
+
+long limit_value(char *str) {
+
+	char *end;
+	long value = strtol(str, &end, 10);
+
+	if (end == str || value < 0) return -1;
+
+	switch (*end) {
+
+		case 'G': case 'g':	value <<= 10;
+		case 'M': case 'm':	value <<= 10;
+		case 'K': case 'k':	value <<= 10;
+					end++;
+
+	}
+
+	return *end ? -1 : value;
+
+}
+
+/*
+ * limit_init
+ *
+ * Parses default limits like rss=512M,cpu=60,fds=256. Returns 0 on success,
+ * -1 otherwise.
+ *
+ */
+
+int limit_init(char *spec) {
+
+	char buf[128], *tok, *eq, *save;
+	int res;
+	long value;
+
+	strncpy(buf, spec, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = 0;
+
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+
+		if ((eq = strchr(tok, '=')) == NULL) return -1;
+
+		*eq = 0;
+
+		if ((res = limit_res(tok)) < 0 || (value = limit_value(eq + 1)) < 0) return -1;
+
+		limit_default[res] = value;
+		limit_rss_used |= res == LIM_RSS && value;
+
+	}
+
+	return 0;
+
+}
+
+/*
+ * limit_child
+ *
+ * Applies default rlimits to calling process. Cpu soft limit sends SIGXCPU,
+ * hard limit a second later kills.
+ *
+ */
+
+void limit_child() {
+
+	struct rlimit rl;
+	int i;
+
+	for (i = 0; i < LIM_COUNT; i++) {
+
+		if (rlims[i] < 0 || !limit_default[i]) continue;
+
+		rl.rlim_cur = limit_default[i];
+		rl.rlim_max = i == LIM_CPU ? limit_default[i] + 1 : limit_default[i];
+
+		setrlimit(rlims[i], &rl);
+
+	}
+
+}
+
+/*
+ * limit_set
+ *
+ * Sets limit of running process, 0 for none. Returns 0 on success, -1 with
+ * error set otherwise.
+ *
+ */
+
+int limit_set(pnode *proc, lres res, long value) {
+
+	struct rlimit rl;
+
+	if (res == LIM_RSS) {
+
+		limit_rss_used |= value != 0;
+		proc->rss_max = value;
+
+		return 0;
+
+	}
+
+	rl.rlim_cur = value ? value : RLIM_INFINITY;
+	rl.rlim_max = value ? (res == LIM_CPU ? value + 1 : value) : RLIM_INFINITY;
+
+	/* Raising hard limit needs privileges, keep it and only lower soft */
+	if (prlimit(proc->pid, rlims[res], &rl, NULL)) {
+
+		struct rlimit old;
+
+		if (prlimit(proc->pid, rlims[res], NULL, &old) || 
+				(old.rlim_max != RLIM_INFINITY && rl.rlim_cur > old.rlim_max)) {
+
+			sprintf(errstr, "ERROR: Could not set %s limit of process %d.", 
+					names[res], proc->pid);
+			return -1;
+
+		}
+
+		rl.rlim_max = old.rlim_max;
+		prlimit(proc->pid, rlims[res], &rl, NULL);
+
+	}
+
+	return 0;
+
+}
+
+/*
+ * proc_rss
+ *
+ * Returns resident memory of process in bytes, read from /proc/<pid>/statm.
+ * Returns 0 if process is gone.
+ *
+ */
+
+long proc_rss(pnode *proc) {
+
+	char path[32];
+	FILE *f;
+	long size, rss = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/statm", proc->pid);
+
+	if ((f = fopen(path, "r")) == NULL) return 0;
+
+	if (fscanf(f, "%ld %ld", &size, &rss) != 2) rss = 0;
+
+	fclose(f);
+
+	return rss * sysconf(_SC_PAGESIZE);
+
+}
+
+/*
+ * fmt_limit
+ *
+ * Formats limit value, "none" if unlimited.
+ *
+ */
+
+static char* fmt_limit(char *buf, long value) {
+
+	if (!value || value == (long)RLIM_INFINITY) strcpy(buf, "none");
+	else sprintf(buf, "%ld", value);
+
+	return buf;
+
+}
+
+/*
+ * limit_show
+ *
+ * Formats memory use and every limit of process.
+ *
+ */
+
+void limit_show(pnode *proc, char *buf, int size) {
+
+	struct rlimit cpu = {0, 0}, fds = {0, 0};
+	char c[24], f[24], r[24] = "none";
+
+	prlimit(proc->pid, RLIMIT_CPU, NULL, &cpu);
+	prlimit(proc->pid, RLIMIT_NOFILE, NULL, &fds);
+
+	if (proc->rss_max) sprintf(r, "%ldK", proc->rss_max >> 10);
+
+	snprintf(buf, size, "Process %d: rss %ldK of %s, cpu %s s, fds %s.", proc->pid, 
+			proc_rss(proc) >> 10, r, fmt_limit(c, cpu.rlim_cur), fmt_limit(f, fds.rlim_cur));
+
+}
@@ -0,0 +1,62 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	limit.h
+ *
+ * @Description: Resource limits per process. Cpu time and open files are
+ * 		kernel rlimits, set with setrlimit() by a new child before it
+ * 		runs anything and with prlimit() on a running process. Linux
+ * 		ignores RLIMIT_RSS, so resident memory is enforced by the
+ * 		pressure monitor instead, which blocks a process over its limit
+ * 		rather than letting the OOM killer have it. See pressure.h.
+ *
+ * 		Values take a K, M or G suffix.
+ *
+ * @Functions:
+ *
+ * 	limit_init	Parses default limits of new processes, like
+ * 			rss=512M,cpu=60,fds=256. Returns 0 on success.
+ *
+ * 	limit_res	Returns resource named by a string, -1 if none.
+ *
+ * 	limit_value	Parses a limit value. Returns -1 on error.
+ *
+ * 	limit_child	Applies default limits to calling process, in a
+ * 			new child.
+ *
+ * 	limit_set	Sets limit of a running process, 0 for none.
+ * 			Returns 0 on success.
+ *
+ * 	limit_show	Formats usage and limits of a process.
+ *
+ * 	proc_rss	Returns resident memory of a process in bytes.
+ *
+ */
+
+#define __limit_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+typedef enum lres {LIM_RSS, LIM_CPU, LIM_FDS, LIM_COUNT} lres;
+
+/* Limits of new processes, 0 for none */
+extern long limit_default[LIM_COUNT];
+
+/* Set once any process has a memory limit */
+extern int limit_rss_used;
+
+int limit_init(char *spec);
+
+int limit_res(char *name);
+
+long limit_value(char *str);
+
+void limit_child();
+
+int limit_set(pnode *proc, lres res, long value);
+
+void limit_show(pnode *proc, char *buf, int size);
+
+long proc_rss(pnode *proc);
+
@@ -0,0 +1,297 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	metrics
+ *
+ * @Description: Scheduler metrics exporter
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "proc.h"
+#include "perf.h"
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
+
+/* Counters, written by scheduling code only */
+volatile metrics mstat;
+
+/* Logs a line, in ui.c */
+void log_add_line(char *buffer);
+
+/* Exporter state */
+static char *mpath = NULL;
+static struct timespec armed_at, last_write;
+static int armed = 0;
+
+/* Values at last write, used to compute rates */
+static unsigned long last_ctx, last_spawns, last_kills, last_bytes;
+
+/* Upper bounds of jitter buckets in ns, the last bucket has none */
+static const unsigned long jitter_le[JITTER_BUCKETS - 1] = {
+	1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+/*
+ * ts_ns
+ *
+ * Converts timespec to nanoseconds
+ *
+ */
+
+static unsigned long long ts_ns(struct timespec *ts) {
+
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+
+}
+
+/*
+ * metrics_open
+ *
+ * Sets file metrics are written to. Metrics are only written if this is
+ * called.
+ *
+ */
+
+void metrics_open(char *path) {
+
+	mpath = path;
+	clock_gettime(CLOCK_MONOTONIC, &last_write);
+
+}
+
+/*
+ * metrics_armed
+ *
+ * Records when next clock interrupt should fire. Safe in signal handler.
+ *
+ */
+
+void metrics_armed() {
+
+	clock_gettime(CLOCK_MONOTONIC, &armed_at);
+	armed_at.tv_sec += QUANTUM;
+	armed = 1;
+
+}
+
+/*
+ * metrics_tick
+ *
+ * Called by clock interrupt handler. Measures how late it fired compared to
+ * the quantum. Safe in signal handler.
+ *
+ */
+
+void metrics_tick() {
+
+	struct timespec now;
+	unsigned long long late;
+	int i;
+
+	if (!armed) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	late = ts_ns(&now) > ts_ns(&armed_at) ? ts_ns(&now) - ts_ns(&armed_at) : 0;
+
+	mstat.ticks++;
+	mstat.jitter_ns_last = late;
+	mstat.jitter_ns_sum += late;
+	if (late > mstat.jitter_ns_max) mstat.jitter_ns_max = late;
+
+	for (i = 0; i < JITTER_BUCKETS - 1 && late > jitter_le[i]; i++);
+	mstat.jitter_hist[i]++;
+
+}
+
+/*
+ * metrics_write
+ *
+ * Writes metrics file if at least a second went by since last write.
+ *
+ */
+
+void metrics_write() {
+
+	struct timespec now, cpu;
+	char tmp[256];
+	FILE *f;
+	double dt;
+	unsigned long ctx = ctx_switches, spawns = mstat.spawns, kills = mstat.kills,
+		bytes = mstat.pipe_bytes, n;
+	pnode *co[COSCHED_MAX];
+	int running = head ? 1 + cosched_running(co) : 0, i;
+
+	if (!mpath) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	dt = (ts_ns(&now) - ts_ns(&last_write)) / 1e9;
+	if (dt < 1.0) return;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", mpath);
+
+	if ((f = fopen(tmp, "w")) == NULL) return;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+	fprintf(f, "# HELP sched_tasks Number of tasks by state.\n");
+	fprintf(f, "# TYPE sched_tasks gauge\n");
+	fprintf(f, "sched_tasks{state=\"running\"} %d\n", running);
+	fprintf(f, "sched_tasks{state=\"ready\"} %d\n", nready - running);
+	fprintf(f, "sched_tasks{state=\"blocked\"} %d\n", nblocked);
+
+	fprintf(f, "# HELP sched_runqueue_length Number of tasks in the ready queue.\n");
+	fprintf(f, "# TYPE sched_runqueue_length gauge\n");
+	fprintf(f, "sched_runqueue_length %d\n", nready);
+
+	fprintf(f, "# HELP sched_context_switches_total Times the cpu changed hands.\n");
+	fprintf(f, "# TYPE sched_context_switches_total counter\n");
+	fprintf(f, "sched_context_switches_total %lu\n", ctx);
+	fprintf(f, "# HELP sched_context_switches_per_second Context switch rate.\n");
+	fprintf(f, "# TYPE sched_context_switches_per_second gauge\n");
+	fprintf(f, "sched_context_switches_per_second %.3f\n", (ctx - last_ctx) / dt);
+
+	fprintf(f, "# HELP sched_spawns_total Processes spawned or executed.\n");
+	fprintf(f, "# TYPE sched_spawns_total counter\n");
+	fprintf(f, "sched_spawns_total %lu\n", spawns);
+	fprintf(f, "# HELP sched_spawns_per_second Spawn rate.\n");
+	fprintf(f, "# TYPE sched_spawns_per_second gauge\n");
+	fprintf(f, "sched_spawns_per_second %.3f\n", (spawns - last_spawns) / dt);
+
+	fprintf(f, "# HELP sched_kills_total Processes killed.\n");
+	fprintf(f, "# TYPE sched_kills_total counter\n");
+	fprintf(f, "sched_kills_total %lu\n", kills);
+	fprintf(f, "# HELP sched_kills_per_second Kill rate.\n");
+	fprintf(f, "# TYPE sched_kills_per_second gauge\n");
+	fprintf(f, "sched_kills_per_second %.3f\n", (kills - last_kills) / dt);
+
+	fprintf(f, "# HELP sched_triggers_total Actions taken on output triggers.\n");
+	fprintf(f, "# TYPE sched_triggers_total counter\n");
+	fprintf(f, "sched_triggers_total %lu\n", mstat.triggers);
+
+	fprintf(f, "# HELP sched_triggers_dropped_total Trigger matches dropped, action queue full.\n");
+	fprintf(f, "# TYPE sched_triggers_dropped_total counter\n");
+	fprintf(f, "sched_triggers_dropped_total %lu\n", mstat.triggers_dropped);
+
+	fprintf(f, "# HELP sched_archive_bytes_total Output archived, before and after compression.\n");
+	fprintf(f, "# TYPE sched_archive_bytes_total counter\n");
+	fprintf(f, "sched_archive_bytes_total{stage=\"raw\"} %lu\n", mstat.arch_in);
+	fprintf(f, "sched_archive_bytes_total{stage=\"compressed\"} %lu\n", mstat.arch_out);
+
+	fprintf(f, "# HELP sched_archive_dropped_blocks_total Blocks dropped, compression falling behind or archive not writable.\n");
+	fprintf(f, "# TYPE sched_archive_dropped_blocks_total counter\n");
+	fprintf(f, "sched_archive_dropped_blocks_total %lu\n", mstat.arch_dropped);
+
+	fprintf(f, "# HELP sched_green_switches_total Switches into and out of green tasks.\n");
+	fprintf(f, "# TYPE sched_green_switches_total counter\n");
+	fprintf(f, "sched_green_switches_total %lu\n", mstat.green_switches);
+
+	fprintf(f, "# HELP sched_tick_jitter_seconds How late the clock interrupt fired.\n");
+	fprintf(f, "# TYPE sched_tick_jitter_seconds histogram\n");
+
+	for (i = 0, n = 0; i < JITTER_BUCKETS - 1; i++) {
+
+		n += mstat.jitter_hist[i];
+		fprintf(f, "sched_tick_jitter_seconds_bucket{le=\"%g\"} %lu\n", jitter_le[i] / 1e9, n);
+
+	}
+
+	fprintf(f, "sched_tick_jitter_seconds_bucket{le=\"+Inf\"} %lu\n", n + mstat.jitter_hist[i]);
+	fprintf(f, "sched_tick_jitter_seconds_sum %.9f\n", mstat.jitter_ns_sum / 1e9);
+	fprintf(f, "sched_tick_jitter_seconds_count %lu\n", mstat.ticks);
+	fprintf(f, "# HELP sched_tick_jitter_last_seconds Lateness of last clock interrupt.\n");
+	fprintf(f, "# TYPE sched_tick_jitter_last_seconds gauge\n");
+	fprintf(f, "sched_tick_jitter_last_seconds %.9f\n", mstat.jitter_ns_last / 1e9);
+	fprintf(f, "# HELP sched_tick_jitter_max_seconds Worst lateness seen.\n");
+	fprintf(f, "# TYPE sched_tick_jitter_max_seconds gauge\n");
+	fprintf(f, "sched_tick_jitter_max_seconds %.9f\n", mstat.jitter_ns_max / 1e9);
+
+	fprintf(f, "# HELP sched_pipe_bytes_total Bytes read from children output.\n");
+	fprintf(f, "# TYPE sched_pipe_bytes_total counter\n");
+	fprintf(f, "sched_pipe_bytes_total %lu\n", bytes);
+	fprintf(f, "# HELP sched_pipe_bytes_per_second Children output rate.\n");
+	fprintf(f, "# TYPE sched_pipe_bytes_per_second gauge\n");
+	fprintf(f, "sched_pipe_bytes_per_second %.3f\n", (bytes - last_bytes) / dt);
+	fprintf(f, "# HELP sched_io_syscalls_total System calls made to drain children output.\n");
+	fprintf(f, "# TYPE sched_io_syscalls_total counter\n");
+	fprintf(f, "sched_io_syscalls_total %lu\n", mstat.io_syscalls);
+
+	fprintf(f, "# HELP sched_output_throttled_bytes_total Output dropped over budget.\n");
+	fprintf(f, "# TYPE sched_output_throttled_bytes_total counter\n");
+	fprintf(f, "sched_output_throttled_bytes_total %lu\n", mstat.out_throttled);
+
+	fprintf(f, "# HELP sched_pressure_blocks_total Processes blocked over memory limit or pressure.\n");
+	fprintf(f, "# TYPE sched_pressure_blocks_total counter\n");
+	fprintf(f, "sched_pressure_blocks_total %lu\n", mstat.pressure_blocks);
+
+	perf_metrics(f);
+
+	fprintf(f, "# HELP sched_cpu_seconds_total Cpu time used by the scheduler itself.\n");
+	fprintf(f, "# TYPE sched_cpu_seconds_total counter\n");
+	fprintf(f, "sched_cpu_seconds_total %.6f\n", ts_ns(&cpu) / 1e9);
+
+	fclose(f);
+
+	/* Replace file in one step */
+	rename(tmp, mpath);
+
+	last_write = now;
+	last_ctx = ctx;
+	last_spawns = spawns;
+	last_kills = kills;
+	last_bytes = bytes;
+
+}
+
+/*
+ * metrics_enabled
+ *
+ * Returns 1 if metrics file is written.
+ *
+ */
+
+int metrics_enabled() {
+
+	return mpath != NULL;
+
+}
+
+/*
+ * metrics_jitter
+ *
+ * Logs count of clock interrupts per bucket of lateness, with a bar each,
+ * and formats a summary.
+ *
+ */
+
+void metrics_jitter(char *buf, int size) {
+
+	static char *names[JITTER_BUCKETS] = {"<= 1 us", "<= 10 us", "<= 100 us", "<= 1 ms", 
+		"<= 10 ms", "<= 100 ms", "> 100 ms"};
+	char line[80], bar[JITTER_BAR + 1];
+	unsigned long top = 1;
+	int i, n;
+
+	for (i = 0; i < JITTER_BUCKETS; i++)
+		if (mstat.jitter_hist[i] > top) top = mstat.jitter_hist[i];
+
+	for (i = 0; i < JITTER_BUCKETS; i++) {
+
+		n = mstat.jitter_hist[i] * JITTER_BAR / top;
+		memset(bar, '#', n);
+		bar[n] = 0;
+
+		snprintf(line, sizeof(line), "%-10s %8lu %s", names[i], mstat.jitter_hist[i], bar);
+		log_add_line(line);
+
+	}
+
+	snprintf(buf, size, "Jitter of %lu ticks, worst %.3f ms.", mstat.ticks, mstat.jitter_ns_max / 1e6);
+
+}
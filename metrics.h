@@ -0,0 +1,74 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	metrics.h
+ *
+ * @Description: Scheduler metrics. Counters are plain integers bumped in place
+ * 		by the scheduling code, including the clock interrupt handler, and
+ * 		only ever read by the exporter. Nothing is locked. The exporter
+ * 		writes them in Prometheus text format to a file (for the node
+ * 		exporter textfile collector) once per second, through a temporary
+ * 		file and rename() so a scraper never sees a partial file.
+ *
+ * @Functions:
+ *
+ * 	metrics_open	Sets file metrics are written to.
+ *
+ * 	metrics_armed	Records when the clock interrupt is expected.
+ * 			Called whenever the quantum restarts.
+ *
+ * 	metrics_tick	Measures how late the clock interrupt fired.
+ *
+ * 	metrics_write	Writes metrics file if a second has elapsed since
+ * 			last write.
+ *
+ * 	metrics_enabled	Returns 1 if metrics are written.
+ *
+ * 	metrics_jitter	Logs histogram of clock interrupt lateness and
+ * 			formats a summary.
+ *
+ */
+
+#define __metrics_h_
+
+#include <stdio.h>
+#include <time.h>
+
+/* Lateness histogram, buckets of 1 us to 100 ms by tenfold steps, and the
+ * longest bar it is logged with */
+#define JITTER_BUCKETS	7
+#define JITTER_BAR	40
+
+typedef struct metrics {
+	unsigned long	spawns;
+	unsigned long	kills;
+	unsigned long	pipe_bytes;
+	unsigned long	io_syscalls;	/* Spent draining output */
+	unsigned long	out_throttled;
+	unsigned long	pressure_blocks;
+	unsigned long	ticks;
+	unsigned long	jitter_ns_sum;
+	unsigned long	jitter_ns_max;
+	unsigned long	jitter_ns_last;
+	unsigned long	jitter_hist[JITTER_BUCKETS];	/* Last one is over 100 ms */
+	unsigned long	green_switches;
+	unsigned long	triggers;
+	unsigned long	triggers_dropped;	/* Queue full */
+	unsigned long	arch_in;	/* Archived, before compression */
+	unsigned long	arch_out;
+	unsigned long	arch_dropped;	/* Blocks */
+} metrics;
+
+extern volatile metrics mstat;
+
+void metrics_open(char *path);
+
+void metrics_armed();
+
+void metrics_tick();
+
+void metrics_write();
+
+int metrics_enabled();
+
+void metrics_jitter(char *buf, int size);
+
@@ -0,0 +1,444 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	output
+ *
+ * @Description: Per process output channels with budgets
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+#include "output.h"
+#include "metrics.h"
+#include "plog.h"
+#include "uring.h"
+#include "trig.h"
+#include "arch.h"
+
+/* Budget given to new channels, set with -b */
+long out_default_budget = 0;
+int out_default_policy = OUT_DROP;
+
+/* Every channel is registered here, unless io_uring reads them */
+static int out_epfd = -1;
+static int out_uring = 0;
+
+/* Bytes read by the completions of a drain */
+static int out_drained;
+
+/* Logs a line, in ui.c */
+void log_add_line(char *buffer);
+
+/*
+ * close_fds
+ *
+ * Closes descriptors from lo to hi included.
+ *
+ */
+
+static void close_fds(unsigned int lo, unsigned int hi) {
+
+	if (lo > hi) return;
+
+	/* Fall back on a loop if close_range() is not supported */
+	if (syscall(SYS_close_range, lo, hi, 0) == -1) {
+
+		if (hi > 1023) hi = 1023;
+		while (lo <= hi) close(lo++);
+
+	}
+
+}
+
+/*
+ * out_child
+ *
+ * Closes descriptors inherited from the scheduler, which include the pipes of
+ * every other process, except standard streams and the child's own pipe.
+ *
+ */
+
+void out_child(int keep_r, int keep_w) {
+
+	int lo = keep_r < keep_w ? keep_r : keep_w;
+	int hi = keep_r < keep_w ? keep_w : keep_r;
+
+	close_fds(3, lo - 1);
+	close_fds(lo + 1, hi - 1);
+	close_fds(hi + 1, ~0U);
+
+}
+
+/*
+ * out_init
+ *
+ * Selects backend. io_uring is used unless epoll is asked for or io_uring
+ * is not available. Returns 1 for io_uring, 0 for epoll.
+ *
+ */
+
+int out_init(int epoll_only) {
+
+	out_uring = !epoll_only && !uring_init();
+
+	return out_uring;
+
+}
+
+/*
+ * out_attach
+ *
+ * Attaches read end of pipe rfd to process. cfd is the number the child knows
+ * the read end by, kept for a restarted scheduler to find the pipe again.
+ *
+ */
+
+void out_attach(pnode *proc, int rfd, int cfd) {
+
+	struct epoll_event ev;
+	ochan *och = calloc(1, sizeof(ochan));
+
+	och->fd = rfd;
+	och->cfd = cfd;
+	och->proc = proc;
+	och->budget = out_default_budget;
+	och->policy = out_default_policy;
+
+	/* Scheduler never blocks on output, nor leaks it into exec'd children */
+	fcntl(rfd, F_SETFL, fcntl(rfd, F_GETFL, 0) | O_NONBLOCK);
+	fcntl(rfd, F_SETFD, FD_CLOEXEC);
+
+	proc->och = och;
+
+	/* Read stays posted until the pipe is closed */
+	if (out_uring && !uring_read(rfd, och) && uring_submit() >= 0) {
+
+		och->armed = 1;
+
+	} else {
+
+		if (out_epfd == -1) {
+
+			out_epfd = epoll_create1(EPOLL_CLOEXEC);
+
+			/* Ring is watched along, so one descriptor still polls both */
+			ev.events = EPOLLIN;
+			ev.data.ptr = NULL;
+			if (out_uring) epoll_ctl(out_epfd, EPOLL_CTL_ADD, uring_fd(), &ev);
+
+		}
+
+		/* Keyed on the channel, which outlives the node until removed */
+		ev.events = EPOLLIN;
+		ev.data.ptr = och;
+		epoll_ctl(out_epfd, EPOLL_CTL_ADD, rfd, &ev);
+		mstat.io_syscalls++;
+
+	}
+
+	plog_attach(proc);
+
+}
+
+/*
+ * out_detach
+ *
+ * Closes channel of process, if any.
+ *
+ */
+
+void out_detach(pnode *proc) {
+
+	ochan *och = proc->och;
+
+	if (!och) return;
+
+	plog_detach(proc);
+
+	/* Child still holds the read end, so closing alone would leave the
+	 * descriptor registered, pointing at a freed channel */
+	if (och->fd != -1) {
+
+		if (!och->armed && out_epfd != -1) epoll_ctl(out_epfd, EPOLL_CTL_DEL, och->fd, NULL);
+		close(och->fd);
+
+	}
+
+	proc->och = NULL;
+
+	/* Posted read still points at channel, freed once cancelled */
+	if (och->armed) {
+
+		och->proc = NULL;
+		uring_cancel(och);
+		uring_submit();
+		return;
+
+	}
+
+	free(och);
+
+}
+
+/*
+ * out_throttle
+ *
+ * Sets budget in bytes per second (0 for none) and over budget policy.
+ *
+ */
+
+void out_throttle(pnode *proc, long budget, int policy) {
+
+	if (!proc->och) return;
+
+	proc->och->budget = budget;
+	proc->och->policy = policy;
+
+}
+
+/*
+ * out_line
+ *
+ * Logs a complete line, unless process is over budget.
+ *
+ */
+
+static void out_line(pnode *proc) {
+
+	ochan *och = proc->och;
+	struct timespec now;
+	long n = och->len;
+
+	och->line[och->len] = 0;
+	och->len = 0;
+
+	if (och->budget) {
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		/* New second, new budget */
+		if (now.tv_sec != och->window) {
+
+			och->window = now.tv_sec;
+			och->used = 0;
+
+		}
+
+		och->used += n;
+
+		/* Over budget, drop it or keep a sample */
+		if (och->used > och->budget && (och->policy == OUT_DROP || 
+					och->sampled++ % OUT_SAMPLE)) {
+
+			och->throttled += n;
+			mstat.out_throttled += n;
+			return;
+
+		}
+
+	}
+
+	plog_write(proc, och->line, n);
+	arch_write(proc, och->line, n);
+	log_add_line(och->line);
+
+}
+
+/*
+ * out_feed
+ *
+ * Reassembles lines out of count bytes of output.
+ *
+ */
+
+static void out_feed(pnode *proc, char *buffer, int count) {
+
+	ochan *och = proc->och;
+	int i;
+
+	/* Patterns are matched on the stream, before lines are cut */
+	trig_scan(proc, buffer, count);
+
+	for (i = 0; i < count; i++) {
+
+		/* Some children write the string terminator too */
+		if (!buffer[i]) continue;
+
+		och->line[och->len++] = buffer[i];
+
+		/* Line is complete, or too long and gets split */
+		if (buffer[i] == '\n' || och->len == OUT_LINE - 2) {
+
+			if (buffer[i] != '\n') och->line[och->len++] = '\n';
+			out_line(proc);
+
+		}
+
+	}
+
+}
+
+/*
+ * out_write
+ *
+ * Takes output of a task running inside the scheduler as if read from its
+ * pipe. It has none, so its channel is opened on first output.
+ *
+ */
+
+void out_write(pnode *proc, char *buffer, int count) {
+
+	ochan *och = proc->och;
+
+	if (!och) {
+
+		och = calloc(1, sizeof(ochan));
+
+		och->fd = och->cfd = -1;
+		och->proc = proc;
+		och->budget = out_default_budget;
+		och->policy = out_default_policy;
+
+		proc->och = och;
+		plog_attach(proc);
+
+	}
+
+	och->bytes += count;
+	out_feed(proc, buffer, count);
+
+}
+
+/*
+ * out_read
+ *
+ * Reads what process has written, up to OUT_PASS bytes. Returns bytes read.
+ *
+ */
+
+static int out_read(pnode *proc) {
+
+	ochan *och = proc->och;
+	char buffer[4096];
+	int count = -1, total = 0;
+
+	while (total < OUT_PASS) {
+
+		count = read(och->fd, buffer, sizeof(buffer));
+		mstat.io_syscalls++;
+
+		if (count <= 0) break;
+
+		total += count;
+		out_feed(proc, buffer, count);
+
+	}
+
+	/* Every writer is gone, stop watching pipe */
+	if (!count) epoll_ctl(out_epfd, EPOLL_CTL_DEL, och->fd, NULL);
+
+	och->bytes += total;
+
+	return total;
+
+}
+
+/*
+ * out_complete
+ *
+ * Completion of a posted read. A read ends at end of file, once cancelled,
+ * or when the kernel ran out of buffers, in which case it is posted again.
+ *
+ */
+
+static void out_complete(void *tag, char *buf, int res, int more) {
+
+	ochan *och = tag;
+
+	if (!more) och->armed = 0;
+
+	if (!och->proc) {
+
+		if (!och->armed) free(och);
+		return;
+
+	}
+
+	if (res > 0) {
+
+		och->bytes += res;
+		out_drained += res;
+		out_feed(och->proc, buf, res);
+
+	}
+
+	if (!och->armed && (res > 0 || res == -ENOBUFS) && !uring_read(och->fd, och))
+		och->armed = 1;
+
+}
+
+/*
+ * out_drain
+ *
+ * Reads pending output of all processes. Never blocks. Returns bytes read.
+ *
+ */
+
+int out_drain() {
+
+	struct epoll_event ev[64];
+	int n, i, total = 0;
+
+	/* Completions are in memory, reads posted again go in one call */
+	if (out_uring) {
+
+		out_drained = 0;
+
+		uring_reap(out_complete);
+		uring_submit();
+
+		total = out_drained;
+
+	}
+
+	if (out_epfd != -1) {
+
+		n = epoll_wait(out_epfd, ev, 64, 0);
+		mstat.io_syscalls++;
+
+	} else n = 0;
+
+	for (i = 0; i < n; i++) {
+
+		ochan *och = ev[i].data.ptr;
+
+		/* Ring was reaped above */
+		if (och && och->proc) total += out_read(och->proc);
+
+	}
+
+	mstat.pipe_bytes += total;
+
+	return total;
+
+}
+
+/*
+ * out_pollfd
+ *
+ * Returns ring or epoll set of all channels, readable when one has output.
+ *
+ */
+
+int out_pollfd() {
+
+	return out_epfd == -1 && out_uring ? uring_fd() : out_epfd;
+
+}
@@ -0,0 +1,109 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	output.h
+ *
+ * @Description: Output channels. Every process writes into its own pipe, so a
+ * 		chatty process that fills its pipe only ever blocks itself. The
+ * 		scheduler posts a multishot read on every pipe to an io_uring,
+ * 		see uring.h, and reassembles lines out of its completions before
+ * 		logging them. Draining then takes no system call at all.
+ *
+ * 		Where io_uring can't be used, or with -E, pipes are drained
+ * 		through one epoll set instead, reading until each is empty (up
+ * 		to OUT_PASS bytes per process per pass).
+ *
+ * 		Each channel can have an output budget in bytes per second. Once
+ * 		a process went over budget for the current second, its lines are
+ * 		either dropped or sampled (one line out of OUT_SAMPLE is kept).
+ * 		Bytes not logged are counted as throttled. Lines logged are
+ * 		also appended to the persistent log of the process, see plog.h.
+ *
+ * @Constants:
+ *
+ * 	OUT_LINE	Longest line, longer lines are split
+ *
+ * 	OUT_PASS	Most bytes read from one process per drain pass
+ *
+ * 	OUT_SAMPLE	Over budget, keep one line out of OUT_SAMPLE
+ *
+ * 	OUT_DROP	Policy: drop lines over budget
+ *
+ * 	OUT_SAMPLING	Policy: sample lines over budget
+ *
+ * @Functions:
+ *
+ * 	out_init	Selects io_uring, unless told to use epoll or it
+ * 			is not available. Returns 1 for io_uring.
+ *
+ * 	out_child	Called in a new child. Closes descriptors inherited
+ * 			from the scheduler except the child's own pipe.
+ *
+ * 	out_attach	Attaches read end of a pipe to a process node.
+ *
+ * 	out_detach	Closes process channel.
+ *
+ * 	out_write	Logs output of a task without a pipe, see green.h.
+ *
+ * 	out_drain	Reads everything pending on all channels and logs
+ * 			it. Returns number of bytes read.
+ *
+ * 	out_throttle	Sets output budget and policy of a channel.
+ *
+ * 	out_pollfd	Returns descriptor that polls readable when some
+ * 			channel has output, -1 if there is no channel.
+ *
+ */
+
+#define __output_h_
+
+#include <stdio.h>
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define OUT_LINE	256
+#define OUT_PASS	65536
+#define OUT_SAMPLE	10
+
+#define OUT_DROP	0
+#define OUT_SAMPLING	1
+
+typedef struct ochan {
+	int		fd;		/* Read end of pipe in the scheduler */
+	int		cfd;		/* Same pipe as numbered in the child */
+	char		line[OUT_LINE];	/* Partial line */
+	int		len;
+	long		budget;		/* Bytes per second, 0 is unlimited */
+	int		policy;
+	long		window;		/* Second the usage below belongs to */
+	long		used;
+	unsigned long	sampled;	/* Lines seen over budget */
+	unsigned long	bytes;		/* Bytes read */
+	unsigned long	throttled;	/* Bytes not logged */
+	struct plog	*plog;		/* Persistent log */
+	pnode		*proc;		/* NULL once detached */
+	int		armed;		/* Read posted on the ring */
+	int		tstate;		/* Trigger automaton state, see trig.h */
+	int		tgen;		/* Automaton it belongs to */
+} ochan;
+
+extern long out_default_budget;
+extern int out_default_policy;
+
+int out_init(int epoll_only);
+
+void out_child(int keep_r, int keep_w);
+
+void out_attach(pnode *proc, int rfd, int cfd);
+
+void out_detach(pnode *proc);
+
+void out_write(pnode *proc, char *buffer, int count);
+
+int out_drain();
+
+void out_throttle(pnode *proc, long budget, int policy);
+
+int out_pollfd();
+
@@ -0,0 +1,272 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	perf
+ *
+ * @Description: Hardware performance counters
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+#include "sim.h"
+
+static int perf_on = 0;
+static struct timespec last_sample;
+
+/* Type and config of each counter */
+static const struct {
+	unsigned int	type;
+	unsigned long	config;
+	char		*name;
+} counters[PERF_NCOUNTERS] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,		"cycles" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,	"instructions" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,	"llc_references" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,	"llc_misses" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,	"context_switches" }
+};
+
+/*
+ * perf_init
+ *
+ * Turns counters on.
+ *
+ */
+
+void perf_init() {
+
+	perf_on = 1;
+	clock_gettime(CLOCK_MONOTONIC, &last_sample);
+
+}
+
+/*
+ * perf_open
+ *
+ * Opens every counter on process, which must not have run yet. Context
+ * switches happen in the kernel and are counted there, the rest only in
+ * user mode.
+ *
+ */
+
+void perf_open(pnode *proc) {
+
+	struct perf_event_attr attr;
+	pcount *pc;
+	int i;
+
+	if (!perf_on || sim_mode) return;
+
+	pc = calloc(1, sizeof(pcount));
+	pc->ipc = pc->miss = pc->miss_rate = -1;
+
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = counters[i].type;
+		attr.config = counters[i].config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.inherit = 1;
+		attr.exclude_kernel = i != PERF_CTXSW;
+		attr.exclude_hv = 1;
+
+		pc->fd[i] = syscall(SYS_perf_event_open, &attr, proc->pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+
+	}
+
+	proc->perf = pc;
+
+}
+
+/*
+ * perf_close
+ *
+ * Closes counters of process, if any.
+ *
+ */
+
+void perf_close(pnode *proc) {
+
+	int i;
+
+	if (!proc->perf) return;
+
+	for (i = 0; i < PERF_NCOUNTERS; i++)
+		if (proc->perf->fd[i] != -1) close(proc->perf->fd[i]);
+
+	free(proc->perf);
+	proc->perf = NULL;
+
+}
+
+/*
+ * read_counter
+ *
+ * Reads counter, scaled up for the share of time it was multiplexed out.
+ * Returns -1 if it can't be read.
+ *
+ */
+
+static long long read_counter(int fd) {
+
+	unsigned long long v[3];
+
+	if (fd == -1 || read(fd, v, sizeof(v)) != sizeof(v)) return -1;
+
+	if (!v[2]) return 0;
+
+	return v[2] < v[1] ? (long long)((double)v[0] * v[1] / v[2]) : (long long)v[0];
+
+}
+
+/*
+ * sample
+ *
+ * Reads counters of process, computes ratios over the last dt seconds.
+ *
+ */
+
+static void sample(pnode *proc, double dt) {
+
+	pcount *pc = proc->perf;
+	long long now[PERF_NCOUNTERS], d[PERF_NCOUNTERS];
+	int i;
+
+	if (!pc) return;
+
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+
+		now[i] = read_counter(pc->fd[i]);
+		d[i] = now[i] >= (long long)pc->val[i] ? now[i] - pc->val[i] : 0;
+
+		if (now[i] >= 0) pc->val[i] = now[i];
+
+	}
+
+	/* Ratios are kept while the process does not run */
+	if (now[PERF_CYCLES] >= 0 && now[PERF_INSTR] >= 0 && d[PERF_CYCLES])
+		pc->ipc = (double)d[PERF_INSTR] / d[PERF_CYCLES];
+
+	if (now[PERF_LLC_REFS] >= 0 && now[PERF_LLC_MISSES] >= 0 && d[PERF_LLC_REFS])
+		pc->miss = (double)d[PERF_LLC_MISSES] / d[PERF_LLC_REFS];
+
+	if (now[PERF_LLC_MISSES] >= 0) pc->miss_rate = d[PERF_LLC_MISSES] / dt;
+
+}
+
+/*
+ * perf_sample
+ *
+ * Samples counters of every process, ready or blocked.
+ *
+ */
+
+void perf_sample() {
+
+	struct timespec now;
+	double dt;
+	pnode *tmp;
+
+	if (!perf_on || sim_mode) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	dt = (now.tv_sec - last_sample.tv_sec) + (now.tv_nsec - last_sample.tv_nsec) / 1e9;
+	if (dt * 1000 < PERF_PERIOD) return;
+
+	last_sample = now;
+
+	for (tmp = head; tmp; tmp = tmp->next == head ? NULL : tmp->next) sample(tmp, dt);
+	for (tmp = blocked; tmp; tmp = tmp->next) sample(tmp, dt);
+
+}
+
+/*
+ * write_value
+ *
+ * Writes value k of a process: a counter, then IPC and miss ratio once
+ * known.
+ *
+ */
+
+static void write_value(FILE *f, pnode *proc, int k) {
+
+	pcount *pc = proc->perf;
+
+	if (!pc) return;
+
+	if (k < PERF_NCOUNTERS && pc->fd[k] != -1)
+		fprintf(f, "sched_task_%s_total{pid=\"%d\",name=\"%s\"} %llu\n", 
+				counters[k].name, proc->pid, proc->name, pc->val[k]);
+
+	else if (k == PERF_NCOUNTERS && pc->ipc >= 0)
+		fprintf(f, "sched_task_instructions_per_cycle{pid=\"%d\",name=\"%s\"} %.3f\n", 
+				proc->pid, proc->name, pc->ipc);
+
+	else if (k == PERF_NCOUNTERS + 1 && pc->miss >= 0)
+		fprintf(f, "sched_task_llc_miss_ratio{pid=\"%d\",name=\"%s\"} %.4f\n", 
+				proc->pid, proc->name, pc->miss);
+
+}
+
+/*
+ * perf_metrics
+ *
+ * Writes counters of every process, one metric at a time.
+ *
+ */
+
+void perf_metrics(FILE *f) {
+
+	pnode *tmp;
+	int k;
+
+	if (!perf_on) return;
+
+	for (k = 0; k < PERF_NCOUNTERS + 2; k++) {
+
+		if (k < PERF_NCOUNTERS) {
+
+			fprintf(f, "# HELP sched_task_%s_total Counted for each task, see perf.h.\n", 
+					counters[k].name);
+			fprintf(f, "# TYPE sched_task_%s_total counter\n", counters[k].name);
+
+		} else if (k == PERF_NCOUNTERS) {
+
+			fprintf(f, "# HELP sched_task_instructions_per_cycle IPC over the last second.\n");
+			fprintf(f, "# TYPE sched_task_instructions_per_cycle gauge\n");
+
+		} else {
+
+			fprintf(f, "# HELP sched_task_llc_miss_ratio Cache misses per reference over the last second.\n");
+			fprintf(f, "# TYPE sched_task_llc_miss_ratio gauge\n");
+
+		}
+
+		for (tmp = head; tmp; tmp = tmp->next == head ? NULL : tmp->next) write_value(f, tmp, k);
+		for (tmp = blocked; tmp; tmp = tmp->next) write_value(f, tmp, k);
+
+	}
+
+}
+
+/*
+ * perf_enabled
+ *
+ * Returns 1 if counters are on.
+ *
+ */
+
+int perf_enabled() {
+
+	return perf_on;
+
+}
+
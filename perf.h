@@ -0,0 +1,80 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	perf.h
+ *
+ * @Description: Hardware performance counters. With -P, every process gets
+ * 		counters opened on its pid with perf_event_open() at launch,
+ * 		before it first runs: cycles, instructions, last level cache
+ * 		references and misses, and context switches. Counters follow
+ * 		its threads and children. Once every PERF_PERIOD ms they are
+ * 		read, scaled for the time they were multiplexed out, and turned
+ * 		into instructions per cycle and cache miss ratio over the
+ * 		period, which the process table shows next to each process and
+ * 		metrics exports along with the totals.
+ *
+ * 		A process with low IPC and a high miss ratio is memory bound.
+ *
+ * 		Counters the cpu, the kernel or perf_event_paranoid don't allow
+ * 		are left out, in a VM often all hardware ones.
+ *
+ * @Constants:
+ *
+ * 	PERF_PERIOD	Time between samples in ms
+ *
+ * 	PERF_CYCLES ..	Index of each counter
+ *
+ * @Functions:
+ *
+ * 	perf_init	Turns counters on for processes launched from now.
+ *
+ * 	perf_open	Opens counters of a new process.
+ *
+ * 	perf_close	Closes counters of a process going away.
+ *
+ * 	perf_sample	Reads counters of every process if the last sample
+ * 			is older than PERF_PERIOD.
+ *
+ * 	perf_metrics	Writes counters of every process in Prometheus text
+ * 			format.
+ *
+ * 	perf_enabled	Returns 1 if counters are on.
+ *
+ */
+
+#define __perf_h_
+
+#include <stdio.h>
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define PERF_PERIOD	1000
+
+#define PERF_CYCLES	0
+#define PERF_INSTR	1
+#define PERF_LLC_REFS	2
+#define PERF_LLC_MISSES	3
+#define PERF_CTXSW	4
+#define PERF_NCOUNTERS	5
+
+typedef struct pcount {
+	int		fd[PERF_NCOUNTERS];	/* -1 if not counted */
+	unsigned long long val[PERF_NCOUNTERS];	/* Totals at last sample */
+	double		ipc;			/* Over last period, -1 if unknown */
+	double		miss;			/* Misses per reference, -1 if unknown */
+	double		miss_rate;		/* Misses per second, -1 if unknown */
+} pcount;
+
+void perf_init();
+
+void perf_open(pnode *proc);
+
+void perf_close(pnode *proc);
+
+void perf_sample();
+
+void perf_metrics(FILE *f);
+
+int perf_enabled();
+
@@ -0,0 +1,292 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	pick
+ *
+ * @Description: Pick-next kernels
+ *
+ */
+
+#include <string.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define PICK_X86
+#endif
+
+#include "pnode.h"
+#include "pick.h"
+
+typedef struct kernel {
+	char	*name;
+	int	(*max)(unsigned char *state, signed char *prio, int n);
+	int	(*first)(unsigned char *state, signed char *prio, int from, int to, int top);
+} kernel;
+
+static kernel *cur = NULL;
+
+/*
+ * max_scalar
+ *
+ * Max reduction, one slot at a time.
+ *
+ */
+
+static int max_scalar(unsigned char *state, signed char *prio, int n) {
+
+	int i, top = -1;
+
+	for (i = 0; i < n; i++)
+		if (state[i] == READY && prio[i] > top) top = prio[i];
+
+	return top;
+
+}
+
+/*
+ * first_scalar
+ *
+ * Finds first ready slot of priority top, one slot at a time.
+ *
+ */
+
+static int first_scalar(unsigned char *state, signed char *prio, int from, int to, int top) {
+
+	int i;
+
+	for (i = from; i < to; i++)
+		if (state[i] == READY && prio[i] == top) return i;
+
+	return -1;
+
+}
+
+#ifdef PICK_X86
+
+/*
+ * max_sse4
+ *
+ * Max reduction 16 slots at a time, slots not ready count as -1. What does
+ * not fill a vector is left to the scalar loop.
+ *
+ */
+
+__attribute__((target("sse4.1")))
+static int max_sse4(unsigned char *state, signed char *prio, int n) {
+
+	__m128i ready = _mm_set1_epi8(READY), none = _mm_set1_epi8(-1), acc = none, v;
+	signed char lane[16];
+	int i, j, top;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+
+		v = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(state + i)), ready);
+		v = _mm_blendv_epi8(none, _mm_loadu_si128((__m128i *)(prio + i)), v);
+		acc = _mm_max_epi8(acc, v);
+
+	}
+
+	_mm_storeu_si128((__m128i *)lane, acc);
+
+	top = max_scalar(state + i, prio + i, n - i);
+
+	for (j = 0; j < 16; j++) if (lane[j] > top) top = lane[j];
+
+	return top;
+
+}
+
+/*
+ * first_sse4
+ *
+ * Compares 16 slots at a time against ready and top, the first bit of the
+ * mask is the slot.
+ *
+ */
+
+__attribute__((target("sse4.1")))
+static int first_sse4(unsigned char *state, signed char *prio, int from, int to, int top) {
+
+	__m128i ready = _mm_set1_epi8(READY), want = _mm_set1_epi8(top), v;
+	int i, mask;
+
+	for (i = from; i + 16 <= to; i += 16) {
+
+		v = _mm_and_si128(
+			_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(state + i)), ready),
+			_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)(prio + i)), want));
+
+		if ((mask = _mm_movemask_epi8(v))) return i + __builtin_ctz(mask);
+
+	}
+
+	return first_scalar(state, prio, i, to, top);
+
+}
+
+/*
+ * max_avx2
+ *
+ * Same as max_sse4, 32 slots at a time.
+ *
+ */
+
+__attribute__((target("avx2")))
+static int max_avx2(unsigned char *state, signed char *prio, int n) {
+
+	__m256i ready = _mm256_set1_epi8(READY), none = _mm256_set1_epi8(-1), acc = none, v;
+	signed char lane[32];
+	int i, j, top;
+
+	for (i = 0; i + 32 <= n; i += 32) {
+
+		v = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *)(state + i)), ready);
+		v = _mm256_blendv_epi8(none, _mm256_loadu_si256((__m256i *)(prio + i)), v);
+		acc = _mm256_max_epi8(acc, v);
+
+	}
+
+	_mm256_storeu_si256((__m256i *)lane, acc);
+
+	top = max_scalar(state + i, prio + i, n - i);
+
+	for (j = 0; j < 32; j++) if (lane[j] > top) top = lane[j];
+
+	return top;
+
+}
+
+/*
+ * first_avx2
+ *
+ * Same as first_sse4, 32 slots at a time.
+ *
+ */
+
+__attribute__((target("avx2")))
+static int first_avx2(unsigned char *state, signed char *prio, int from, int to, int top) {
+
+	__m256i ready = _mm256_set1_epi8(READY), want = _mm256_set1_epi8(top), v;
+	unsigned int mask;
+	int i;
+
+	for (i = from; i + 32 <= to; i += 32) {
+
+		v = _mm256_and_si256(
+			_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *)(state + i)), ready),
+			_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *)(prio + i)), want));
+
+		if ((mask = _mm256_movemask_epi8(v))) return i + __builtin_ctz(mask);
+
+	}
+
+	return first_sse4(state, prio, i, to, top);
+
+}
+
+#endif
+
+/* Best first */
+static kernel kernels[] = {
+#ifdef PICK_X86
+	{"avx2", max_avx2, first_avx2},
+	{"sse4", max_sse4, first_sse4},
+#endif
+	{"scalar", max_scalar, first_scalar}
+};
+
+#define NKERNELS	(int)(sizeof(kernels) / sizeof(kernel))
+
+/*
+ * supported
+ *
+ * Asks CPUID, through the compiler, whether kernel can run here.
+ *
+ */
+
+static int supported(kernel *k) {
+
+#ifdef PICK_X86
+	__builtin_cpu_init();
+
+	if (!strcmp(k->name, "avx2")) return __builtin_cpu_supports("avx2");
+	if (!strcmp(k->name, "sse4")) return __builtin_cpu_supports("sse4.1");
+#endif
+
+	return 1;
+
+}
+
+/*
+ * pick_init
+ *
+ * Selects kernel. Keeps the one in use if name is not supported.
+ *
+ */
+
+int pick_init(char *name) {
+
+	int i;
+
+	for (i = 0; i < NKERNELS; i++) {
+
+		if (strcasecmp(name, "auto") && strcasecmp(name, kernels[i].name)) continue;
+
+		if (supported(&kernels[i])) {
+
+			cur = &kernels[i];
+			return 0;
+
+		}
+
+	}
+
+	return -1;
+
+}
+
+/*
+ * pick_kernel
+ *
+ * Returns name of kernel in use.
+ *
+ */
+
+char* pick_kernel() {
+
+	if (!cur) pick_init("auto");
+
+	return cur->name;
+
+}
+
+/*
+ * pick_max
+ *
+ * Highest priority of ready slots among the first n.
+ *
+ */
+
+int pick_max(unsigned char *state, signed char *prio, int n) {
+
+	if (!cur) pick_init("auto");
+
+	return cur->max(state, prio, n);
+
+}
+
+/*
+ * pick_first
+ *
+ * First ready slot of priority top, from included to excluded.
+ *
+ */
+
+int pick_first(unsigned char *state, signed char *prio, int from, int to, int top) {
+
+	if (!cur) pick_init("auto");
+
+	return cur->first(state, prio, from, to, top);
+
+}
+
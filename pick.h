@@ -0,0 +1,42 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	pick.h
+ *
+ * @Description: Pick-next kernels over the process table arrays. Choosing
+ * 		the next process is a max reduction over the priorities of
+ * 		ready slots, then finding the first ready slot of that
+ * 		priority. Both go 32 slots at a time with AVX2, 16 with
+ * 		SSE4.1, or one at a time, whichever the CPU supports as told
+ * 		by CPUID. The kernel is chosen on first use and can be forced
+ * 		by name, which ptbench does to compare them.
+ *
+ * 		Only ptbench picks through them. Slots are taken in slot
+ * 		order, while the scheduler runs processes in the order they
+ * 		joined the ready queue, as moved by co-scheduling, which the
+ * 		arrays don't keep. It still picks by walking its ring, see
+ * 		prio_pick.
+ *
+ * @Functions:
+ *
+ * 	pick_init	Selects kernel by name, "auto" for the best one
+ * 			the CPU has. Returns -1 if it has not that one.
+ *
+ * 	pick_kernel	Returns name of kernel in use.
+ *
+ * 	pick_max	Returns highest priority of ready slots, -1 if none.
+ *
+ * 	pick_first	Returns first ready slot of a priority in a range,
+ * 			-1 if none.
+ *
+ */
+
+#define __pick_h_
+
+int pick_init(char *name);
+
+char* pick_kernel();
+
+int pick_max(unsigned char *state, signed char *prio, int n);
+
+int pick_first(unsigned char *state, signed char *prio, int from, int to, int top);
+
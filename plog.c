@@ -0,0 +1,299 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	plog
+ *
+ * @Description: Persistent per process logs with time index
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "plog.h"
+#include "output.h"
+
+/* Log directory, logging is off if NULL */
+char *plog_dir = NULL;
+
+/*
+ * plog_path
+ *
+ * Builds path of a segment, or of the index if seg is negative.
+ *
+ */
+
+static void plog_path(char *path, int size, int pid, int seg) {
+
+	if (seg < 0) snprintf(path, size, "%s/%d.idx", plog_dir, pid);
+	else snprintf(path, size, "%s/%d.%d.log", plog_dir, pid, seg);
+
+}
+
+/*
+ * plog_init
+ *
+ * Enables logging into dir, creating it if needed. Raises open file limit,
+ * every process keeps a pipe, a segment and its index open.
+ *
+ */
+
+void plog_init(char *dir) {
+
+	struct rlimit rl;
+
+	if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+
+		fprintf(stderr, "ERROR: Could not create log directory '%s'.\n", dir);
+		exit(-1);
+
+	}
+
+	if (!getrlimit(RLIMIT_NOFILE, &rl)) {
+
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+
+	}
+
+	plog_dir = dir;
+
+}
+
+/*
+ * plog_open_idx
+ *
+ * Opens index of log for appending and reading.
+ *
+ */
+
+static void plog_open_idx(plog *lg, int pid) {
+
+	char path[512];
+
+	plog_path(path, sizeof(path), pid, -1);
+
+	lg->ifd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+}
+
+/*
+ * plog_open_seg
+ *
+ * Opens current segment of log for appending.
+ *
+ */
+
+static void plog_open_seg(plog *lg, int pid) {
+
+	char path[512];
+	struct stat st;
+
+	plog_path(path, sizeof(path), pid, lg->seg);
+
+	lg->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	lg->off = !fstat(lg->fd, &st) ? st.st_size : 0;
+
+}
+
+/*
+ * plog_attach
+ *
+ * Opens log of process. Carries on from last segment if log exists.
+ *
+ */
+
+void plog_attach(pnode *proc) {
+
+	struct stat st;
+	pidx last;
+	plog *lg;
+
+	if (!plog_dir || !proc->och) return;
+
+	lg = calloc(1, sizeof(plog));
+
+	/* Find last segment in index */
+	plog_open_idx(lg, proc->pid);
+
+	if (lg->ifd != -1 && !fstat(lg->ifd, &st) && st.st_size >= sizeof(pidx) &&
+			pread(lg->ifd, &last, sizeof(pidx), 
+				(st.st_size / sizeof(pidx) - 1) * sizeof(pidx)) == sizeof(pidx))
+		lg->seg = last.seg;
+
+	plog_open_seg(lg, proc->pid);
+
+	proc->och->plog = lg;
+
+}
+
+/*
+ * plog_detach
+ *
+ * Closes log of process.
+ *
+ */
+
+void plog_detach(pnode *proc) {
+
+	if (!proc->och || !proc->och->plog) return;
+
+	close(proc->och->plog->fd);
+	if (proc->och->plog->ifd != -1) close(proc->och->plog->ifd);
+	free(proc->och->plog);
+
+	proc->och->plog = NULL;
+
+}
+
+/*
+ * plog_write
+ *
+ * Appends line to log of process. First line of every second is indexed.
+ *
+ */
+
+void plog_write(pnode *proc, char *line, int len) {
+
+	plog *lg;
+	long long now = time(NULL);
+	pidx rec;
+
+	if (!proc->och || !(lg = proc->och->plog) || lg->fd == -1) return;
+
+	/* Segment is full, start next one. Index is opened again with it, in
+	 * case it was moved away along with the old segments */
+	if (lg->off >= PLOG_SEG) {
+
+		close(lg->fd);
+		if (lg->ifd != -1) close(lg->ifd);
+
+		lg->seg++;
+		plog_open_seg(lg, proc->pid);
+		plog_open_idx(lg, proc->pid);
+
+	}
+
+	/* Index first line of this second */
+	if (now != lg->last_sec) {
+
+		rec.sec = now;
+		rec.seg = lg->seg;
+		rec.pad = 0;
+		rec.off = lg->off;
+
+		if (lg->ifd != -1) write(lg->ifd, &rec, sizeof(pidx));
+
+		lg->last_sec = now;
+
+	}
+
+	if (write(lg->fd, line, len) == len) lg->off += len;
+
+}
+
+/*
+ * plog_find
+ *
+ * Binary searches index of pid for first second at or after since and opens
+ * log there. Returns 0 on success, -1 if there is no log or nothing was
+ * logged since then.
+ *
+ */
+
+int plog_find(pcursor *cur, int pid, long long since) {
+
+	char path[512];
+	struct stat st;
+	long lo = 0, hi, mid;
+	pidx rec;
+	int ifd;
+
+	cur->f = NULL;
+	cur->pid = pid;
+
+	if (!plog_dir) return -1;
+
+	plog_path(path, sizeof(path), pid, -1);
+
+	if ((ifd = open(path, O_RDONLY)) == -1) return -1;
+
+	hi = !fstat(ifd, &st) ? st.st_size / sizeof(pidx) : 0;
+
+	/* First record with sec >= since */
+	while (lo < hi) {
+
+		mid = (lo + hi) / 2;
+
+		if (pread(ifd, &rec, sizeof(pidx), mid * sizeof(pidx)) != sizeof(pidx)) break;
+
+		if (rec.sec < since) lo = mid + 1;
+		else hi = mid;
+
+	}
+
+	if (pread(ifd, &rec, sizeof(pidx), lo * sizeof(pidx)) != sizeof(pidx)) {
+
+		close(ifd);
+		return -1;
+
+	}
+
+	close(ifd);
+
+	cur->seg = rec.seg;
+
+	plog_path(path, sizeof(path), pid, cur->seg);
+
+	if ((cur->f = fopen(path, "r")) == NULL) return -1;
+
+	fseek(cur->f, rec.off, SEEK_SET);
+
+	return 0;
+
+}
+
+/*
+ * plog_gets
+ *
+ * Reads next line of log, carrying on into following segments.
+ *
+ */
+
+char* plog_gets(pcursor *cur, char *buf, int size) {
+
+	char path[512];
+
+	while (cur->f) {
+
+		if (fgets(buf, size, cur->f)) return buf;
+
+		/* End of segment, try next one */
+		fclose(cur->f);
+
+		plog_path(path, sizeof(path), cur->pid, ++cur->seg);
+		cur->f = fopen(path, "r");
+
+	}
+
+	return NULL;
+
+}
+
+/*
+ * plog_close
+ *
+ * Closes log opened by plog_find.
+ *
+ */
+
+void plog_close(pcursor *cur) {
+
+	if (cur->f) fclose(cur->f);
+	cur->f = NULL;
+
+}
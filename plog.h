@@ -0,0 +1,89 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	plog.h
+ *
+ * @Description: Persistent process logs. Everything a process logs is appended
+ * 		to segment files in the log directory, <pid>.<seg>.log, starting
+ * 		a new segment every PLOG_SEG bytes. <pid>.idx is an index of
+ * 		fixed size records giving the segment and offset of the first
+ * 		line logged in every second, so a time range is found with a
+ * 		binary search over the index instead of a scan of the logs.
+ *
+ * 		A process that reuses a pid, or that a restarted scheduler
+ * 		adopted, keeps appending to the same files.
+ *
+ * @Constants:
+ *
+ * 	PLOG_SEG	Segment size in bytes
+ *
+ * @Functions:
+ *
+ * 	plog_init	Sets log directory and enables logging.
+ *
+ * 	plog_attach	Opens log of a process.
+ *
+ * 	plog_detach	Closes log of a process.
+ *
+ * 	plog_write	Appends a line to log of a process.
+ *
+ * 	plog_find	Opens log of a pid at first line logged at or after
+ * 			since (seconds since epoch). Returns 0 on success.
+ *
+ * 	plog_gets	Reads next line of an opened log, moving on to next
+ * 			segment as needed. Returns NULL at end of log.
+ *
+ * 	plog_close	Closes an opened log.
+ *
+ */
+
+#define __plog_h_
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define PLOG_SEG	(4 << 20)
+
+/* Index record */
+typedef struct pidx {
+	long long	sec;
+	int		seg;
+	int		pad;
+	long long	off;
+} pidx;
+
+/* Log being written */
+typedef struct plog {
+	int		fd;
+	int		ifd;		/* Index */
+	int		seg;
+	long long	off;
+	long long	last_sec;
+} plog;
+
+/* Log being read */
+typedef struct pcursor {
+	int		pid;
+	int		seg;
+	FILE		*f;
+} pcursor;
+
+extern char *plog_dir;
+
+void plog_init(char *dir);
+
+void plog_attach(pnode *proc);
+
+void plog_detach(pnode *proc);
+
+void plog_write(pnode *proc, char *line, int len);
+
+int plog_find(pcursor *cur, int pid, long long since);
+
+char* plog_gets(pcursor *cur, char *buf, int size);
+
+void plog_close(pcursor *cur);
+
@@ -5,6 +5,16 @@
  */
 
 #include "pnode.h"
+#include "proc.h"
+#include "ptable.h"
+
+#ifndef __prio_h_
+	#include "prio.h"
+#endif
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
 
 /*
  * pnode_create
@@ -25,6 +35,22 @@ pnode* pnode_create(int pid, char *name) {
 
 	/* Set node state */	
 	node->state = READY;
+	node->start = 0;
+	node->och = NULL;
+	node->place = NULL;
+	node->cause = BC_USER;
+	node->rss_max = 0;
+	node->io_bytes = 0;
+	node->prio = node->eprio = 0;
+	node->waits_on = NULL;
+	node->wait_res = NULL;
+	node->ev = NULL;
+	node->pidfd = -1;
+	node->reap = NULL;
+	node->perf = NULL;
+	node->co = 0;
+	node->green = NULL;
+	node->slot = ptable_add(&ptab, node);
 
 	return node;
 
@@ -33,32 +59,20 @@ pnode* pnode_create(int pid, char *name) {
 /*
  * pnode_get_node_by_pid
  *
- * Iterates through processes and returns process with corresponding pid if found,
- * otherwise returns NULL pointer. Must test for NULL.
+ * Scans process table and returns process with corresponding pid if found,
+ * otherwise returns NULL pointer. Must test for NULL. Only processes in the
+ * ready or blocked queue are found, never the idle process.
  *
  */
 
 pnode* pnode_get_node_by_pid(int pid) {
 
-	pnode *tmp = head;
+	int slot = ptable_find(&ptab, pid);
 
-	/* Iterate through ready queue */
-	while (tmp && tmp->next && tmp->pid != pid && tmp->next != head) 
-		tmp = tmp->next;
-	
-	/* If tmp is not node requested, iterate through blocked queue */
-	if ((tmp && tmp->pid != pid && blocked) || !head) {
+	if (slot == -1 || ptab.state[slot] == PT_OUT || ptab.node[slot] == idle_proc) 
+		return NULL;
 
-		tmp = blocked;
-
-		while (tmp && tmp->next && tmp->pid != pid)
-			tmp = tmp->next;
-
-	}
-
-	if (tmp && tmp->pid != pid) tmp = NULL;
-
-	return tmp;
+	return ptab.node[slot];
 
 }
 
@@ -75,6 +89,7 @@ int pnode_destroy(pnode *node) {
 	if (!node)
 		return -1;
 	else {
+		ptable_remove(&ptab, node->slot);
 		free(node->name);
 		free(node);
 		return 0;
@@ -93,6 +108,10 @@ void pnode_add_ready(pnode *proc) {
 
 	/* Set process state */
 	proc->state = READY;
+	nready++;
+	nready_prio[proc->eprio]++;
+
+	ptable_mark(&ptab, proc->slot, READY);
 
 	/* If list is empty */
 	if (!head) {
@@ -102,10 +121,9 @@ void pnode_add_ready(pnode *proc) {
 		proc->next = proc;
 		proc->prev = proc;
 
-		/* Block idle process, start new process and reset alarm */
-		kill(idle_proc->pid, SIGSTOP);
-		kill(proc->pid, SIGCONT);
-		alarm(3);
+		/* Block idle process, start new process and reset clock */
+		prio_pick();
+		dispatch(head);
 
 	/* If list is not empty */
 	} else {
@@ -119,6 +137,9 @@ void pnode_add_ready(pnode *proc) {
 		tail = proc;
 		head->prev = tail;
 
+		/* Runs now if a companion place is free */
+		cosched_fill();
+
 	}
 
 }
@@ -132,6 +153,11 @@ void pnode_add_ready(pnode *proc) {
 
 void pnode_remove_ready(pnode *proc) {
 
+	nready--;
+	nready_prio[proc->eprio]--;
+
+	ptable_mark(&ptab, proc->slot, PT_OUT);
+
 	/* If there is more than one node in the ready list */
 	if (head != tail) {
 	
@@ -157,13 +183,19 @@ void pnode_remove_ready(pnode *proc) {
 			if (tail->prev == proc) tail->prev = tail;
 
 		/* Any other nodes */
-		} else
+		} else {
+
 			proc->prev->next = proc->next;
+			proc->next->prev = proc->prev;
+
+		}
 
 	/* If there is only one node in the list */
 	} else
 		head = tail = NULL;
 
+	/* Companion leaving, another one takes its place */
+	if (proc->co) cosched_drop(proc);
 
 }
 
@@ -177,6 +209,10 @@ void pnode_remove_ready(pnode *proc) {
 void pnode_add_blocked(pnode *proc) {
 
 	proc->state = BLOCKED;
+	nblocked++;
+
+	ptable_mark(&ptab, proc->slot, BLOCKED);
+
 	proc->next = NULL;
 	proc->prev = NULL;
 
@@ -201,6 +237,10 @@ void pnode_add_blocked(pnode *proc) {
 
 void pnode_remove_blocked(pnode *proc) {
 
+	nblocked--;
+
+	ptable_mark(&ptab, proc->slot, PT_OUT);
+
 	/* Adjust pointers */
 	if (proc->prev) proc->prev->next = proc->next;
 	if (proc->next) proc->next->prev = proc->prev;
@@ -31,17 +31,49 @@
 
 typedef enum pstate {READY, RUNNING, BLOCKED} pstate;
 
+/* Why a process was blocked */
+typedef enum bcause {BC_USER, BC_RSS, BC_PRESSURE, BC_WAIT, BC_EVENT, BC_TRIGGER} bcause;
+
 typedef struct pnode pnode;
 
+/* Priority levels, 0 is lowest */
+#define PRIO_LEVELS	10
+
+struct ochan;
+struct placement;
+struct res;
+struct evwatch;
+struct pcount;
+struct gtask;
+
 struct pnode {
 	pnode	*next;
 	pnode	*prev;
 	int	pid;
 	char	*name;
 	pstate	state;
+	unsigned long long start;	/* Start time, tells reused pids apart */
+	struct ochan *och;		/* Output channel */
+	struct placement *place;	/* Cpus and node, NULL if inherited */
+	bcause	cause;
+	long	rss_max;		/* Memory limit in bytes, 0 for none */
+	unsigned long long io_bytes;	/* Bytes read and written at last check */
+	int	prio;			/* Base priority */
+	int	eprio;			/* Effective priority, inherited from waiters */
+	pnode	*waits_on;		/* Process this one is blocked behind */
+	struct res *wait_res;		/* Resource waited for, NULL for an exit */
+	struct evwatch *ev;		/* Event blocked on */
+	int	slot;			/* Index in process table */
+	int	pidfd;			/* Handle signals go through, -1 if none */
+	struct evwatch *reap;		/* Exit watch on pidfd */
+	struct pcount *perf;		/* Performance counters, NULL if none */
+	int	co;			/* Running alongside head, see cosched.h */
+	struct gtask *green;		/* Green task, NULL for a process */
 };
 
 extern pnode *head, *tail, *blocked, *idle_proc;
+extern int nready, nblocked;
+extern int nready_prio[PRIO_LEVELS];
 extern char errstr[128];
 
 pnode* pnode_create(int pid, char *name);
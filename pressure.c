@@ -0,0 +1,218 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	pressure
+ *
+ * @Description: Memory and io pressure monitor
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pressure.h"
+#include "proc.h"
+#include "limit.h"
+#include "metrics.h"
+
+#ifndef __sim_h_
+	#include "sim.h"
+#endif
+
+/* Thresholds in percent of stalled time, 0 if not monitored */
+static double mem_max = 0, io_max = 0;
+
+static struct timespec last_check;
+
+/*
+ * pressure_init
+ *
+ * Parses thresholds like mem=10,io=20. Returns 0 on success, -1 otherwise.
+ *
+ */
+
+int pressure_init(char *spec) {
+
+	char buf[64], *tok, *save, *end;
+	double *max;
+
+	strncpy(buf, spec, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = 0;
+
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+
+		if (!strncmp(tok, "mem=", 4)) max = &mem_max;
+		else if (!strncmp(tok, "io=", 3)) max = &io_max;
+		else return -1;
+
+		*max = strtod(strchr(tok, '=') + 1, &end);
+
+		if (*end || *max <= 0 || *max > 100) return -1;
+
+	}
+
+	return 0;
+
+}
+
+/*
+ * psi_avg10
+ *
+ * Returns share of time some task stalled on resource over last 10 seconds,
+ * in percent. Returns 0 if pressure is not available.
+ *
+ */
+
+static double psi_avg10(char *res) {
+
+	char path[32];
+	FILE *f;
+	double avg = 0;
+
+	snprintf(path, sizeof(path), "/proc/pressure/%s", res);
+
+	if ((f = fopen(path, "r")) == NULL) return 0;
+
+	if (fscanf(f, "some avg10=%lf", &avg) != 1) avg = 0;
+
+	fclose(f);
+
+	return avg;
+
+}
+
+/*
+ * io_delta
+ *
+ * Returns bytes process read and wrote since last call.
+ *
+ */
+
+static unsigned long long io_delta(pnode *proc) {
+
+	char path[32], line[64];
+	FILE *f;
+	unsigned long long n, total = 0, delta;
+
+	snprintf(path, sizeof(path), "/proc/%d/io", proc->pid);
+
+	if ((f = fopen(path, "r")) == NULL) return 0;
+
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "read_bytes: %llu", &n) == 1 || 
+				sscanf(line, "write_bytes: %llu", &n) == 1) total += n;
+
+	fclose(f);
+
+	delta = total - proc->io_bytes;
+	proc->io_bytes = total;
+
+	return delta;
+
+}
+
+/*
+ * pressure_block
+ *
+ * Blocks process for cause.
+ *
+ */
+
+static void pressure_block(pnode *proc, bcause cause) {
+
+	block_node(proc);
+	proc->cause = cause;
+
+	mstat.pressure_blocks++;
+
+}
+
+/*
+ * pressure_check
+ *
+ * Enforces memory limits, then blocks biggest offender if memory or io
+ * pressure is over threshold or releases a process if it is well under.
+ *
+ */
+
+void pressure_check() {
+
+	struct timespec now;
+	pnode *tmp, *next, *mem_hog = NULL, *io_hog = NULL, *release = NULL;
+	long rss, mem_rss = 0;
+	unsigned long long io, io_most = 0;
+	double mem = 0, io_psi = 0;
+	int i, n;
+
+	if (sim_mode || !pressure_enabled()) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if ((now.tv_sec - last_check.tv_sec) * 1000 + 
+			(now.tv_nsec - last_check.tv_nsec) / 1000000 < PRESSURE_PERIOD) return;
+
+	last_check = now;
+
+	if (mem_max) mem = psi_avg10("memory");
+	if (io_max) io_psi = psi_avg10("io");
+
+	/* Processes blocked over their memory limit go back once under it */
+	for (tmp = blocked; tmp; tmp = next) {
+
+		next = tmp->next;
+
+		if (tmp->cause == BC_RSS && (!tmp->rss_max || proc_rss(tmp) <= tmp->rss_max))
+			run_node(tmp);
+
+		/* First blocked for pressure is released first */
+		else if (tmp->cause == BC_PRESSURE && !release)
+			release = tmp;
+
+	}
+
+	/* Walk ready queue, blocking processes over their memory limit and
+	 * finding the biggest offenders */
+	for (tmp = head, i = 0, n = nready; tmp && i < n; tmp = next, i++) {
+
+		next = tmp->next;
+		rss = (tmp->rss_max || mem > mem_max) ? proc_rss(tmp) : 0;
+		io = io_max ? io_delta(tmp) : 0;
+
+		if (tmp->rss_max && rss > tmp->rss_max && nready > 1) {
+
+			pressure_block(tmp, BC_RSS);
+			continue;
+
+		}
+
+		if (rss > mem_rss) mem_rss = rss, mem_hog = tmp;
+		if (io > io_most) io_most = io, io_hog = tmp;
+
+	}
+
+	/* Shed one process, never the last one ready */
+	if (nready > 1 && mem_max && mem > mem_max && mem_hog)
+		pressure_block(mem_hog, BC_PRESSURE);
+
+	else if (nready > 1 && io_max && io_psi > io_max && io_hog)
+		pressure_block(io_hog, BC_PRESSURE);
+
+	/* Release one process once pressure is well under thresholds */
+	else if (release && mem <= mem_max / 2 && io_psi <= io_max / 2)
+		run_node(release);
+
+}
+
+/*
+ * pressure_enabled
+ *
+ * Returns 1 if pressure or memory limits are monitored.
+ *
+ */
+
+int pressure_enabled() {
+
+	return mem_max || io_max || limit_rss_used;
+
+}
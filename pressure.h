@@ -0,0 +1,50 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	pressure.h
+ *
+ * @Description: Pressure monitor. Once a second, reads memory and io pressure
+ * 		from /proc/pressure (PSI, share of time some task stalled over
+ * 		the last 10 seconds). While one crosses its threshold, the
+ * 		biggest offender in the ready queue is blocked: most resident
+ * 		memory for memory pressure, most bytes read and written since
+ * 		the last check for io pressure. One process is blocked per
+ * 		check, so load sheds gradually, and the last ready process is
+ * 		never blocked. Once pressure falls under half the threshold,
+ * 		processes blocked for it are put back one per check.
+ *
+ * 		The monitor also enforces memory limits, see limit.h. A process
+ * 		over its limit is blocked until its resident memory is back
+ * 		under the limit or the limit is raised.
+ *
+ * 		Processes blocked by the user are never touched.
+ *
+ * @Constants:
+ *
+ * 	PRESSURE_PERIOD	Time between checks in ms
+ *
+ * @Functions:
+ *
+ * 	pressure_init	Parses thresholds in percent, like mem=10,io=20.
+ * 			Returns 0 on success.
+ *
+ * 	pressure_check	Reads pressure and blocks or releases processes if
+ * 			the last check is older than PRESSURE_PERIOD.
+ *
+ * 	pressure_enabled Returns 1 if anything is monitored.
+ *
+ */
+
+#define __pressure_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define PRESSURE_PERIOD	1000
+
+int pressure_init(char *spec);
+
+void pressure_check();
+
+int pressure_enabled();
+
@@ -0,0 +1,331 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	prio
+ *
+ * @Description: Priorities and priority inheritance
+ *
+ */
+
+#include "prio.h"
+#include "proc.h"
+
+static res table[RES_MAX];
+
+/*
+ * set_eprio
+ *
+ * Sets effective priority, keeping ready counts per level up to date.
+ *
+ */
+
+static void set_eprio(pnode *proc, int eprio) {
+
+	if (proc->state != BLOCKED) {
+
+		nready_prio[proc->eprio]--;
+		nready_prio[eprio]++;
+
+	}
+
+	proc->eprio = eprio;
+
+}
+
+/*
+ * prio_update
+ *
+ * Recomputes effective priority of process from its own and its waiters',
+ * then of whatever it waits on, as long as something changes.
+ *
+ */
+
+static void prio_update(pnode *proc) {
+
+	pnode *tmp;
+	int eprio;
+
+	while (proc) {
+
+		eprio = proc->prio;
+
+		/* Waiters are always blocked */
+		for (tmp = blocked; tmp; tmp = tmp->next)
+			if (tmp->waits_on == proc && tmp->eprio > eprio) eprio = tmp->eprio;
+
+		if (eprio == proc->eprio) break;
+
+		set_eprio(proc, eprio);
+		proc = proc->waits_on;
+
+	}
+
+}
+
+/*
+ * prio_set
+ *
+ * Sets base priority of process.
+ *
+ */
+
+void prio_set(pnode *proc, int prio) {
+
+	proc->prio = prio;
+
+	prio_update(proc);
+
+}
+
+/*
+ * prio_pick
+ *
+ * Rotates ready queue until head is of the highest priority ready. Called
+ * once head moved on, so processes of the same priority take turns.
+ *
+ */
+
+void prio_pick() {
+
+	int top = PRIO_LEVELS - 1, n;
+
+	while (top > 0 && !nready_prio[top]) top--;
+
+	/* One lap at most, should counts and queue ever disagree */
+	for (n = 0; n < nready && head->eprio < top; n++) {
+
+		tail = head;
+		head = head->next;
+
+	}
+
+}
+
+/*
+ * start_wait
+ *
+ * Blocks process behind another one, which inherits its priority. Returns 0
+ * on success, -1 with error set otherwise.
+ *
+ */
+
+static int start_wait(pnode *proc, pnode *on, res *r) {
+
+	pnode *tmp;
+
+	if (proc->state == BLOCKED) {
+
+		sprintf(errstr, "ERROR: Process %d is already blocked.", proc->pid);
+		return -1;
+
+	}
+
+	/* Refuse waits that could never end */
+	for (tmp = on; tmp; tmp = tmp->waits_on) {
+
+		if (tmp == proc) {
+
+			sprintf(errstr, "ERROR: Process %d waiting on %d would deadlock.", 
+					proc->pid, on->pid);
+			return -1;
+
+		}
+
+	}
+
+	block_node(proc);
+
+	proc->cause = BC_WAIT;
+	proc->waits_on = on;
+	proc->wait_res = r;
+
+	/* Pass priority down the chain. Further down priorities are at least as
+	 * high, so stop at the first one that is */
+	for (tmp = on; tmp && tmp->eprio < proc->eprio; tmp = tmp->waits_on)
+		set_eprio(tmp, proc->eprio);
+
+	return 0;
+
+}
+
+/*
+ * prio_wait
+ *
+ * Blocks process until another one exits. Returns 0 on success.
+ *
+ */
+
+int prio_wait(pnode *proc, pnode *on) {
+
+	return start_wait(proc, on, NULL);
+
+}
+
+/*
+ * find_res
+ *
+ * Returns resource held under name, NULL if none.
+ *
+ */
+
+static res* find_res(char *name) {
+
+	int i;
+
+	for (i = 0; i < RES_MAX; i++)
+		if (table[i].holder && !strcmp(table[i].name, name)) return &table[i];
+
+	return NULL;
+
+}
+
+/*
+ * prio_hold
+ *
+ * Gives resource to process if free, otherwise blocks process until it is
+ * released. Returns 0 on success, -1 with error set otherwise.
+ *
+ */
+
+int prio_hold(pnode *proc, char *name) {
+
+	res *r = find_res(name);
+	int i;
+
+	if (r && r->holder == proc) {
+
+		sprintf(errstr, "ERROR: Process %d already holds %s.", proc->pid, name);
+		return -1;
+
+	}
+
+	if (r) return start_wait(proc, r->holder, r);
+
+	for (i = 0; i < RES_MAX && table[i].holder; i++);
+
+	if (i == RES_MAX) {
+
+		sprintf(errstr, "ERROR: Too many resources held.");
+		return -1;
+
+	}
+
+	strncpy(table[i].name, name, sizeof(table[i].name) - 1);
+	table[i].name[sizeof(table[i].name) - 1] = 0;
+	table[i].holder = proc;
+
+	return 0;
+
+}
+
+/*
+ * hand_over
+ *
+ * Gives resource to its highest priority waiter, longest waiting first, or
+ * frees it if nobody waits. Other waiters now wait on the new holder.
+ *
+ */
+
+static void hand_over(res *r) {
+
+	pnode *tmp, *best = NULL, *old = r->holder;
+
+	/* Blocked queue is newest first */
+	for (tmp = blocked; tmp; tmp = tmp->next)
+		if (tmp->wait_res == r && (!best || tmp->eprio >= best->eprio)) best = tmp;
+
+	r->holder = best;
+
+	if (!best) return;
+
+	for (tmp = blocked; tmp; tmp = tmp->next)
+		if (tmp->wait_res == r && tmp != best) tmp->waits_on = best;
+
+	best->waits_on = NULL;
+	best->wait_res = NULL;
+
+	/* Old holder drops what it inherited, new one takes it */
+	prio_update(old);
+	prio_update(best);
+
+	run_node(best);
+
+}
+
+/*
+ * prio_release
+ *
+ * Releases resource held by process. Returns 0 on success, -1 with error set
+ * otherwise.
+ *
+ */
+
+int prio_release(pnode *proc, char *name) {
+
+	res *r = find_res(name);
+
+	if (!r || r->holder != proc) {
+
+		sprintf(errstr, "ERROR: Process %d does not hold %s.", proc->pid, name);
+		return -1;
+
+	}
+
+	hand_over(r);
+
+	return 0;
+
+}
+
+/*
+ * prio_detach
+ *
+ * Ends wait of process, whatever it waited for. Process it waited on drops
+ * the priority it inherited.
+ *
+ */
+
+void prio_detach(pnode *proc) {
+
+	pnode *on = proc->waits_on;
+
+	if (!on) return;
+
+	proc->waits_on = NULL;
+	proc->wait_res = NULL;
+
+	prio_update(on);
+
+}
+
+/*
+ * prio_exit
+ *
+ * Ends wait of process going away, hands over its resources and wakes
+ * processes waiting on its exit.
+ *
+ */
+
+void prio_exit(pnode *proc) {
+
+	pnode *tmp, *next;
+	int i;
+
+	prio_detach(proc);
+
+	for (i = 0; i < RES_MAX; i++)
+		if (table[i].holder == proc) hand_over(&table[i]);
+
+	for (tmp = blocked; tmp; tmp = next) {
+
+		next = tmp->next;
+
+		if (tmp->waits_on == proc) {
+
+			tmp->waits_on = NULL;
+			run_node(tmp);
+
+		}
+
+	}
+
+}
@@ -0,0 +1,74 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	prio.h
+ *
+ * @Description: Priorities and priority inheritance. The ready queue stays a
+ * 		round robin ring, but the clock interrupt only stops on processes
+ * 		of the highest priority ready, skipping the others. Ready counts
+ * 		per level are kept by the queue, so when every process has the
+ * 		same priority nothing is skipped and rotation stays O(1).
+ *
+ * 		A process can be blocked waiting on another one: for it to exit,
+ * 		or for a named resource it holds. While it waits, the process
+ * 		blocking it runs with the priority of its highest waiter if that
+ * 		is higher than its own, and so does whatever that process waits
+ * 		on in turn. A low priority holder is thus never starved by
+ * 		medium priority work while a high priority process waits on it.
+ * 		The inherited priority is dropped as soon as the wait ends.
+ *
+ * 		Waits that would close a cycle are refused.
+ *
+ * @Constants:
+ *
+ * 	RES_MAX		Most resources held at once
+ *
+ * @Functions:
+ *
+ * 	prio_set	Sets base priority of a process.
+ *
+ * 	prio_pick	Rotates ready queue to next process of the highest
+ * 			priority ready.
+ *
+ * 	prio_wait	Blocks a process until another one exits. Returns
+ * 			0 on success.
+ *
+ * 	prio_hold	Gives a resource to a process, or blocks it until
+ * 			the resource is released. Returns 0 on success.
+ *
+ * 	prio_release	Releases a resource, handing it to its highest
+ * 			priority waiter. Returns 0 on success.
+ *
+ * 	prio_detach	Ends wait of a process without running it.
+ *
+ * 	prio_exit	Releases everything a process that is going away
+ * 			holds, and wakes processes waiting on its exit.
+ *
+ */
+
+#define __prio_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define RES_MAX		64
+
+typedef struct res {
+	char	name[16];
+	pnode	*holder;		/* NULL if slot is free */
+} res;
+
+void prio_set(pnode *proc, int prio);
+
+void prio_pick();
+
+int prio_wait(pnode *proc, pnode *on);
+
+int prio_hold(pnode *proc, char *name);
+
+int prio_release(pnode *proc, char *name);
+
+void prio_detach(pnode *proc);
+
+void prio_exit(pnode *proc);
+
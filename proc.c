@@ -8,6 +8,374 @@
 
 #include "proc.h"
 
+#ifndef __sim_h_
+	#include "sim.h"
+#endif
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+#ifndef __output_h_
+	#include "output.h"
+#endif
+
+#ifndef __topo_h_
+	#include "topo.h"
+#endif
+
+#ifndef __limit_h_
+	#include "limit.h"
+#endif
+
+#ifndef __prio_h_
+	#include "prio.h"
+#endif
+
+#ifndef __event_h_
+	#include "event.h"
+#endif
+
+#ifndef __zygote_h_
+	#include "zygote.h"
+#endif
+
+#ifndef __dag_h_
+	#include "dag.h"
+#endif
+
+#ifndef __rt_h_
+	#include "rt.h"
+#endif
+
+#ifndef __perf_h_
+	#include "perf.h"
+#endif
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
+
+#ifndef __green_h_
+	#include "green.h"
+#endif
+
+/* Process currently holding the cpu */
+pnode *running_proc = NULL;
+
+/* Number of times the cpu changed hands */
+unsigned long ctx_switches = 0;
+
+/* Some process has no pidfd, children must be swept for */
+static int untracked = 0;
+
+/*
+ * proc_signal
+ *
+ * Sends signal to process, through its pidfd if it has one. Simulated
+ * processes and green tasks have no real pid and are never signaled.
+ * Returns 0 on success.
+ *
+ */
+
+int proc_signal(pnode *proc, int sig) {
+
+	if (!proc || sim_mode || proc->green) return 0;
+
+	if (proc->pidfd != -1) return syscall(SYS_pidfd_send_signal, proc->pidfd, sig, NULL, 0);
+
+	return kill(proc->pid, sig);
+
+}
+
+/*
+ * proc_alive
+ *
+ * Returns 1 if process still exists, 0 otherwise.
+ *
+ */
+
+int proc_alive(pnode *proc) {
+
+	struct pollfd pfd;
+
+	if (!proc) return 0;
+	if (sim_mode) return 1;
+
+	/* Pidfd polls readable once process is gone */
+	if (proc->pidfd != -1) {
+
+		pfd.fd = proc->pidfd;
+		pfd.events = POLLIN;
+
+		return !poll(&pfd, 1, 0);
+
+	}
+
+	return !kill(proc->pid, 0);
+
+}
+
+/*
+ * reset_clock
+ *
+ * Restarts the quantum. Uses the virtual clock in simulation mode.
+ *
+ */
+
+void reset_clock() {
+
+	if (sim_mode) sim_reset_clock();
+	else {
+		
+		alarm(QUANTUM);
+		metrics_armed();
+
+	}
+
+}
+
+/*
+ * stop_clock
+ *
+ * Disarms the clock interrupt. The virtual clock is never stopped.
+ *
+ */
+
+void stop_clock() {
+
+	if (!sim_mode) alarm(0);
+
+}
+
+/*
+ * clock_hold
+ *
+ * Holds off the clock interrupt. next() rotates the ready queue and
+ * dispatches from it inside the handler, so the main loop only changes the
+ * queues with the clock held, and lets it in where it waits.
+ *
+ */
+
+void clock_hold() {
+
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigprocmask(SIG_BLOCK, &set, NULL);
+
+}
+
+/*
+ * clock_allow
+ *
+ * Lets the clock interrupt in. One that came while held is delivered now.
+ *
+ */
+
+void clock_allow() {
+
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigprocmask(SIG_UNBLOCK, &set, NULL);
+
+}
+
+/*
+ * dispatch
+ *
+ * Stops the running process, continues proc and restarts the quantum. With
+ * nothing in the ready queue there is nothing to preempt, so the clock is
+ * stopped instead until a process becomes ready (tickless idle). proc is
+ * the idle process, or NULL if there is none. Companions are picked first,
+ * so a running process that stays on as one is not stopped.
+ *
+ */
+
+void dispatch(pnode *proc) {
+
+	cosched_select(proc);
+
+	/* Stop currently running process if cpu changes hands */
+	if (running_proc && running_proc != proc && !running_proc->co) {
+		
+		proc_signal(running_proc, SIGSTOP);
+		ctx_switches++;
+
+	}
+
+	/* Process keeping the cpu was never stopped, spare the signal */
+	if (proc != running_proc) proc_signal(proc, SIGCONT);
+	running_proc = proc;
+
+	if (head || sim_mode) reset_clock();
+	else stop_clock();
+
+}
+
+/*
+ * proc_starttime
+ *
+ * Returns start time of process in clock ticks since boot, read from 
+ * /proc/<pid>/stat. Returns 0 if process is gone or a zombie.
+ *
+ */
+
+unsigned long long proc_starttime(int pid) {
+
+	char path[32], buf[512], *p;
+	unsigned long long start = 0;
+	FILE *f;
+	int i;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+	if ((f = fopen(path, "r")) == NULL) return 0;
+
+	/* Skip command name, it may contain spaces */
+	if (fgets(buf, sizeof(buf), f) && (p = strrchr(buf, ')')) && p[2] != 'Z') {
+
+		/* Start time is field 22, 20 spaces after the command name */
+		for (i = 0; i < 20 && p; i++) p = strchr(p + 1, ' ');
+
+		if (p) sscanf(p + 1, "%llu", &start);
+
+	}
+
+	fclose(f);
+
+	return start;
+
+}
+
+/*
+ * child_setup
+ *
+ * Gets a new process ready to run, in the process itself.
+ *
+ */
+
+static void child_setup(int pfd[2], struct placement *place) {
+
+	/* Drop pipes of other processes. Read end of own pipe is kept open
+	 * so the pipe outlives the scheduler */
+	out_child(pfd[0], pfd[1]);
+
+	/* Survive the terminal going away with the scheduler, and don't keep
+	 * its clock held, the mask outlives exec */
+	signal(SIGHUP, SIG_IGN);
+	clock_allow();
+
+	/* Off the scheduler's cpu, then pin to cpus and node before
+	 * touching any memory */
+	rt_child();
+	topo_apply(place);
+	limit_child();
+
+	/* Stop until first scheduled, placement and limits set from now
+	 * on can't be overwritten by the ones above */
+	raise(SIGSTOP);
+
+}
+
+/*
+ * spawn_child
+ *
+ * Body of a spawned process, writes its name to the pipe every second.
+ *
+ */
+
+void spawn_child(char *name, int pfd[2], struct placement *place) {
+
+	char string[33] = "";
+	strcat(string, name);
+	strcat(string, "\n");
+
+	child_setup(pfd, place);
+
+	while (1) {
+
+		if(write(pfd[1], string, strlen(string) + 1) != strlen(string) + 1)
+			printf("\n%s", strerror(errno));
+
+		sleep(1);
+	}
+
+}
+
+/*
+ * exec_child
+ *
+ * Body of an executed process, runs argv[0] with output to the pipe.
+ *
+ */
+
+void exec_child(char **argv, int pfd[2], struct placement *place) {
+
+	child_setup(pfd, place);
+
+	/* Redirect stdout to write end of pipe */
+	dup2(pfd[1], STDOUT_FILENO);
+	dup2(pfd[1], STDERR_FILENO);
+
+	/* Close write end of pipe */
+	close(pfd[1]);
+
+	/* Exec and test for error */
+	execv(argv[0], argv);
+
+	/* If code reaches this point, exec failed, print error and flush */
+	printf("ERROR: Could not execute process.\n");
+	fflush(stdout);
+
+	_exit(-1);
+
+}
+
+/*
+ * launch_abort
+ *
+ * Undoes a launch that could not fork, or whose child died before it
+ * stopped: closes both ends of the pipe and drops placement. Returns -1
+ * with error set.
+ *
+ */
+
+static int launch_abort(int pfd[2], struct placement *place, char *error) {
+
+	close(pfd[0]);
+	close(pfd[1]);
+
+	topo_free(place);
+
+	sprintf(errstr, "ERROR: %s", error);
+
+	return -1;
+
+}
+
+/*
+ * launch_wait
+ *
+ * Waits for new child to set itself up and stop. The clock interrupt does
+ * not restart system calls, so the wait is taken again when one lands.
+ * Returns 0 once stopped, -1 if the child died first.
+ *
+ */
+
+static int launch_wait(int pid) {
+
+	int status, r;
+
+	while ((r = waitpid(pid, &status, WUNTRACED)) == -1 && errno == EINTR);
+
+	return r == pid && WIFSTOPPED(status) ? 0 : -1;
+
+}
+
 /*
  * spawn_process
  *
@@ -17,42 +385,64 @@
 
 int spawn_process(char name[32]) {
 
-	pid = 0;
-	pid = fork();
+	mstat.spawns++;
 
-	/* If child process */
-	if (!pid) {
-		
-		char string[33] = "";
-		strcat(string, name);
-		strcat(string, "\n");
+	/* In simulation, model the process instead of forking */
+	if (sim_mode) return sim_spawn(name);
 
-		/* Close read end of pipe on child process */
-		close(fd[0]);
+	/* Or run it inside the scheduler */
+	if (green_mode) return green_spawn(name);
 
-		while (1) {
+	/* Every process gets its own output pipe */
+	int pfd[2];
 
-			if(write(fd[1], string, strlen(string) + 1) != strlen(string) + 1)
-				printf("\n%s", strerror(errno));
+	if (pipe(pfd) == -1) {
 
-			sleep(1);
-		}
+		sprintf(errstr, "ERROR: Could not create output pipe.");
+		return -1;
+
+	}
+
+	/* Chosen before fork so the child can apply it */
+	struct placement *place = topo_place();
+	int cfd = pfd[0];
+
+	/* Take a prefork worker if there is a pool, fork otherwise */
+	if ((pid = zygote_launch(name, NULL, pfd, place, &cfd)) == -1)
+		pid = fork();
+
+	/* Out of processes or memory, nothing was started */
+	if (pid == -1) return launch_abort(pfd, place, "Could not fork process.");
+
+	/* If child process */
+	if (!pid) {
+		
+		spawn_child(name, pfd, place);
 
 	/* If parent process */
 	} else {
 
-		/* Block new process */	
-		kill(pid, SIGSTOP);
+		/* Wait for new process to set itself up and stop */
+		if (launch_wait(pid)) return launch_abort(pfd, place, "Process died while starting.");
+
+		/* Only the child writes */
+		close(pfd[1]);
 
 		/* Create new process node */
 		pnode *proc = pnode_create(pid, name);
+		proc->start = proc_starttime(pid);
+		proc->place = place;
+		proc->rss_max = limit_default[LIM_RSS];
+		out_attach(proc, pfd[0], cfd);
+		proc_track(proc);
+		perf_open(proc);
 		
 		/* Add process to circular linked list */
 		pnode_add_ready(proc);
 
 	}
 
-	return 0;
+	return pid;
 }
 
 /*
@@ -62,45 +452,104 @@ int spawn_process(char name[32]) {
  *
  */
 
-void exec_process(char filename[32]) {
+int exec_process(char **argv) {
 
-	pid = 0;
-	pid = fork();
+	char *filename = argv[0];
 
-	/* If child process */
-	if (!pid) {
+	mstat.spawns++;
 
-		/* Close read end of pipe on child */
-		close(fd[0]);
+	/* In simulation, executables are modelled like spawned processes */
+	if (sim_mode) return sim_spawn(filename);
 
-		/* Redirect stdout to write end of pipe */
-		dup2(fd[1], STDOUT_FILENO);
-		dup2(fd[1], STDERR_FILENO);
+	/* Every process gets its own output pipe */
+	int pfd[2];
 
-		/* Close write end of pipe */
-		close(fd[1]);
+	if (pipe(pfd) == -1) {
 
-		/* Exec and test for error */
-		execl(filename, filename, (char *) 0);
+		sprintf(errstr, "ERROR: Could not create output pipe.");
+		return -1;
+
+	}
 
-		/* If code reaches this point, exec failed, print error and flush */
-		printf("ERROR: Could not execute process.\n");
+	/* Chosen before fork so the child can apply it */
+	struct placement *place = topo_place();
+	int cfd = pfd[0];
 
-		_exit(-1);
+	/* Take a prefork worker if there is a pool, fork otherwise */
+	if ((pid = zygote_launch(filename, argv, pfd, place, &cfd)) == -1)
+		pid = fork();
+
+	/* Out of processes or memory, nothing was started */
+	if (pid == -1) return launch_abort(pfd, place, "Could not fork process.");
+
+	/* If child process */
+	if (!pid) {
+
+		exec_child(argv, pfd, place);
 	
 	} else {
 		
-		/* Block new process */
-		kill(pid, SIGSTOP);
+		/* Wait for new process to set itself up and stop */
+		if (launch_wait(pid)) return launch_abort(pfd, place, "Process died while starting.");
+
+		/* Only the child writes */
+		close(pfd[1]);
 
 		/* Create process node */
 		pnode *proc = pnode_create(pid, filename);
+		proc->start = proc_starttime(pid);
+		proc->place = place;
+		proc->rss_max = limit_default[LIM_RSS];
+		out_attach(proc, pfd[0], cfd);
+		proc_track(proc);
+		perf_open(proc);
 
 		/* Add process to circular linked list */
 		pnode_add_ready(proc);
 		
 	}
 
+	return pid;
+
+}
+
+/*
+ * block_node
+ *
+ * Sets process state to BLOCKED. Blocks process if currently running.
+ *
+ * Takes process node as argument.
+ *
+ */
+
+void block_node(pnode *proc) {
+
+	/* If process isn't blocked */
+	if (proc->state != BLOCKED) {
+		
+		int head_is_proc = head == proc ? 1 : 0;
+
+		/* Stop process, pressure monitor sets its own cause */
+		proc_signal(proc, SIGSTOP);
+		proc->cause = BC_USER;
+
+		/* Remove from ready queue and put in blocked queue */
+		pnode_remove_ready(proc);
+		pnode_add_blocked(proc);
+
+		/* Blocking head, start next in line of the highest priority, or
+		 * idle if queue is empty */
+		if (head_is_proc) {
+
+			if (head) prio_pick();
+			dispatch(head ? head : idle_proc);
+
+		}
+
+	/* If process is already blocked */
+	} else 
+		sprintf(errstr, "Process %d is already blocked.", proc->pid);
+
 }
 
 /*
@@ -117,46 +566,39 @@ void block_process(int pid) {
 	pnode *proc = pnode_get_node_by_pid(pid);
 
 	/* If process was found */
-	if (proc) {
+	if (proc) 
+		block_node(proc);
 		
-		/* If process isn't blocked */
-		if (proc->state != BLOCKED) {
-			
-			int head_is_tail = head == tail ? 1 : 0;
-			int head_is_proc = head == proc ? 1 : 0;
-
-			/* Stop process */
-			kill(proc->pid, SIGSTOP);
+	/* Process was not found */
+	else 
+		sprintf(errstr, "ERROR: Process %d not found.", pid); 
 
-			/* Remove from ready queue and put in blocked queue */
-			pnode_remove_ready(proc);
-			pnode_add_blocked(proc);
+}
 
-			/* More than one process in ready queue and blocking head */
-			if (!head_is_tail) {
-			
-				if (head_is_proc) {
-					
-					kill(head->pid, SIGCONT);
-					alarm(3);
+/*
+ * run_node
+ *
+ * Sets process state to READY. Puts process at end of ready queue.
+ *
+ * Takes process node as argument.
+ *
+ */
 
-				}
+void run_node(pnode *proc) {
 
-			/* Only one process in list, start idle */
-			} else {
+	/* If process isn't ready */
+	if (proc->state != READY) {
 
-				kill(idle_proc->pid, SIGCONT);
-				alarm(3);
-			
-			}
+		/* Gives up whatever it was waiting for */
+		prio_detach(proc);
+		event_cancel(proc);
 
-		/* If process is already blocked */
-		} else 
-			sprintf(errstr, "Process %d is already blocked.", pid);
+		pnode_remove_blocked(proc);
+		pnode_add_ready(proc);
 
-	/* Process was not found */
-	} else 
-		sprintf(errstr, "ERROR: Process %d not found.", pid); 
+	/* Process already runnable */
+	} else
+		sprintf(errstr, "Process %d is already runnable.", proc->pid);
 
 }
 
@@ -174,21 +616,150 @@ void run_process(int pid) {
 	pnode *proc = pnode_get_node_by_pid(pid);
 
 	/* If process was found */
-	if (proc) {
+	if (proc) 
+		run_node(proc);
 	
-		/* If process isn't ready */
-		if (proc->state != READY) {
+	/* Process was not found */
+	else
+		sprintf(errstr, "ERROR: Process %d not found.", pid);
 
-			pnode_remove_blocked(proc);
-			pnode_add_ready(proc);
+}
 
-		/* Process already runnable */
-		} else
-			sprintf(errstr, "Process %d is already runnable.", pid);
+/*
+ * remove_node
+ *
+ * Removes process from scheduling list, sending it sig unless 0. Node is
+ * destroyed.
+ *
+ */
 
-	/* Process was not found */
-	} else
-		sprintf(errstr, "ERROR: Process %d not found.", pid);
+static void remove_node(pnode *tmp, int sig) {
+
+	/* Let go of resources and wake processes waiting on it */
+	prio_exit(tmp);
+	event_cancel(tmp);
+	event_untrack(tmp);
+
+	/* If process is in ready queue */
+	if (tmp->state == READY) {
+	
+		/* Store value before removing node from queue */
+		int head_is_tmp = head == tmp ? 1 : 0;
+
+		/* Remove node from ready queue */
+		pnode_remove_ready(tmp);
+  
+		/* Kill process */
+		if (sig) proc_signal(tmp, sig);
+
+		/* If head is process to be killed, start next in line or idle */
+		if (head_is_tmp) {
+
+			/* Node is gone, nothing to stop */
+			running_proc = NULL;
+
+			if (head) prio_pick();
+			dispatch(head ? head : idle_proc);
+
+		}
+	
+	/* If process is in blocked queue */ 
+	} else {
+	
+		pnode_remove_blocked(tmp);
+		if (sig) proc_signal(tmp, sig);
+	}
+
+	/* Destroy node, its output channel and placement */
+	out_detach(tmp);
+	perf_close(tmp);
+	green_free(tmp);
+	topo_release(tmp);
+	pnode_destroy(tmp);
+
+}
+
+/*
+ * kill_node
+ *
+ * Kills process and removes it from scheduling list. Takes process node as 
+ * argument. Node is destroyed.
+ *
+ */
+
+void kill_node(pnode *tmp) {
+
+	mstat.kills++;
+
+	remove_node(tmp, SIGKILL);
+
+}
+
+/*
+ * proc_track
+ *
+ * Opens pidfd of process, checking start time again for a process that was
+ * not forked here, and hands it to the event loop to learn of its exit.
+ *
+ */
+
+void proc_track(pnode *proc) {
+
+	int pidfd;
+
+	if (sim_mode) return;
+
+	pidfd = syscall(SYS_pidfd_open, proc->pid, 0);
+
+	if (pidfd != -1 && proc_starttime(proc->pid) == proc->start &&
+			!event_track(proc, pidfd))
+		return;
+
+	if (pidfd != -1) close(pidfd);
+
+	untracked = 1;
+
+}
+
+/*
+ * proc_exited
+ *
+ * Called once process is gone, with its node unless it was killed. It leaves
+ * the scheduling list, after what it wrote last is read. Status is -1 if it
+ * was not reaped here, otherwise it is passed on to the job launcher.
+ *
+ */
+
+void proc_exited(pnode *proc, int pid, int status) {
+
+	if (proc && proc != idle_proc) {
+
+		out_drain();
+		remove_node(proc, 0);
+
+	}
+
+	if (status != -1) dag_exited(pid, status);
+
+}
+
+/*
+ * reap_processes
+ *
+ * Collects children that exited without a pidfd telling, so none is left a
+ * zombie. With a pool, workers and orphans taken in as subreaper are such
+ * children. Otherwise every process is tracked and nothing is polled.
+ *
+ */
+
+void reap_processes() {
+
+	int cpid, status;
+
+	if (sim_mode || !(untracked || zygote_pid)) return;
+
+	while ((cpid = waitpid(-1, &status, WNOHANG)) > 0)
+		proc_exited(pnode_get_node_by_pid(cpid), cpid, status);
 
 }
 
@@ -204,56 +775,41 @@ void kill_process(int pid) {
 	pnode *tmp = pnode_get_node_by_pid(pid);
 
 	/* If process is found, adjust list and destroy process */
-	if (tmp) {
+	if (tmp) 
+		kill_node(tmp);
 
-		/* If process is in ready queue */
-		if (tmp->state == READY) {
-		
-			/* Store value before removing node from queue */
-			int head_is_tail = head == tail ? 1 : 0;
-			int head_is_tmp = head == tmp ? 1 : 0;
-
-			/* Remove node from ready queue */
-			pnode_remove_ready(tmp);
-	  
-			/* Kill process */
-			kill(tmp->pid, SIGKILL);
-
-			/* More than one ready process and head is process to kill */
-			if (!head_is_tail) {
-		
-				/* If head is process to be killed */
-				if (head_is_tmp) {
-
-					/* Start next process in line and reset alarm */
-					kill(head->pid, SIGCONT);
-					alarm(3);
+	/* If process not found, display error message */
+	else
+		sprintf(errstr, "ERROR: Process %d not found.", pid);
 
-				}
+}
 
-			/* If there is only one node in the list */
-			} else {
-				
-				/* Start idle process and reset alarm */
-				kill(idle_proc->pid, SIGCONT);
-				alarm(3);
+/*
+ * throttle_process
+ *
+ * Sets output budget of process in bytes per second and policy for output
+ * over budget. If budget is negative, shows output counters instead.
+ *
+ */
 
-			}
-		
-		/* If process is in blocked queue */ 
-		} else {
-		
-			pnode_remove_blocked(tmp);
-			kill(tmp->pid, SIGKILL);
-		}
+void throttle_process(int pid, long budget, int policy) {
 
-		/* Destroy node */
-		pnode_destroy(tmp);
+	pnode *proc = pnode_get_node_by_pid(pid);
 
-	/* If process not found, display error message */
-	} else
+	/* If process was not found */
+	if (!proc)
 		sprintf(errstr, "ERROR: Process %d not found.", pid);
 
-}
+	/* Simulated processes have no output */
+	else if (!proc->och)
+		sprintf(errstr, "ERROR: Process %d has no output channel.", pid);
 
+	/* Show counters */
+	else if (budget < 0)
+		sprintf(errstr, "Process %d: %lu bytes out, %lu throttled, budget %ld/s.",
+				pid, proc->och->bytes, proc->och->throttled, proc->och->budget);
 
+	else
+		out_throttle(proc, budget, policy);
+
+}
@@ -4,15 +4,26 @@
  *
  * @Description: Contains process related functions
  *
+ * @Constants:
+ *
+ * 	QUANTUM		Length of a time slice in seconds
+ *
  * @Functions:
  *
  * 	add_process_ready Adds process to ready queue.
  *
  *
  * 	spawn_process	Spawns a new process in the scheduler. Adds
- * 			process to the process table.
+ * 			process to the process table. Returns pid.
+ *
+ * 	exec_process	Runs executable within sched directory, argv
+ * 			being its NULL terminated arguments. Returns pid.
  *
- * 	exec_process	Runs executable within sched directory.
+ * 	spawn_child	Body of a spawned process, in the new process.
+ * 			Never returns.
+ *
+ * 	exec_child	Body of an executed process, in the new process.
+ * 			Never returns.
  *
  * 	block_process	Sets process state to BLOCKED. Stops process
  * 			if running.
@@ -22,6 +33,47 @@
  *
  * 	kill_process	Kills a process in the process table.
  *
+ * 	throttle_process Sets output budget of a process in bytes per
+ * 			second. Shows output counters if budget is negative.
+ *
+ * 	block_node	Same as block_process, using a node instead of a pid.
+ *
+ * 	run_node	Same as run_process, using a node instead of a pid.
+ *
+ * 	kill_node	Same as kill_process, using a node instead of a pid.
+ *
+ * 	reap_processes	Collects children nobody tracks, with a pool or
+ * 			without pidfds, and takes them off the scheduling
+ * 			list.
+ *
+ * 	proc_track	Opens pidfd of a new process and watches it for
+ * 			its exit.
+ *
+ * 	proc_exited	Takes a process that exited off the scheduling
+ * 			list and tells the job launcher.
+ *
+ * 	proc_signal	Sends a signal to a process, through its pidfd so
+ * 			it can't reach a process that reused the pid.
+ * 			Simulated processes are never signaled.
+ *
+ * 	proc_alive	Returns 1 if process still exists, 0 otherwise.
+ *
+ * 	dispatch	Stops the running process and gives the cpu to
+ * 			another one, or to nobody if NULL. The clock is
+ * 			stopped while the ready queue is empty.
+ *
+ * 	reset_clock	Restarts the quantum, real or virtual.
+ *
+ * 	stop_clock	Disarms the clock interrupt.
+ *
+ * 	clock_hold	Holds off the clock interrupt while the queues are
+ * 			changed.
+ *
+ * 	clock_allow	Lets the clock interrupt in again, delivering one
+ * 			that came while it was held.
+ *
+ * 	proc_starttime	Returns start time of a live process from /proc,
+ * 			0 if it is gone or a zombie.
  *
  */
 
@@ -30,18 +82,31 @@
 #include <signal.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
 
 #ifndef __pnode_h_
 	#include "pnode.h"
 #endif
 
-extern int running_pid, pid, fd[2];
+#define QUANTUM		3
+
+extern int pid, fd[2];
+extern pnode *running_proc;
+extern unsigned long ctx_switches;
 
 void add_process_ready(pnode *proc);
 
 int spawn_process(char name[32]);
 
-void exec_proces(char *filename);
+int exec_process(char **argv);
+
+struct placement;
+
+void spawn_child(char *name, int pfd[2], struct placement *place);
+
+void exec_child(char **argv, int pfd[2], struct placement *place);
 
 void block_process(int pid);
 
@@ -49,3 +114,33 @@ void run_process(int pid);
 
 void kill_process(int pid);
 
+void throttle_process(int pid, long budget, int policy);
+
+void block_node(pnode *proc);
+
+void run_node(pnode *proc);
+
+void kill_node(pnode *proc);
+
+void reap_processes();
+
+void proc_track(pnode *proc);
+
+void proc_exited(pnode *proc, int pid, int status);
+
+int proc_signal(pnode *proc, int sig);
+
+int proc_alive(pnode *proc);
+
+void dispatch(pnode *proc);
+
+void reset_clock();
+
+void stop_clock();
+
+void clock_hold();
+
+void clock_allow();
+
+unsigned long long proc_starttime(int pid);
+
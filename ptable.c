@@ -0,0 +1,279 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	ptable
+ *
+ * @Description: Process table as arrays
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ptable.h"
+#include "pick.h"
+
+/*
+ * grow
+ *
+ * Doubles capacity of every array. Returns -1 with error set on failure.
+ *
+ */
+
+static int grow(ptable *pt) {
+
+	int cap = pt->cap ? pt->cap * 2 : 64;
+	void *p;
+
+	if (!(p = realloc(pt->pid, cap * sizeof(int)))) goto fail;
+	pt->pid = p;
+	if (!(p = realloc(pt->state, cap))) goto fail;
+	pt->state = p;
+	if (!(p = realloc(pt->prio, cap))) goto fail;
+	pt->prio = p;
+	if (!(p = realloc(pt->node, cap * sizeof(pnode *)))) goto fail;
+	pt->node = p;
+	if (!(p = realloc(pt->next, cap * sizeof(int)))) goto fail;
+	pt->next = p;
+	if (!(p = realloc(pt->prev, cap * sizeof(int)))) goto fail;
+	pt->prev = p;
+	if (!(p = realloc(pt->freel, cap * sizeof(int)))) goto fail;
+	pt->freel = p;
+
+	/* First use of a table */
+	if (!pt->cap) pt->ready = pt->cursor = -1;
+
+	pt->cap = cap;
+
+	return 0;
+
+fail:
+	sprintf(errstr, "ERROR: Process table can't grow past %d.", pt->cap);
+	return -1;
+
+}
+
+/*
+ * ptable_add
+ *
+ * Takes a free slot, or a new one, for node.
+ *
+ */
+
+int ptable_add(ptable *pt, pnode *node) {
+
+	int slot;
+
+	if (pt->nfree) slot = pt->freel[--pt->nfree];
+	else if (pt->size < pt->cap || !grow(pt)) slot = pt->size++;
+	else return -1;
+
+	pt->pid[slot] = node->pid;
+	pt->state[slot] = PT_OUT;
+	pt->prio[slot] = node->eprio;
+	pt->node[slot] = node;
+
+	return slot;
+
+}
+
+/*
+ * ptable_remove
+ *
+ * Puts slot on the free list. Slot must be out of the ready queue, dequeued
+ * first if it was enqueued.
+ *
+ */
+
+void ptable_remove(ptable *pt, int slot) {
+
+	if (slot < 0) return;
+
+	pt->pid[slot] = -1;
+	pt->state[slot] = PT_FREE;
+	pt->node[slot] = NULL;
+
+	pt->freel[pt->nfree++] = slot;
+
+}
+
+/*
+ * ptable_find
+ *
+ * Scans pids. No early exit, so the loop vectorises and a pid never sits
+ * in two slots anyway.
+ *
+ */
+
+int ptable_find(ptable *pt, int pid) {
+
+	int i, slot = -1;
+
+	for (i = 0; i < pt->size; i++)
+		slot = pt->pid[i] == pid ? i : slot;
+
+	return slot;
+
+}
+
+/*
+ * ptable_mark
+ *
+ * Sets state of slot, leaving ready queue and counts alone. For a table whose
+ * queues are kept elsewhere, only telling which slots are queued.
+ *
+ */
+
+void ptable_mark(ptable *pt, int slot, int state) {
+
+	if (slot >= 0) pt->state[slot] = state;
+
+}
+
+/*
+ * ptable_enqueue
+ *
+ * Appends slot at end of ready queue.
+ *
+ */
+
+void ptable_enqueue(ptable *pt, int slot) {
+
+	int first = pt->ready;
+
+	if (slot < 0 || pt->state[slot] == READY) return;
+
+	if (first == -1) {
+
+		pt->ready = pt->next[slot] = pt->prev[slot] = slot;
+
+	} else {
+
+		pt->next[slot] = first;
+		pt->prev[slot] = pt->prev[first];
+		pt->next[pt->prev[first]] = slot;
+		pt->prev[first] = slot;
+
+	}
+
+	pt->state[slot] = READY;
+	pt->nready++;
+	pt->nprio[(int)pt->prio[slot]]++;
+
+}
+
+/*
+ * ptable_dequeue
+ *
+ * Unlinks slot from ready queue if it is in it, marks it in no queue.
+ *
+ */
+
+void ptable_dequeue(ptable *pt, int slot) {
+
+	if (slot < 0) return;
+
+	if (pt->state[slot] == READY) {
+
+		if (pt->next[slot] == slot) pt->ready = -1;
+		else {
+
+			pt->next[pt->prev[slot]] = pt->next[slot];
+			pt->prev[pt->next[slot]] = pt->prev[slot];
+
+			if (pt->ready == slot) pt->ready = pt->next[slot];
+
+		}
+
+		pt->nready--;
+		pt->nprio[(int)pt->prio[slot]]--;
+
+	}
+
+	pt->state[slot] = PT_OUT;
+
+}
+
+/*
+ * ptable_block
+ *
+ * Marks slot blocked, out of the ready queue.
+ *
+ */
+
+void ptable_block(ptable *pt, int slot) {
+
+	if (slot < 0) return;
+
+	ptable_dequeue(pt, slot);
+	pt->state[slot] = BLOCKED;
+
+}
+
+/*
+ * ptable_prio
+ *
+ * Sets priority of slot.
+ *
+ */
+
+void ptable_prio(ptable *pt, int slot, int prio) {
+
+	if (slot < 0) return;
+
+	if (pt->state[slot] == READY) {
+
+		pt->nprio[(int)pt->prio[slot]]--;
+		pt->nprio[prio]++;
+
+	}
+
+	pt->prio[slot] = prio;
+
+}
+
+/*
+ * ptable_pick
+ *
+ * Highest priority ready comes from the counts, then the first slot of that
+ * priority after the last one picked is taken, so slots of the same priority
+ * take turns. The search is vectorised, see pick.
+ *
+ */
+
+int ptable_pick(ptable *pt) {
+
+	int i, top = PRIO_LEVELS - 1;
+
+	if (!pt->nready) return -1;
+
+	while (top > 0 && !pt->nprio[top]) top--;
+
+	if ((i = pick_first(pt->state, pt->prio, pt->cursor + 1, pt->size, top)) == -1)
+		i = pick_first(pt->state, pt->prio, 0, pt->cursor + 1, top);
+
+	return pt->cursor = i;
+
+}
+
+/*
+ * ptable_free
+ *
+ * Frees arrays and empties table.
+ *
+ */
+
+void ptable_free(ptable *pt) {
+
+	free(pt->pid);
+	free(pt->state);
+	free(pt->prio);
+	free(pt->node);
+	free(pt->next);
+	free(pt->prev);
+	free(pt->freel);
+
+	memset(pt, 0, sizeof(ptable));
+
+}
+
@@ -0,0 +1,101 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	ptable.h
+ *
+ * @Description: Process table laid out as arrays. Each field of a process
+ * 		(pid, state, priority, ...) lives in its own contiguous array
+ * 		and a process is an index in them, its slot. Queues link slots
+ * 		by index instead of pointer.
+ *
+ * 		Scanning the table only touches the arrays a scan needs, one
+ * 		cache line holding 16 pids or 64 states, in order, so the
+ * 		hardware prefetcher keeps up and the compiler can vectorise
+ * 		the loops. The linked pnodes are each their own allocation and
+ * 		walking them is a cache miss per process.
+ *
+ * 		The scheduler looks processes up through it, marking which
+ * 		slots are queued. Its queues stay in the pnodes, the ready
+ * 		queue of the table, its counts and ptable_pick are only used
+ * 		by ptbench, which compares both layouts, build it with make
+ * 		bench.
+ *
+ * @Constants:
+ *
+ * 	PT_FREE		State of an unused slot
+ *
+ * 	PT_OUT		State of a process in no queue
+ *
+ * @Functions:
+ *
+ * 	ptable_add	Takes a slot for a node. Returns it, -1 with error
+ * 			set if the table can't grow.
+ *
+ * 	ptable_remove	Gives slot back, out of the ready queue.
+ *
+ * 	ptable_mark	Sets state of slot without queueing it.
+ *
+ * 	ptable_find	Returns slot of pid, -1 if not found.
+ *
+ * 	ptable_enqueue	Appends slot to ready queue.
+ *
+ * 	ptable_dequeue	Takes slot out of its queue.
+ *
+ * 	ptable_block	Marks slot blocked.
+ *
+ * 	ptable_prio	Sets priority of slot.
+ *
+ * 	ptable_pick	Returns next ready slot of the highest priority, in
+ * 			turns, -1 if none is ready.
+ *
+ * 	ptable_free	Frees arrays of table.
+ *
+ */
+
+#define __ptable_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define PT_FREE		0xff
+#define PT_OUT		0xfe
+
+typedef struct ptable {
+	int		*pid;		/* -1 if free */
+	unsigned char	*state;		/* READY, BLOCKED, PT_OUT or PT_FREE */
+	signed char	*prio;		/* Effective priority */
+	pnode		**node;
+	int		*next;		/* Ready queue, circular */
+	int		*prev;
+	int		*freel;		/* Free slots, taken last first */
+	int		nfree;
+	int		size;		/* Slots ever used */
+	int		cap;
+	int		ready;		/* First of ready queue, -1 if empty */
+	int		nready;
+	int		nprio[PRIO_LEVELS];	/* Ready per priority */
+	int		cursor;		/* Last slot picked */
+} ptable;
+
+extern ptable ptab;
+
+int ptable_add(ptable *pt, pnode *node);
+
+void ptable_remove(ptable *pt, int slot);
+
+void ptable_mark(ptable *pt, int slot, int state);
+
+int ptable_find(ptable *pt, int pid);
+
+void ptable_enqueue(ptable *pt, int slot);
+
+void ptable_dequeue(ptable *pt, int slot);
+
+void ptable_block(ptable *pt, int slot);
+
+void ptable_prio(ptable *pt, int slot, int prio);
+
+int ptable_pick(ptable *pt);
+
+void ptable_free(ptable *pt);
+
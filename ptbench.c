@@ -0,0 +1,351 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	ptbench
+ *
+ * @Description: Compares linked pnodes against the process table arrays.
+ * 		Builds n processes both ways and times pid lookups, picking
+ * 		the next process the way next() does, and a scan of every
+ * 		process like the one the UI and priority inheritance do.
+ *
+ * 		Then times the pick-next kernels, the max reduction over
+ * 		priorities and the pick itself, against walking the ring.
+ *
+ * 		Nodes are allocated along with their names like pnode_create
+ * 		does, and linked in random order, since processes blocking
+ * 		and running shuffle the ready queue of a long running
+ * 		scheduler.
+ *
+ * 		Usage: ptbench [n] [rounds]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pnode.h"
+#include "ptable.h"
+#include "pick.h"
+
+char errstr[128];
+ptable ptab;
+
+static pnode *ring;
+
+/*
+ * now
+ *
+ * Returns monotonic time in microseconds.
+ *
+ */
+
+static double now() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+
+}
+
+/*
+ * build
+ *
+ * Creates n processes, 1 in 100 of priority 5, the others 0. Returns
+ * number of processes of priority 5.
+ *
+ */
+
+static int build(int n) {
+
+	pnode **nodes = malloc(n * sizeof(pnode *)), *tmp;
+	int i, j, top = 0;
+	char name[32];
+
+	for (i = 0; i < n; i++) {
+
+		nodes[i] = calloc(1, sizeof(pnode));
+		nodes[i]->pid = 1000 + i;
+		sprintf(name, "proc%d", i);
+		nodes[i]->name = strdup(name);
+		nodes[i]->eprio = rand() % 100 ? 0 : 5;
+		top += nodes[i]->eprio == 5;
+
+		nodes[i]->slot = ptable_add(&ptab, nodes[i]);
+		ptable_prio(&ptab, nodes[i]->slot, nodes[i]->eprio);
+
+	}
+
+	/* Shuffle, then link in that order */
+	for (i = n - 1; i > 0; i--) {
+
+		j = rand() % (i + 1);
+		tmp = nodes[i];
+		nodes[i] = nodes[j];
+		nodes[j] = tmp;
+
+	}
+
+	for (i = 0; i < n; i++) {
+
+		nodes[i]->next = nodes[(i + 1) % n];
+		nodes[i]->prev = nodes[(i + n - 1) % n];
+		ptable_enqueue(&ptab, nodes[i]->slot);
+
+	}
+
+	ring = nodes[0];
+	free(nodes);
+
+	return top;
+
+}
+
+/*
+ * linked_find
+ *
+ * Walks ring for pid like pnode_get_node_by_pid used to.
+ *
+ */
+
+static pnode* linked_find(int pid) {
+
+	pnode *tmp = ring;
+
+	while (tmp->pid != pid && tmp->next != ring) tmp = tmp->next;
+
+	return tmp->pid == pid ? tmp : NULL;
+
+}
+
+/*
+ * linked_pick
+ *
+ * Moves on from head, then rotates until a process of the highest priority
+ * is found, like next() and prio_pick().
+ *
+ */
+
+static pnode* linked_pick(int top) {
+
+	ring = ring->next;
+
+	while (ring->eprio < top) ring = ring->next;
+
+	return ring;
+
+}
+
+/*
+ * linked_max
+ *
+ * Highest priority walking the ring, what next() would do without counts.
+ *
+ */
+
+static int linked_max() {
+
+	pnode *tmp = ring;
+	int top = -1;
+
+	do {
+
+		if (tmp->eprio > top) top = tmp->eprio;
+		tmp = tmp->next;
+
+	} while (tmp != ring);
+
+	return top;
+
+}
+
+/*
+ * linked_scan
+ *
+ * Counts ready processes per priority walking the ring.
+ *
+ */
+
+static long linked_scan(long *count) {
+
+	pnode *tmp = ring;
+
+	do {
+
+		count[tmp->eprio]++;
+		tmp = tmp->next;
+
+	} while (tmp != ring);
+
+	return count[0];
+
+}
+
+/*
+ * table_scan
+ *
+ * Counts ready processes per priority over the table arrays.
+ *
+ */
+
+static long table_scan(long *count) {
+
+	int i;
+
+	for (i = 0; i < ptab.size; i++)
+		count[ptab.prio[i]] += ptab.state[i] == READY;
+
+	return count[0];
+
+}
+
+/*
+ * report
+ *
+ * Prints time per operation of both layouts.
+ *
+ */
+
+static void report(char *what, double linked, double table, int rounds) {
+
+	printf("%-8s %12.3f us %12.3f us %8.1fx\n", what, linked / rounds,
+			table / rounds, table > 0 ? linked / table : 0);
+
+}
+
+/*
+ * kernels
+ *
+ * Times max reduction and pick of every kernel the CPU supports against
+ * the ring. Every kernel must find the same as the ring.
+ *
+ */
+
+static void kernels(int top, int rounds) {
+
+	static char *names[] = {"scalar", "sse4", "avx2"};
+	double t, tmax, tpick;
+	unsigned long picked, first = 0;
+	int i, k, done = 0;
+
+	printf("\n%-8s %15s %15s\n", "kernel", "max", "pick");
+
+	t = now();
+	for (i = 0; i < rounds; i++) if (linked_max() != top) printf("Ring max differs.\n");
+	tmax = now() - t;
+
+	t = now();
+	for (i = 0; i < rounds; i++) linked_pick(top);
+	tpick = now() - t;
+
+	printf("%-8s %12.3f us %12.3f us\n", "linked", tmax / rounds, tpick / rounds);
+
+	for (k = 0; k < 3; k++) {
+
+		if (pick_init(names[k])) {
+
+			printf("%-8s %15s\n", names[k], "unsupported");
+			continue;
+
+		}
+
+		t = now();
+		for (i = 0; i < rounds; i++) 
+			if (pick_max(ptab.state, ptab.prio, ptab.size) != top) printf("%s max differs.\n", names[k]);
+		tmax = now() - t;
+
+		/* Same picks from the same start */
+		ptab.cursor = -1;
+		picked = 0;
+
+		t = now();
+		for (i = 0; i < rounds; i++) picked = picked * 31 + ptable_pick(&ptab);
+		tpick = now() - t;
+
+		if (!done++) first = picked;
+		else if (picked != first) printf("%s picks differ.\n", names[k]);
+
+		printf("%-8s %12.3f us %12.3f us\n", names[k], tmax / rounds, tpick / rounds);
+
+	}
+
+	pick_init("auto");
+
+}
+
+int main(int argc, char **argv) {
+
+	int n = argc > 1 ? atoi(argv[1]) : 100000;
+	int rounds = argc > 2 ? atoi(argv[2]) : 1000;
+	long lcount[PRIO_LEVELS] = {0}, tcount[PRIO_LEVELS] = {0}, check = 0;
+	int *pids, i, top;
+	double t, linked, table;
+
+	if (n < 1 || rounds < 1) {
+
+		fprintf(stderr, "Usage: ptbench [n] [rounds]\n");
+		return 1;
+
+	}
+
+	srand(1);
+	top = build(n);
+
+	pids = malloc(rounds * sizeof(int));
+	for (i = 0; i < rounds; i++) pids[i] = 1000 + rand() % n;
+
+	printf("%d processes, %d of priority 5, %d rounds\n\n", n, top, rounds);
+
+	/* Highest priority there is, as counted per level by the scheduler */
+	top = top ? 5 : 0;
+	printf("%-8s %15s %15s %9s\n", "", "linked", "table", "speedup");
+
+	/* Lookup */
+	t = now();
+	for (i = 0; i < rounds; i++) check += linked_find(pids[i])->pid;
+	linked = now() - t;
+
+	t = now();
+	for (i = 0; i < rounds; i++) check -= ptab.node[ptable_find(&ptab, pids[i])]->pid;
+	table = now() - t;
+
+	report("lookup", linked, table, rounds);
+
+	/* Pick next */
+	t = now();
+	for (i = 0; i < rounds; i++) check += linked_pick(top)->eprio;
+	linked = now() - t;
+
+	t = now();
+	for (i = 0; i < rounds; i++) check -= ptab.prio[ptable_pick(&ptab)];
+	table = now() - t;
+
+	report("pick", linked, table, rounds);
+
+	/* Full scan */
+	t = now();
+	for (i = 0; i < rounds; i++) check += linked_scan(lcount);
+	linked = now() - t;
+
+	t = now();
+	for (i = 0; i < rounds; i++) check -= table_scan(tcount);
+	table = now() - t;
+
+	report("scan", linked, table, rounds);
+
+	kernels(top, rounds);
+
+	/* Both layouts must have found the same */
+	if (check) {
+
+		fprintf(stderr, "Results differ.\n");
+		return 1;
+
+	}
+
+	return 0;
+
+}
+
@@ -0,0 +1,144 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	rt
+ *
+ * @Description: Realtime core
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+/* Error message, in sched.c */
+extern char errstr[128];
+
+/* Cpus processes run on, set once a cpu is reserved */
+static cpu_set_t others;
+static int reserved = -1;
+
+/*
+ * prefault_stack
+ *
+ * Touches RT_STACK bytes of stack, so they are mapped and locked.
+ *
+ */
+
+static void prefault_stack() {
+
+	volatile char stack[RT_STACK];
+
+	memset((char *)stack, 0, sizeof(stack));
+
+}
+
+/*
+ * prefault_heap
+ *
+ * Grows heap by RT_HEAP and hands it back to malloc, which is told to keep
+ * it and never map allocations of its own.
+ *
+ */
+
+static void prefault_heap() {
+
+	char *p;
+
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if ((p = malloc(RT_HEAP))) {
+
+		memset(p, 0, RT_HEAP);
+		free(p);
+
+	}
+
+}
+
+/*
+ * rt_reserve
+ *
+ * Sets cpu aside for the scheduler and works out the cpus left to processes.
+ * Called before any helper is forked, so workers of the pool inherit them.
+ *
+ */
+
+int rt_reserve(int cpu) {
+
+	if (sched_getaffinity(0, sizeof(others), &others) ||
+			cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &others)) {
+
+		sprintf(errstr, "ERROR: Cpu %d is not available.", cpu);
+		return -1;
+
+	}
+
+	/* On a single cpu, processes have to share it */
+	if (CPU_COUNT(&others) > 1) CPU_CLR(cpu, &others);
+
+	reserved = cpu;
+
+	return 0;
+
+}
+
+/*
+ * rt_init
+ *
+ * Pins scheduler to the reserved cpu, switches it to SCHED_FIFO and locks its
+ * memory.
+ *
+ */
+
+int rt_init() {
+
+	struct sched_param sp = { RT_PRIO };
+	cpu_set_t mine;
+
+	CPU_ZERO(&mine);
+	CPU_SET(reserved, &mine);
+
+	if (sched_setaffinity(0, sizeof(mine), &mine) ||
+			sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &sp)) {
+
+		sprintf(errstr, "ERROR: Could not run on cpu %d under SCHED_FIFO.", reserved);
+		return -1;
+
+	}
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+
+		sprintf(errstr, "ERROR: Could not lock memory.");
+		return -1;
+
+	}
+
+	prefault_heap();
+	prefault_stack();
+
+	return 0;
+
+}
+
+/*
+ * rt_child
+ *
+ * Gives new process every cpu but the reserved one. Memory locks are never
+ * inherited, nor is the policy.
+ *
+ */
+
+void rt_child() {
+
+	if (reserved != -1) sched_setaffinity(0, sizeof(others), &others);
+
+}
+
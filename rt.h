@@ -0,0 +1,53 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	rt.h
+ *
+ * @Description: Realtime core. With -R, the scheduler keeps one cpu to itself
+ * 		and runs there under SCHED_FIFO, so the clock interrupt handler
+ * 		dispatching processes is never kept waiting behind them. All its
+ * 		memory is locked and the heap and stack are faulted in up front,
+ * 		so it never page faults on the way either. The ncurses screen is
+ * 		drawn by the same thread: the clock interrupt preempts it while
+ * 		it is written to the terminal, so a slow terminal never holds
+ * 		up a dispatch.
+ *
+ * 		Processes don't inherit any of it. The policy is reset on fork,
+ * 		and new processes run on every other cpu, unless placed.
+ *
+ * 		How late quantum boundaries fire is kept as a histogram, see the
+ * 		jitter command.
+ *
+ * @Constants:
+ *
+ * 	RT_PRIO		SCHED_FIFO priority of the scheduler
+ *
+ * 	RT_HEAP		Heap faulted in and kept
+ *
+ * 	RT_STACK	Stack faulted in
+ *
+ * @Functions:
+ *
+ * 	rt_reserve	Sets a cpu aside for the scheduler, before helpers
+ * 			are forked. Returns 0 on success, -1 with error set
+ * 			otherwise.
+ *
+ * 	rt_init		Moves scheduler to the reserved cpu, under SCHED_FIFO
+ * 			with memory locked. Returns 0 on success, -1 with
+ * 			error set otherwise.
+ *
+ * 	rt_child	Called in a new child. Moves it off the reserved cpu.
+ *
+ */
+
+#define __rt_h_
+
+#define RT_PRIO		50
+#define RT_HEAP		(8 << 20)
+#define RT_STACK	(256 << 10)
+
+int rt_reserve(int cpu);
+
+int rt_init();
+
+void rt_child();
+
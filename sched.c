@@ -3,28 +3,161 @@
  * @Title:	Scheduler (Assignment #1 - CS3790) 
  *
  * @Description: Scheduler simulator. Spawn and kill processes on the fly. Scheduling
- * 		uses a circular linked list like a real kernel and has an idle process
- * 		if no other processes are scheduled to run.
+ * 		uses a circular linked list like a real kernel. If no processes are
+ * 		scheduled to run, the clock is stopped and the scheduler sleeps until
+ * 		one is (tickless idle), or runs an idle process with -i.
  *
  *	 	To use a command, type the command in the specified format and then 
  *	 	press enter at the "COMMAND > " prompt.
  *
  * @Commands:	
  *
- * 	spawn <processname>	Forks scheduler and spawns a process that outputs
- * 				processname to the pipe. Process name is 8 characters
- * 				maximum.
+ * 	spawn <processname> [count]
+ * 				Forks scheduler and spawns a process that outputs
+ * 				processname to the pipe, or count of them. Process
+ * 				name is 8 characters maximum.
  *
  * 	kill <pid>		Kills a process using its process id (pid).	
  *
- * 	exec <filename>		Executes process within scheduler directory and pipes
+ * 	dag [<file> [max]]	Runs stages of a job file in dependency order,
+ * 				max at once (default 4), see dag.h. Without a
+ * 				file, shows progress.
+ *
+ * 	block <pid> [fd|timer|exit|file <arg>]
+ * 				Blocks a process until run, or until an event
+ * 				fires: a descriptor or FIFO is readable, a
+ * 				delay in ms elapses, a process exits or a file
+ * 				appears. See event.h.
+ *
+ * 	exec <filename> [args]	Executes process within scheduler directory and pipes
  * 				the output to the scheduler.
  *
  * 	help			Displays a window with available commands and their
  * 				syntax.
  *
+ * 	throttle <pid> [<bytes> [drop|sample]]
+ * 				Sets output budget of a process in bytes per
+ * 				second, 0 for none. Output over budget is
+ * 				dropped or sampled. Without a budget, shows
+ * 				how much output was throttled.
+ *
+ * 	trigger [<pattern> [block|run|kill [pid]]]
+ * 				Blocks, runs or kills the process printing
+ * 				pattern, or pid. With a pattern alone, drops
+ * 				its triggers, without one, lists them. See
+ * 				trig.h.
+ *
+ * 	green			Times a switch into a green task and back.
+ *
+ * 	archive [<since> [until]]
+ * 				Pages through archived output from since ago
+ * 				until until ago, durations like 15m. Without
+ * 				them, shows archive size. Needs -A.
+ *
+ * 	jitter			Shows how late quantum boundaries fired, as
+ * 				a histogram.
+ *
+ * 	log <pid> [since]	Pages through everything process logged, or
+ * 				only the last part of it, since being a
+ * 				duration like 90, 15m or 2h. Needs -L.
+ *
+ * 	prio <pid> [level]	Sets priority of a process, 0 (lowest, default)
+ * 				to 9. Only processes of the highest priority
+ * 				ready are run. Without a level, shows base and
+ * 				effective priority.
+ *
+ * 	wait <pid> <pid>	Blocks first process until second one exits.
+ *
+ * 	hold <pid> <name>	Gives named resource to process, or blocks it
+ * 				until the resource is released.
+ *
+ * 	release <pid> <name>	Releases resource, waking its highest priority
+ * 				waiter. A process blocking a higher priority
+ * 				one inherits its priority, see prio.h.
+ *
+ * 	limit <pid> [rss|cpu|fds <value>]
+ * 				Sets memory, cpu seconds or open files
+ * 				limit of a process, 0 for none. Without a
+ * 				limit, shows them.
+ *
+ * 	affinity <pid> <cpus>	Pins every thread of a process to a cpu list,
+ * 				like 0-3,8.
+ *
+ * 	numa <pid> <node>	Pins process to cpus of a NUMA node and
+ * 				migrates its memory there.
+ *
  *	quit			Quits the scheduler. Return to shell.
  *
+ * @Options:
+ *
+ * 	-A <dir>[,<size>[,<age>]]
+ * 				Archives everything processes log into
+ * 				compressed files in dir, a new one every size
+ * 				MB or age, see arch.h.
+ *
+ * 	-a			Places every new process on the NUMA node
+ * 				running the fewest, memory bound to it.
+ *
+ * 	-S <statefile>		Snapshots process table into statefile. On
+ * 				startup, re-adopts children left by a previous
+ * 				scheduler that died.
+ *
+ * 	-R <cpu>		Realtime core. Runs the scheduler alone on
+ * 				cpu under SCHED_FIFO with its memory locked,
+ * 				see rt.h.
+ *
+ * 	-r <tracefile>		Records every command typed into tracefile.
+ *
+ * 	-b <bytes>		Output budget of new processes, in bytes per
+ * 				second. Output over budget is dropped.
+ *
+ * 	-E			Drains output through epoll instead of
+ * 				io_uring, see output.h.
+ *
+ * 	-g			Spawns green tasks running inside the
+ * 				scheduler instead of processes, see green.h.
+ *
+ * 	-i			Forks an idle process, run when no other
+ * 				process is ready. Without it the scheduler
+ * 				stops its clock and sleeps instead.
+ *
+ * 	-l <limits>		Limits of new processes, like
+ * 				rss=512M,cpu=60,fds=256, see limit.h.
+ *
+ * 	-P			Counts cycles, instructions, cache misses and
+ * 				context switches of every process, see
+ * 				perf.h.
+ *
+ * 	-p <thresholds>		Blocks biggest memory or io users while
+ * 				pressure is over thresholds in percent, like
+ * 				mem=10,io=20, see pressure.h.
+ *
+ * 	-L <dir>		Keeps everything processes log in per process
+ * 				files in dir, see plog.h.
+ *
+ * 	-m <file>		Writes metrics in Prometheus text format to
+ * 				file every second.
+ *
+ * 	-t <file>		Loads output triggers from file, an action
+ * 				and a pattern per line, see trig.h.
+ *
+ * 	-s <tracefile>		Does not start the user interface. Replays
+ * 				tracefile in simulation mode under a virtual
+ * 				clock and prints a report.
+ *
+ * 	-w <width>[,rr]		Runs up to width processes at once, pairing
+ * 				cache heavy and light ones by their misses
+ * 				under -P, or in queue order with rr, see
+ * 				cosched.h.
+ *
+ * 	-x <name>		Publishes process table and counters in
+ * 				shared memory for readers like spstat, see
+ * 				spage.h.
+ *
+ * 	-z <workers>		Keeps a pool of workers forked ahead of time
+ * 				by a helper process, which spawn and exec
+ * 				hand launches to, see zygote.h.
+ *
  */
 
 #include <stdio.h>
@@ -33,13 +166,93 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
 
 #include "pnode.h"
 #include "ui.h"
 #include "proc.h"
-#include "comm.h"
 
-int pid, running_pid, fd[2];
+#ifndef __comm_h_
+	#include "comm.h"
+#endif
+
+#ifndef __sim_h_
+	#include "sim.h"
+#endif
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+#ifndef __state_h_
+	#include "state.h"
+#endif
+
+#ifndef __output_h_
+	#include "output.h"
+#endif
+
+#ifndef __plog_h_
+	#include "plog.h"
+#endif
+
+#ifndef __topo_h_
+	#include "topo.h"
+#endif
+
+#ifndef __limit_h_
+	#include "limit.h"
+#endif
+
+#ifndef __pressure_h_
+	#include "pressure.h"
+#endif
+
+#ifndef __prio_h_
+	#include "prio.h"
+#endif
+
+#ifndef __event_h_
+	#include "event.h"
+#endif
+
+#ifndef __ptable_h_
+	#include "ptable.h"
+#endif
+
+#ifndef __zygote_h_
+	#include "zygote.h"
+#endif
+
+#ifndef __rt_h_
+	#include "rt.h"
+#endif
+
+#ifndef __perf_h_
+	#include "perf.h"
+#endif
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
+
+#ifndef __green_h_
+	#include "green.h"
+#endif
+
+#ifndef __trig_h_
+	#include "trig.h"
+#endif
+
+#ifndef __arch_h_
+	#include "arch.h"
+#endif
+
+#ifndef __spage_h_
+	#include "spage.h"
+#endif
+
+int pid, fd[2];
 
 /* Signal handling variables */
 struct sigaction newhandler, oldhandler, resizehandler;
@@ -47,6 +260,9 @@ sigset_t sig;
 
 /* Process table variables */
 pnode *head, *tail, *blocked, *idle_proc;
+int nready = 0, nblocked = 0;
+int nready_prio[PRIO_LEVELS] = {0};
+ptable ptab;
 
 /* Terminal geometry variables. Updated in init_ncurses() */
 int ncols = 80, nrows = 24;
@@ -54,7 +270,6 @@ int ncols = 80, nrows = 24;
 /* Command buffer */
 char comm[64] = {0};
 int comm_ptr = 0;
-char args[2][64] = {0};
 
 /* Command history */
 char *history[HIST_MAX];
@@ -86,7 +301,8 @@ void winch_handler(int code) {
 /* 
  * next
  *
- * Runs next process in process table. If no processes are queued, run idle process. 
+ * Runs next process in process table. If no processes are queued, run idle process
+ * if there is one, otherwise stop the clock until a process is queued.
  *
  * NB: code argument is passed by OS on signal
  *
@@ -94,44 +310,38 @@ void winch_handler(int code) {
 
 void next(int code) {
 
-	/* Stop currently running process */
-	kill(running_pid, SIGSTOP); 
-	
-	/* If there's a process in the list */
+	/* Measure clock interrupt lateness */
+	if (code) metrics_tick();
+
+	/* If there's a process in the list, rotate to the next one */
 	if (head) { 
 
 		/* Fix pointers */
 		tail = head;
 		head = head->next;
 
-		/* If there is a process left in the list */
-		if (head) {
-			
-			kill(head->pid, SIGCONT);
-			running_pid = head->pid;
+		/* Companions of last quantum had their turn */
+		cosched_skip();
 
-		/* Else run idle */
-		} else if (!kill(idle_proc->pid, 0)) {
+		/* Skip processes of lower priority than the highest ready */
+		prio_pick();
 
-			kill(idle_proc->pid, SIGCONT);
-			running_pid = idle_proc->pid;
-		
-		/* If idle is not alive, fail catastrophically */
-		} else 
-			exit(-1);
+		dispatch(head);
+
+	/* If list is empty and there is no idle process, cpu is idle */
+	} else if (!idle_proc)
+
+		dispatch(NULL);
 
 	/* If list is empty, run idle process */
-	} else if (!kill(idle_proc->pid, 0)) {
+	else if (proc_alive(idle_proc)) 
 
-		kill(idle_proc->pid, SIGCONT);
-		running_pid = idle_proc->pid;
+		dispatch(idle_proc);
 
 	/* If idle is not alive, fail catastrophically */
-	} else
+	else
 		exit(-1);
 
-	alarm(3);
-
 }
 
 /*
@@ -159,6 +369,9 @@ void setup_winch_handler() {
 
 void setup_clock_int() {
 
+	/* Queues are only changed with the clock held from now on */
+	clock_hold();
+
 	/* Setup signal handler struct */
 	sigemptyset(&sig);
 	newhandler.sa_handler = next;
@@ -173,23 +386,24 @@ void setup_clock_int() {
 
 	}
 
-	alarm(3);
+	reset_clock();
 }
 
 /*
- * Main program
+ * spawn_idle
+ *
+ * Forks idle process, which outputs to the pipe every second. Returns its
+ * node.
  *
  */
 
-int main() {
+pnode* spawn_idle() {
 
-	/* Init variables */
-	char buffer[1024];
+	pnode *proc;
 
-	/* Init pipe */
+	/* Init idle process pipe */
 	pipe(fd);
 
-	/* Fork monitor and idle process */
 	pid = fork();
 
 	/* If child process, this is the idle process */
@@ -209,98 +423,330 @@ int main() {
 
 		}
 	
-	/* Else this is parent process, this is scheduler */
-	} else {
+	}
 
-		/* Initiate gui and setup signal handler for terminal resize*/
-		init_ncurses();
-		setup_winch_handler();
+	/* Setup idle process */
+	proc = pnode_create(pid, "idle");
+	proc->start = proc_starttime(pid);
+	proc_track(proc);
+	
+	close(fd[1]);
+	out_attach(proc, fd[0], fd[0]);
 
-		/* Setup clock interrupt handler */
-		setup_clock_int();
+	return proc;
 
-		/* Set flags for non blocking read call on pipe */
-		int flags = fcntl(fd[0], F_GETFL, 0);
-		fcntl(fd[0], F_SETFL, flags | O_NONBLOCK);
+}
 
-		/* Setup idle process */
-		idle_proc = pnode_create(pid, "idle");
-		
-		running_pid = pid;
+/*
+ * idle_wait
+ *
+ * Tickless idle. With nothing to run the clock is stopped, so instead of
+ * polling the keyboard every tenth of a second, sleeps until a key is hit,
+ * a process writes output or an event fires. Still wakes every second if metrics, pressure
+ * or counters have to be looked after, and when archived output is due.
+ *
+ */
 
-		next(0);	
+void idle_wait() {
 
-		int ch, count;
+	struct pollfd fds[3] = {
+		{ STDIN_FILENO, POLLIN, 0 },
+		{ out_pollfd(), POLLIN, 0 },
+		{ event_pollfd(), POLLIN, 0 }
+	};
+	int ms = metrics_enabled() || pressure_enabled() || perf_enabled() ? 1000 : -1;
+	int due = arch_timeout();
 
-		/* Enter main loop */
-		while (1) {
-			
-			/* Poll to see if there is data to be read in the pipe */
-			if((count = read(fd[0], buffer, 1024)) > 0) {
-				char message[1024];
-				strcpy(message, buffer);
-				log_add_line(message);
-			}
-			 
-			keypad(stdscr, true);
-
-			/* Poll to see if there is a character waiting in the buffer */
-			ch = getch();
-
-			switch (ch) {
-			
-				/* If no character in buffer */
-				case ERR: 
-				case 255:		
-				case KEY_LEFT:
-				case KEY_RIGHT:
-
-					break;
-
-				/* On key up, show previous command in history */
-				case KEY_UP:
-
-					history_get_prev();
-					break;
-
-				/* On key down, show next command in history */
-				case KEY_DOWN:
-
-					history_get_next();
-					break;
-
-				/* If character is backspace */
-				case 7:
-				//case 127:
-				//case KEY_DC:
-				case KEY_BACKSPACE:
-		
-					if (comm_ptr > 0) comm[--comm_ptr] = '\0';
-					break;
-
-				/* If character is enter, parse command and execute */
-				case '\n':
-				case KEY_ENTER:
-					if (strlen(comm)) exec_command();
-					break;
-
-				/* Else add character to buffer if buffer isnt full */
-				default:
-					if (comm_ptr < (sizeof(comm) - 1) &&
-							ch >= 32 && ch <= 126)
-						comm[comm_ptr++] = (char)ch;
-			
-			} 
+	if (head) return;
+
+	/* Nothing changes while asleep, last snapshot must be current */
+	state_flush();
+	spage_flush();
+
+	/* Block being archived is handed over in time */
+	if (due != -1 && (ms == -1 || due < ms)) ms = due;
+
+	/* Negative descriptors are ignored. Clock interrupts while asleep */
+	clock_allow();
+	poll(fds, 3, ms);
+	clock_hold();
+
+}
+
+/*
+ * Main program
+ *
+ */
+
+int main(int argc, char **argv) {
+
+	/* Init variables */
+	char *simfile = NULL, *statefile = NULL, *spagename = NULL;
+	int opt, idle_fork = 0, epoll_only = 0, pool = 0, rt_cpu = -1;
+
+	/* Parse options */
+	while ((opt = getopt(argc, argv, "aA:b:Egil:L:m:p:Pr:R:s:S:t:w:x:z:")) != -1) {
+
+		switch (opt) {
+
+			case 'r':
+				sim_record_open(optarg);
+				break;
+
+			case 'a':
+				topo_auto = 1;
+				break;
+
+			case 'A':
+				if (arch_init(optarg)) {
+
+					fprintf(stderr, "%s\n", errstr);
+					exit(-1);
+
+				}
+				break;
+
+			case 'b':
+				out_default_budget = atol(optarg);
+				break;
+
+			case 'E':
+				epoll_only = 1;
+				break;
+
+			case 'g':
+				green_mode = 1;
+				break;
+
+			case 'i':
+				idle_fork = 1;
+				break;
+
+			case 'l':
+				if (limit_init(optarg)) {
+
+					fprintf(stderr, "Invalid limits \"%s\"\n", optarg);
+					exit(-1);
+
+				}
+				break;
+
+			case 'L':
+				plog_init(optarg);
+				break;
+
+			case 'm':
+				metrics_open(optarg);
+				break;
+
+			case 'p':
+				if (pressure_init(optarg)) {
+
+					fprintf(stderr, "Invalid pressure thresholds \"%s\"\n", optarg);
+					exit(-1);
+
+				}
+				break;
+
+			case 'P':
+				perf_init();
+				break;
+
+			case 'R':
+				rt_cpu = atoi(optarg);
+				break;
+
+			case 's':
+				simfile = optarg;
+				break;
+
+			case 'S':
+				statefile = optarg;
+				break;
+
+			case 't':
+				if (trig_load(optarg)) {
+
+					fprintf(stderr, "%s\n", errstr);
+					exit(-1);
+
+				}
+				break;
+
+			case 'w':
+				if (cosched_init(optarg)) {
+
+					fprintf(stderr, "Invalid width \"%s\", 1 to %d\n", optarg, COSCHED_MAX);
+					exit(-1);
+
+				}
+				break;
+
+			case 'x':
+				spagename = optarg;
+				break;
+
+			case 'z':
+				pool = atoi(optarg);
+				break;
+
+			default:
+				fprintf(stderr, "Usage: %s [-a] [-A dir[,size[,age]]] [-b bytes] [-E] [-g] [-i] [-l limits] [-L logdir] [-m metricsfile] [-p thresholds] [-P] [-r tracefile] [-R cpu] [-s tracefile] [-S statefile] [-t triggerfile] [-w width[,rr]] [-x name] [-z workers]\n",
+						argv[0]);
+				exit(-1);
+
+		}
+
+	}
+
+	/* Simulation runs headless, no processes are forked */
+	if (simfile) return sim_run(simfile) ? -1 : 0;
+
+	/* Read cpus of every node */
+	topo_init();
+
+	/* Pick how output pipes are drained */
+	out_init(epoll_only);
+
+	/* Read snapshot left by previous scheduler */
+	if (statefile) state_open(statefile);
+
+	/* Publish status page for readers on the host */
+	if (spagename && spage_open(spagename)) {
+
+		fprintf(stderr, "%s\n", errstr);
+		exit(-1);
+
+	}
+
+	/* Set cpu aside before any helper is forked, so they stay off it */
+	if (rt_cpu != -1 && rt_reserve(rt_cpu)) {
+
+		fprintf(stderr, "%s\n", errstr);
+		exit(-1);
+
+	}
+
+	/* Start prefork pool while the scheduler is still small */
+	if (pool && zygote_init(pool)) {
+
+		fprintf(stderr, "%s\n", errstr);
+		exit(-1);
+
+	}
+
+	/* Fork idle process if asked for, before ncurses is started */
+	if (idle_fork) idle_proc = spawn_idle();
+
+	/* Move to reserved cpu once every helper is forked */
+	if (rt_cpu != -1 && rt_init()) {
+
+		fprintf(stderr, "%s\n", errstr);
+		exit(-1);
+
+	}
+
+	/* Initiate gui and setup signal handler for terminal resize*/
+	init_ncurses();
+	setup_winch_handler();
+
+	/* Setup clock interrupt handler */
+	setup_clock_int();
+
+	/* Take back processes of previous scheduler */
+	if (statefile) state_adopt();
+	
+	next(0);	
+
+	int ch;
+
+	/* Enter main loop */
+	while (1) {
+
+		/* Sleep while there is nothing to run */
+		idle_wait();
 		
-			/* Update screen */
-			update_screen();
+		/* Read whatever processes wrote to their pipes */
+		out_drain();
+
+		/* Sweep for children that exited without a pidfd telling */
+		reap_processes();
+
+		/* Wake processes whose event fired, take those gone off the queues */
+		event_poll();
+
+		/* Let green tasks that run have their turn */
+		green_run();
+
+		/* Act on patterns found in output */
+		trig_run();
+		 
+		keypad(stdscr, true);
+
+		/* Poll to see if there is a character waiting in the buffer. Clock
+		 * interrupts in the meantime */
+		clock_allow();
+		ch = getch();
+		clock_hold();
 
-		} /* End main loop */
+		switch (ch) {
 		
-		/* Finish ncurses */
-		end_ncurses();
+			/* If no character in buffer */
+			case ERR: 
+			case 255:		
+			case KEY_LEFT:
+			case KEY_RIGHT:
 
-	}
+				break;
+
+			/* On key up, show previous command in history */
+			case KEY_UP:
+
+				history_get_prev();
+				break;
+
+			/* On key down, show next command in history */
+			case KEY_DOWN:
+
+				history_get_next();
+				break;
+
+			/* If character is backspace */
+			case 7:
+			//case 127:
+			//case KEY_DC:
+			case KEY_BACKSPACE:
+	
+				if (comm_ptr > 0) comm[--comm_ptr] = '\0';
+				break;
+
+			/* If character is enter, parse command and execute */
+			case '\n':
+			case KEY_ENTER:
+				if (strlen(comm)) exec_command();
+				break;
+
+			/* Else add character to buffer if buffer isnt full */
+			default:
+				if (comm_ptr < (sizeof(comm) - 1) &&
+						ch >= 32 && ch <= 126)
+					comm[comm_ptr++] = (char)ch;
+		
+		} 
+	
+		/* Update screen and export metrics */
+		update_screen();
+		metrics_write();
+		state_write();
+		spage_write();
+		pressure_check();
+		perf_sample();
+		arch_tick();
+
+	} /* End main loop */
+	
+	/* Finish ncurses */
+	end_ncurses();
 
 	return 0;
 }
@@ -0,0 +1,768 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	sim
+ *
+ * @Description: Simulation backend. Each simulated process gets a total amount
+ * 		of cpu work and alternates between cpu bursts and io waits, all
+ * 		drawn from exponential distributions around configurable means.
+ * 		The virtual clock jumps straight from one event to the next, so a
+ * 		trace runs as fast as the scheduling code allows.
+ *
+ * 		A trace is a text file with one command per line, prefixed by
+ * 		the virtual time in milliseconds at which it is issued:
+ *
+ * 			0	seed 42
+ * 			0	burst 20 50
+ * 			0	spawn worker 1000
+ * 			1500	block 105
+ *
+ * 		Besides the regular commands, a trace understands:
+ *
+ * 			spawn <name> [count]	Spawns count processes at once
+ * 			seed <n>		Seeds the random generator
+ * 			burst <cpu> <io>	Mean cpu and io burst in ms
+ * 			work <ms>		Mean total cpu work per process
+ * 			quantum <ms>		Length of a time slice in ms
+ * 			width <n>[,rr]		Processes run at once, see
+ * 						cosched.h
+ * 			mix <percent> [factor]	Share of memory bound
+ * 						processes spawned from now
+ *
+ * 		as well as prio, wait, hold and release, so priority inversion
+ * 		scenarios can be replayed.
+ *
+ * 		Processes running together compete for the cache. Each one
+ * 		has a memory intensity, 1 if memory bound and SIM_LIGHT
+ * 		otherwise, and progresses at 1 / (1 + factor * its intensity
+ * 		* the sum of the others') the speed it would alone. The
+ * 		report shows cpu time lost that way, and running the same
+ * 		trace with width 4 and 4,rr compares pairing to round robin.
+ *
+ * 		Traces recorded with -r tag spawn and exec lines with the real
+ * 		pid (=pid) so later commands can be mapped onto simulated pids.
+ *
+ */
+
+#include <limits.h>
+#include <strings.h>
+
+#include "sim.h"
+#include "proc.h"
+#include "prio.h"
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
+
+/* Memory intensity of a process that is not memory bound */
+#define SIM_LIGHT	0.1
+
+/* Cpu time in ms small enough to be rounding */
+#define SIM_EPSILON	1e-6
+
+/* Set while running a trace, makes proc functions use the models */
+int sim_mode = 0;
+
+/* Simulated process. Indexed by pid - SIM_PID_BASE */
+typedef struct simtask {
+	pnode	*node;
+	double	work;		/* Cpu time left before process exits, alone */
+	double	burst;		/* Cpu time left in current burst, alone */
+	double	mem;		/* Memory intensity */
+	long	arrival;
+	long	first_run;
+	long	cpu;
+	long	io;
+	int	io_wait;
+} simtask;
+
+static simtask *tasks = NULL;
+static int ntasks = 0, maxtasks = 0;
+
+/* Pending io completions, min heap on wake time */
+typedef struct simwake {
+	long	wake;
+	int	pid;
+} simwake;
+
+static simwake *heap = NULL;
+static int nheap = 0, maxheap = 0;
+
+/* Virtual clock and model parameters, all in ms */
+static long vnow = 0, deadline = 0, quantum = QUANTUM * 1000;
+static long cpu_mean = 20, io_mean = 50, work_mean = 500;
+static double mix = 0, contention = 1;
+static unsigned long long seed = 88172645463325252ULL;
+
+/* Recording */
+static FILE *rec = NULL;
+static struct timespec rec_start;
+
+/* Recorded pid to simulated pid map */
+static int *map_from = NULL, *map_to = NULL;
+static int nmap = 0, maxmap = 0;
+
+/* Report counters */
+static long done = 0, busy = 0, sum_turnaround = 0, sum_response = 0, sum_wait = 0;
+static double lost = 0;
+
+/*
+ * sim_rand
+ *
+ * Returns a uniform double in [0, 1). xorshift64*, so a given seed always
+ * replays the same way.
+ *
+ */
+
+static double sim_rand() {
+
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+
+	return ((seed * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+
+}
+
+/*
+ * sim_exp
+ *
+ * Returns an exponentially distributed duration around mean, at least 1 ms.
+ *
+ */
+
+static long sim_exp(long mean) {
+
+	double u = sim_rand();
+	long v;
+
+	if (u <= 0) u = 1e-12;
+	v = (long)(-mean * log(u));
+
+	return v < 1 ? 1 : v;
+
+}
+
+/*
+ * sim_burst
+ *
+ * Draws next cpu burst for a task. Burst never outlasts remaining work.
+ *
+ */
+
+static double sim_burst(simtask *st) {
+
+	long b = sim_exp(cpu_mean);
+
+	return b < st->work ? b : st->work;
+
+}
+
+/*
+ * sim_task
+ *
+ * Returns simulated task for a pid or NULL if there is none.
+ *
+ */
+
+static simtask* sim_task(int pid) {
+
+	int i = pid - SIM_PID_BASE;
+
+	if (i < 0 || i >= ntasks || !tasks[i].node) return NULL;
+
+	return &tasks[i];
+
+}
+
+/*
+ * sim_heap_push / sim_heap_pop
+ *
+ * Maintain io completion heap.
+ *
+ */
+
+static void sim_heap_push(long wake, int pid) {
+
+	int i = nheap++;
+
+	if (nheap > maxheap) {
+
+		maxheap = maxheap ? maxheap * 2 : 1024;
+		heap = realloc(heap, maxheap * sizeof(simwake));
+
+	}
+
+	/* Sift up */
+	while (i && heap[(i - 1) / 2].wake > wake) {
+
+		heap[i] = heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+
+	}
+
+	heap[i].wake = wake;
+	heap[i].pid = pid;
+
+}
+
+static simwake sim_heap_pop() {
+
+	simwake top = heap[0], last = heap[--nheap];
+	int i = 0, c;
+
+	/* Sift down */
+	while ((c = 2 * i + 1) < nheap) {
+
+		if (c + 1 < nheap && heap[c + 1].wake < heap[c].wake) c++;
+		if (heap[c].wake >= last.wake) break;
+
+		heap[i] = heap[c];
+		i = c;
+
+	}
+
+	if (nheap) heap[i] = last;
+
+	return top;
+
+}
+
+/*
+ * sim_spawn
+ *
+ * Creates a simulated process and adds it to the ready queue. Returns pid.
+ *
+ */
+
+int sim_spawn(char *name) {
+
+	simtask *st;
+
+	/* Grow task table if needed */
+	if (ntasks == maxtasks) {
+
+		maxtasks = maxtasks ? maxtasks * 2 : 1024;
+		tasks = realloc(tasks, maxtasks * sizeof(simtask));
+
+	}
+
+	st = &tasks[ntasks];
+	memset(st, 0, sizeof(simtask));
+
+	st->work = sim_exp(work_mean);
+	st->burst = sim_burst(st);
+	st->arrival = vnow;
+	st->first_run = -1;
+	st->mem = mix > 0 && sim_rand() * 100 < mix ? 1 : SIM_LIGHT;
+	st->node = pnode_create(SIM_PID_BASE + ntasks, name);
+
+	ntasks++;
+
+	pnode_add_ready(st->node);
+
+	return st->node->pid;
+
+}
+
+/*
+ * sim_load
+ *
+ * Returns memory intensity of simulated process, what co-scheduling knows
+ * from cache misses otherwise.
+ *
+ */
+
+double sim_load(pnode *proc) {
+
+	simtask *st = sim_task(proc->pid);
+
+	return st ? st->mem : 0;
+
+}
+
+/*
+ * sim_running
+ *
+ * Fills run with the running task and its companions, and rate with the
+ * speed each progresses at given the cache contention between them.
+ * Returns their number.
+ *
+ */
+
+static int sim_running(simtask **run, double *rate) {
+
+	pnode *co[COSCHED_MAX];
+	double sum = 0;
+	int n = 0, nco, i;
+
+	if (running_proc && (run[n] = sim_task(running_proc->pid))) n++;
+
+	nco = cosched_running(co);
+
+	for (i = 0; i < nco; i++)
+		if ((run[n] = sim_task(co[i]->pid))) n++;
+
+	for (i = 0; i < n; i++) sum += run[i]->mem;
+
+	for (i = 0; i < n; i++)
+		rate[i] = 1 / (1 + contention * run[i]->mem * (sum - run[i]->mem));
+
+	return n;
+
+}
+
+/*
+ * sim_reset_clock
+ *
+ * Restarts quantum on virtual clock.
+ *
+ */
+
+void sim_reset_clock() {
+
+	deadline = vnow + quantum;
+
+}
+
+/*
+ * sim_record_open
+ *
+ * Opens trace file to record commands into. Exits on failure.
+ *
+ */
+
+void sim_record_open(char *path) {
+
+	if ((rec = fopen(path, "w")) == NULL) {
+
+		fprintf(stderr, "ERROR: Could not open trace file '%s'.\n", path);
+		exit(-1);
+
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &rec_start);
+
+}
+
+/*
+ * sim_record
+ *
+ * Appends command line to trace being recorded, if any. Tags line with pid
+ * if command created a process.
+ *
+ */
+
+void sim_record(char *line, int pid) {
+
+	struct timespec now;
+	long ms;
+
+	if (!rec) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (now.tv_sec - rec_start.tv_sec) * 1000 +
+		(now.tv_nsec - rec_start.tv_nsec) / 1000000;
+
+	fprintf(rec, "%ld\t%s", ms, line);
+	if (pid > 0) fprintf(rec, " =%d", pid);
+	fprintf(rec, "\n");
+
+	fflush(rec);
+
+}
+
+/*
+ * sim_map
+ *
+ * Maps a pid from the trace onto a simulated pid. Unmapped pids are returned
+ * unchanged so hand written traces can use simulated pids directly.
+ *
+ */
+
+static int sim_map(int from) {
+
+	int i;
+
+	for (i = 0; i < nmap; i++)
+		if (map_from[i] == from) return map_to[i];
+
+	return from;
+
+}
+
+static void sim_map_add(int from, int to) {
+
+	if (nmap == maxmap) {
+
+		maxmap = maxmap ? maxmap * 2 : 64;
+		map_from = realloc(map_from, maxmap * sizeof(int));
+		map_to = realloc(map_to, maxmap * sizeof(int));
+
+	}
+
+	map_from[nmap] = from;
+	map_to[nmap++] = to;
+
+}
+
+/*
+ * sim_retire
+ *
+ * Process finished its work. Account for it and remove it.
+ *
+ */
+
+static void sim_retire(simtask *st) {
+
+	long turnaround = vnow - st->arrival;
+
+	sum_turnaround += turnaround;
+	sum_response += st->first_run - st->arrival;
+	sum_wait += turnaround - st->cpu - st->io;
+	done++;
+
+	kill_node(st->node);
+	st->node = NULL;
+
+}
+
+/*
+ * sim_command
+ *
+ * Executes one trace command. Returns 0 when trace asks to quit, 1 otherwise.
+ *
+ */
+
+static int sim_command(char *line) {
+
+	char *argv[8], *save, *tok;
+	int argc = 0, recpid = 0, i;
+	simtask *st;
+
+	/* Split line, pull out recorded pid tag */
+	for (tok = strtok_r(line, " \t", &save); tok && argc < 8; 
+			tok = strtok_r(NULL, " \t", &save)) {
+		
+		if (tok[0] == '=') recpid = atoi(tok + 1);
+		else argv[argc++] = tok;
+
+	}
+
+	if (!argc) return 1;
+
+	if (!strcasecmp(argv[0], "spawn") || !strcasecmp(argv[0], "exec")) {
+
+		int count = argc > 2 && !strcasecmp(argv[0], "spawn") ? atoi(argv[2]) : 1;
+		int newpid = 0;
+
+		if (argc < 2) {
+
+			sprintf(errstr, "ERROR: Missing process name.");
+			return 1;
+
+		}
+
+		for (i = 0; i < count; i++) newpid = sim_spawn(argv[1]);
+
+		if (recpid && count == 1) sim_map_add(recpid, newpid);
+
+	} else if (!strcasecmp(argv[0], "kill") || !strcasecmp(argv[0], "block") ||
+			!strcasecmp(argv[0], "run")) {
+
+		if (argc < 2 || !(st = sim_task(sim_map(atoi(argv[1]))))) {
+		
+			sprintf(errstr, "ERROR: Process %s not found.", argc < 2 ? "" : argv[1]);
+			return 1;
+
+		}
+
+		if (!strcasecmp(argv[0], "kill")) {
+			
+			kill_node(st->node);
+			st->node = NULL;
+
+		} else if (!strcasecmp(argv[0], "block"))
+			block_node(st->node);
+
+		/* Released before its io completed, start a fresh burst */
+		else {
+
+			run_node(st->node);
+
+			if (st->io_wait) {
+
+				st->io_wait = 0;
+				st->burst = sim_burst(st);
+
+			}
+
+		}
+
+	/* Priorities and waits, pid arguments mapped */
+	} else if ((!strcasecmp(argv[0], "prio") || !strcasecmp(argv[0], "wait") ||
+			!strcasecmp(argv[0], "hold") || !strcasecmp(argv[0], "release")) && argc > 2) {
+
+		pnode *proc = pnode_get_node_by_pid(sim_map(atoi(argv[1]))), *on;
+
+		if (!proc) {
+
+			sprintf(errstr, "ERROR: Process %s not found.", argv[1]);
+			return 1;
+
+		}
+
+		if (!strcasecmp(argv[0], "prio")) {
+
+			int prio = atoi(argv[2]);
+			prio_set(proc, prio < 0 ? 0 : prio >= PRIO_LEVELS ? PRIO_LEVELS - 1 : prio);
+
+		}
+
+		else if (!strcasecmp(argv[0], "hold")) prio_hold(proc, argv[2]);
+		else if (!strcasecmp(argv[0], "release")) prio_release(proc, argv[2]);
+
+		else if ((on = pnode_get_node_by_pid(sim_map(atoi(argv[2])))))
+			prio_wait(proc, on);
+
+		else
+			sprintf(errstr, "ERROR: Process %s not found.", argv[2]);
+
+	} else if (!strcasecmp(argv[0], "seed") && argc > 1) 
+		seed = strtoull(argv[1], NULL, 10) | 1;
+
+	else if (!strcasecmp(argv[0], "burst") && argc > 2) {
+		
+		cpu_mean = atol(argv[1]);
+		io_mean = atol(argv[2]);
+
+	} else if (!strcasecmp(argv[0], "work") && argc > 1)
+		work_mean = atol(argv[1]);
+
+	else if (!strcasecmp(argv[0], "quantum") && argc > 1)
+		quantum = atol(argv[1]);
+
+	else if (!strcasecmp(argv[0], "width") && argc > 1) {
+
+		if (cosched_init(argv[1]))
+			sprintf(errstr, "ERROR: Invalid width \"%s\", 1 to %d.", argv[1], COSCHED_MAX);
+
+	} else if (!strcasecmp(argv[0], "mix") && argc > 1) {
+
+		mix = atof(argv[1]);
+		if (argc > 2) contention = atof(argv[2]);
+
+	}
+
+	else if (!strcasecmp(argv[0], "quit"))
+		return 0;
+
+	/* Interactive only commands are ignored */
+	else if (strcasecmp(argv[0], "help"))
+		sprintf(errstr, "ERROR: \"%s\" is not a valid command.", argv[0]);
+
+	return 1;
+
+}
+
+/*
+ * sim_next_line
+ *
+ * Reads next trace command. Returns 1 if a command was read, 0 at end of file.
+ *
+ */
+
+static int sim_next_line(FILE *trace, int *lineno, long *tick, char *line, int size) {
+
+	char *p;
+
+	while (fgets(line, size, trace)) {
+
+		(*lineno)++;
+
+		line[strcspn(line, "\r\n")] = 0;
+
+		/* Skip blank lines and comments */
+		for (p = line; *p == ' ' || *p == '\t'; p++);
+		if (!*p || *p == '#') continue;
+
+		*tick = strtol(p, &p, 10);
+
+		while (*p == ' ' || *p == '\t') p++;
+		memmove(line, p, strlen(p) + 1);
+
+		return 1;
+
+	}
+
+	return 0;
+
+}
+
+/*
+ * sim_run
+ *
+ * Replays trace under the virtual clock. Commands are issued at their time
+ * stamp, then the clock jumps to the earliest of the next command, the next
+ * io completion, the end of the running burst or the end of the quantum.
+ *
+ */
+
+int sim_run(char *path) {
+
+	FILE *trace;
+	char line[256];
+	long tick = 0, next_t, dt, t;
+	int lineno = 0, have, nrun, i;
+	struct timespec start, end;
+	simtask *run[COSCHED_MAX + 1];
+	double rate[COSCHED_MAX + 1];
+	char buf[64];
+
+	if ((trace = fopen(path, "r")) == NULL) {
+
+		fprintf(stderr, "ERROR: Could not open trace file '%s'.\n", path);
+		return -1;
+
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	sim_mode = 1;
+
+	/* Idle process is modelled too */
+	idle_proc = pnode_create(0, "idle");
+	dispatch(idle_proc);
+
+	have = sim_next_line(trace, &lineno, &tick, line, sizeof(line));
+
+	while (1) {
+
+		/* Issue commands that are due */
+		while (have && tick <= vnow) {
+
+			if (!sim_command(line)) have = 0;
+			else have = sim_next_line(trace, &lineno, &tick, line, sizeof(line));
+
+			if (errstr[0]) {
+
+				fprintf(stderr, "%s:%d: %s\n", path, lineno, errstr);
+				errstr[0] = 0;
+
+			}
+
+		}
+
+		nrun = sim_running(run, rate);
+
+		/* Find next event */
+		next_t = LONG_MAX;
+
+		if (have) next_t = tick;
+		if (nheap && heap[0].wake < next_t) next_t = heap[0].wake;
+
+		for (i = 0; i < nrun; i++) {
+
+			if (run[i]->first_run < 0) run[i]->first_run = vnow;
+
+			t = vnow + (long)ceil(run[i]->burst / rate[i]);
+			if (t < next_t) next_t = t;
+
+		}
+
+		if (nrun && deadline < next_t) next_t = deadline;
+
+		/* Nothing left to happen */
+		if (next_t == LONG_MAX) break;
+		if (next_t < vnow) next_t = vnow;
+
+		/* Advance clock */
+		dt = next_t - vnow;
+
+		for (i = 0; i < nrun; i++) {
+
+			run[i]->burst -= dt * rate[i];
+			run[i]->work -= dt * rate[i];
+			run[i]->cpu += dt;
+			busy += dt;
+			lost += dt * (1 - rate[i]);
+
+		}
+
+		vnow = next_t;
+
+		/* Complete io */
+		while (nheap && heap[0].wake <= vnow) {
+
+			simwake w = sim_heap_pop();
+			simtask *st = sim_task(w.pid);
+
+			if (st && st->io_wait) {
+
+				st->io_wait = 0;
+				st->burst = sim_burst(st);
+				run_node(st->node);
+
+			}
+
+		}
+
+		/* Bursts over, processes exit or wait for io. Left over fractions
+		 * of a ms are rounding */
+		for (i = 0; i < nrun; i++) {
+
+			if (!run[i]->node || run[i]->burst > SIM_EPSILON) continue;
+
+			if (run[i]->work <= SIM_EPSILON) 
+				sim_retire(run[i]);
+
+			else {
+
+				long io = sim_exp(io_mean);
+
+				run[i]->io += io;
+				run[i]->io_wait = 1;
+
+				sim_heap_push(vnow + io, run[i]->node->pid);
+				block_node(run[i]->node);
+
+			}
+
+		}
+
+		/* Quantum over */
+		if (nrun && vnow >= deadline) 
+			next(0);
+
+	}
+
+	fclose(trace);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Report */
+	printf("Trace:            %s\n", path);
+	printf("Processes:        %d spawned, %ld finished\n", ntasks, done);
+	printf("Virtual time:     %ld ms\n", vnow);
+	printf("Real time:        %.3f s\n", (end.tv_sec - start.tv_sec) + 
+			(end.tv_nsec - start.tv_nsec) / 1e9);
+	printf("Co-scheduling:    %s\n", cosched_status(buf, sizeof(buf)));
+	printf("Cpu utilization:  %.2f %%\n", vnow ? 100.0 * busy / vnow / cosched_width : 0.0);
+	printf("Lost to cache:    %.0f ms\n", lost);
+	printf("Context switches: %lu\n", ctx_switches);
+
+	if (done) {
+
+		printf("Throughput:       %.3f processes/s\n", 1000.0 * done / (vnow ? vnow : 1));
+		printf("Avg turnaround:   %.1f ms\n", (double)sum_turnaround / done);
+		printf("Avg response:     %.1f ms\n", (double)sum_response / done);
+		printf("Avg wait:         %.1f ms\n", (double)sum_wait / done);
+
+	}
+
+	if (done < ntasks)
+		printf("Never finished:   %ld (killed or left blocked)\n", ntasks - done);
+
+	return 0;
+
+}
@@ -0,0 +1,62 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	sim.h
+ *
+ * @Description: Simulation backend. Processes are modelled as synthetic
+ * 		workloads alternating cpu and io bursts instead of being forked,
+ * 		and time is a virtual clock instead of alarm(). Command traces
+ * 		recorded with -r can be replayed with -s.
+ *
+ * @Constants:
+ *
+ * 	SIM_PID_BASE	First pid handed out to simulated processes
+ *
+ * @Functions:
+ *
+ * 	sim_spawn	Creates a simulated process and adds it to the
+ * 			ready queue. Returns its pid.
+ *
+ * 	sim_load	Returns memory intensity of a simulated process.
+ *
+ * 	sim_reset_clock	Restarts the quantum on the virtual clock.
+ *
+ * 	sim_record_open	Opens a trace file to record commands into.
+ *
+ * 	sim_record	Appends a command to the trace being recorded.
+ *
+ * 	sim_run		Replays a trace file under the virtual clock and
+ * 			prints a report. Returns 0 on success.
+ *
+ */
+
+#define __sim_h_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define SIM_PID_BASE	100
+
+extern int sim_mode;
+
+/* Clock interrupt handler, in sched.c */
+void next(int code);
+
+int sim_spawn(char *name);
+
+double sim_load(pnode *proc);
+
+void sim_reset_clock();
+
+void sim_record_open(char *path);
+
+void sim_record(char *line, int pid);
+
+int sim_run(char *path);
+
@@ -0,0 +1,301 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	spage
+ *
+ * @Description: Shared memory status page for external readers
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "spage.h"
+#include "proc.h"
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+#ifndef __perf_h_
+	#include "perf.h"
+#endif
+
+#ifndef __cosched_h_
+	#include "cosched.h"
+#endif
+
+/* Current mapping */
+static char pname[64];
+static int pfd = -1;
+static sphdr *page = NULL;
+static size_t psize = 0;
+static struct timespec last_pub;
+
+/*
+ * spage_size
+ *
+ * Returns size of a page holding cap records.
+ *
+ */
+
+static size_t spage_size(int cap) {
+
+	return sizeof(sphdr) + cap * sizeof(sprec);
+
+}
+
+/*
+ * spage_map
+ *
+ * Grows page to cap records and maps it again. Returns 0 on success.
+ *
+ */
+
+static int spage_map(int cap) {
+
+	void *map;
+
+	if (ftruncate(pfd, spage_size(cap)) == -1) return -1;
+
+	map = mmap(NULL, spage_size(cap), PROT_READ | PROT_WRITE, MAP_SHARED, pfd, 0);
+
+	if (map == MAP_FAILED) return -1;
+
+	if (page) munmap(page, psize);
+
+	page = map;
+	psize = spage_size(cap);
+
+	return 0;
+
+}
+
+/*
+ * spage_owner
+ *
+ * Returns pid of the live scheduler publishing an existing page, 0 if it is
+ * gone or the page is no status page.
+ *
+ */
+
+static int spage_owner(int fd) {
+
+	sphdr h;
+
+	if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, SPAGE_MAGIC, 8) ||
+			h.owner <= 0 || (kill(h.owner, 0) && errno != EPERM))
+		return 0;
+
+	return h.owner;
+
+}
+
+/*
+ * spage_open
+ *
+ * Creates page /name, readable by everyone. A page left by a scheduler that
+ * is gone is taken over, one still published is not. Returns 0 on success,
+ * -1 with error set otherwise.
+ *
+ */
+
+int spage_open(char *name) {
+
+	int owner;
+
+	snprintf(pname, sizeof(pname), "/%s", name[0] == '/' ? name + 1 : name);
+
+	if ((pfd = shm_open(pname, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) == -1 &&
+			errno == EEXIST && (pfd = shm_open(pname, O_RDWR | O_CLOEXEC, 0)) != -1 &&
+			(owner = spage_owner(pfd))) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: Status page '%s' is published by %d.",
+				pname, owner);
+		close(pfd);
+		pfd = -1;
+		return -1;
+
+	}
+
+	if (pfd == -1) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: Could not create status page '%s'.", pname);
+		return -1;
+
+	}
+
+	/* Whatever the umask, readers only need to read */
+	fchmod(pfd, 0644);
+
+	if (spage_map(64) == -1) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: Could not map status page '%s'.", pname);
+		shm_unlink(pname);
+		return -1;
+
+	}
+
+	memset(page, 0, psize);
+
+	page->owner = getpid();
+	page->cap = 64;
+
+	memcpy(page->magic, SPAGE_MAGIC, 8);
+
+	return 0;
+
+}
+
+/*
+ * spage_rec
+ *
+ * Fills a page record from a node.
+ *
+ */
+
+static void spage_rec(sprec *rec, pnode *proc) {
+
+	rec->pid = proc->pid;
+	rec->state = proc->state;
+	rec->cause = proc->cause;
+	rec->prio = proc->prio;
+	rec->eprio = proc->eprio;
+	rec->co = proc->co;
+	rec->green = proc->green != NULL;
+	rec->ipc = proc->perf ? proc->perf->ipc : -1;
+	rec->miss = proc->perf ? proc->perf->miss : -1;
+
+	strncpy(rec->name, proc->name, sizeof(rec->name) - 1);
+	rec->name[sizeof(rec->name) - 1] = 0;
+
+}
+
+/*
+ * spage_write
+ *
+ * Publishes process table, queue lengths and counters, at most once every
+ * SPAGE_PERIOD ms. Page is grown before seq goes odd, readers only ever
+ * find it bigger than they mapped it.
+ *
+ */
+
+void spage_write() {
+
+	struct timespec now;
+	sprec *rec;
+	pnode *tmp;
+	int n = 0;
+
+	if (!page) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if ((now.tv_sec - last_pub.tv_sec) * 1000 +
+			(now.tv_nsec - last_pub.tv_nsec) / 1000000 < SPAGE_PERIOD) return;
+
+	last_pub = now;
+
+	/* Grow page if process table outgrew it */
+	if (nready + nblocked + 1 > page->cap) {
+
+		if (spage_map((nready + nblocked + 1) * 2) == -1) return;
+
+	}
+
+	rec = (sprec *)((char *)page + sizeof(sphdr));
+
+	page->seq++;
+	__sync_synchronize();
+
+	page->cap = (psize - sizeof(sphdr)) / sizeof(sprec);
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	page->stamp = now.tv_sec * 1000000000LL + now.tv_nsec;
+
+	page->quantum = QUANTUM;
+	page->width = cosched_width;
+	page->nready = nready;
+	page->nblocked = nblocked;
+	memcpy(page->nready_prio, nready_prio, sizeof(page->nready_prio));
+
+	page->spawns = mstat.spawns;
+	page->kills = mstat.kills;
+	page->ticks = mstat.ticks;
+	page->pipe_bytes = mstat.pipe_bytes;
+	page->out_throttled = mstat.out_throttled;
+	page->triggers = mstat.triggers;
+	page->green_switches = mstat.green_switches;
+	page->jitter_ns_max = mstat.jitter_ns_max;
+
+	/* Running process is the head, or idle if the queue is empty. Nodes
+	 * don't say so themselves, the table shows it the same way */
+	if (idle_proc) {
+
+		spage_rec(&rec[n], idle_proc);
+		if (!head) rec[n].state = RUNNING;
+		n++;
+
+	}
+
+	/* Ready queue, starting with running process. Its companions run too */
+	if (head) {
+
+		spage_rec(&rec[n], head);
+		rec[n++].state = RUNNING;
+
+		for (tmp = head->next; tmp && tmp != head; tmp = tmp->next) {
+
+			spage_rec(&rec[n], tmp);
+			if (tmp->co) rec[n].state = RUNNING;
+			n++;
+
+		}
+
+	}
+
+	for (tmp = blocked; tmp; tmp = tmp->next) spage_rec(&rec[n++], tmp);
+
+	page->count = n;
+
+	__sync_synchronize();
+	page->seq++;
+
+}
+
+/*
+ * spage_flush
+ *
+ * Publishes regardless of when the last update was.
+ *
+ */
+
+void spage_flush() {
+
+	last_pub.tv_sec = 0;
+	last_pub.tv_nsec = 0;
+
+	spage_write();
+
+}
+
+/*
+ * spage_close
+ *
+ * Removes page. Readers still mapping it keep the last update.
+ *
+ */
+
+void spage_close() {
+
+	if (!page) return;
+
+	shm_unlink(pname);
+
+}
+
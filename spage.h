@@ -0,0 +1,93 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	spage.h
+ *
+ * @Description: Status page. With -x, the process table, queue lengths and
+ * 		counters are published into a POSIX shared memory object,
+ * 		/dev/shm/<name>, several times a second, for monitoring tools
+ * 		on the host to map read only instead of scraping the screen.
+ *
+ * 		The page is guarded by a seqlock: the scheduler bumps seq to
+ * 		an odd value before writing and back to even after. A reader
+ * 		copies the page out, and keeps it only if seq was even and
+ * 		unchanged across the copy, trying again otherwise. Readers
+ * 		never take a lock nor write anything, so any number of them
+ * 		cost the scheduler nothing and can't hold it up.
+ *
+ * 		The page grows when the table outgrows it. A reader whose
+ * 		mapping is smaller than cap records maps it again. It is
+ * 		removed when the scheduler quits. spstat is a reader.
+ *
+ * @Constants:
+ *
+ * 	SPAGE_MAGIC	Identifies a status page
+ *
+ * 	SPAGE_PERIOD	Minimum time between updates in ms
+ *
+ * @Functions:
+ *
+ * 	spage_open	Creates status page. Returns 0 on success, -1 with
+ * 			error set otherwise.
+ *
+ * 	spage_write	Publishes process table if the last update is older
+ * 			than SPAGE_PERIOD.
+ *
+ * 	spage_flush	Publishes now, before going to sleep.
+ *
+ * 	spage_close	Removes status page.
+ *
+ */
+
+#define __spage_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define SPAGE_MAGIC	"SCHEDSP1"
+#define SPAGE_PERIOD	100
+
+typedef struct sprec {
+	int		pid;
+	int		state;		/* READY, RUNNING or BLOCKED */
+	int		cause;		/* Why it is blocked */
+	int		prio;
+	int		eprio;
+	int		co;		/* Running alongside head */
+	int		green;		/* Green task */
+	int		pad;
+	double		ipc;		/* -1 if not counted */
+	double		miss;
+	char		name[32];
+} sprec;
+
+typedef struct sphdr {
+	char		magic[8];
+	unsigned int	seq;		/* Odd while the page is written */
+	int		owner;		/* Scheduler pid */
+	long long	stamp;		/* Time of update, ns since epoch */
+	int		quantum;	/* Seconds */
+	int		width;		/* Processes run per quantum */
+	int		nready;
+	int		nblocked;
+	int		nready_prio[PRIO_LEVELS];
+	unsigned long	spawns;
+	unsigned long	kills;
+	unsigned long	ticks;
+	unsigned long	pipe_bytes;
+	unsigned long	out_throttled;
+	unsigned long	triggers;
+	unsigned long	green_switches;
+	unsigned long	jitter_ns_max;
+	int		count;
+	int		cap;
+} sphdr;
+
+int spage_open(char *name);
+
+void spage_write();
+
+void spage_flush();
+
+void spage_close();
+
@@ -0,0 +1,273 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	spstat
+ *
+ * @Description: Reads the status page of a scheduler started with -x name.
+ * 		Maps it read only, takes a consistent copy under the seqlock and
+ * 		prints queue lengths, counters and the process table, once or
+ * 		every interval seconds. Also prints how long the copy took and
+ * 		how many times it had to be taken again because the scheduler
+ * 		was writing.
+ *
+ * 		Usage: spstat <name> [interval]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "spage.h"
+
+/* Tries at an odd seq between checks that the scheduler is alive */
+#define SPSTAT_SPIN	1000
+
+static int pfd;
+static char *map = NULL, *copy = NULL;
+static size_t msize = 0, csize = 0;
+
+/*
+ * now
+ *
+ * Returns time in ns, monotonic or since epoch.
+ *
+ */
+
+static long long now(clockid_t clk) {
+
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+}
+
+/*
+ * remap
+ *
+ * Maps the whole page again, after it grew. Returns 0 on success.
+ *
+ */
+
+static int remap() {
+
+	struct stat st;
+	void *m;
+
+	if (fstat(pfd, &st) || st.st_size < sizeof(sphdr)) return -1;
+
+	if ((m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, pfd, 0)) == MAP_FAILED) return -1;
+
+	if (map) munmap(map, msize);
+
+	map = m;
+	msize = st.st_size;
+
+	return 0;
+
+}
+
+/*
+ * snap
+ *
+ * Copies page out, again until seq was even and unchanged across the copy.
+ * Returns number of copies thrown away, -1 on error, -2 if the scheduler
+ * died while writing.
+ *
+ */
+
+static int snap() {
+
+	sphdr *h;
+	unsigned int s1, s2;
+	size_t need;
+	int retries = 0;
+
+	while (1) {
+
+		h = (sphdr *)map;
+
+		s1 = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+
+		/* Being written. A scheduler killed halfway leaves seq odd for
+		 * good, so every SPSTAT_SPIN tries make sure it is still there */
+		if (s1 & 1) {
+
+			if (++retries % SPSTAT_SPIN == 0 && kill(h->owner, 0) && errno == ESRCH)
+				return -2;
+
+			sched_yield();
+			continue;
+
+		}
+
+		need = sizeof(sphdr) + (size_t)h->cap * sizeof(sprec);
+
+		/* Page grew since it was mapped */
+		if (need > msize) {
+
+			if (remap()) return -1;
+			continue;
+
+		}
+
+		if (need > csize) {
+
+			free(copy);
+			copy = malloc(csize = need);
+
+		}
+
+		memcpy(copy, map, need);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = __atomic_load_n(&h->seq, __ATOMIC_RELAXED);
+
+		if (s1 == s2) return retries;
+
+		retries++;
+
+	}
+
+}
+
+/*
+ * state_label
+ *
+ * Returns state of record as the process table shows it.
+ *
+ */
+
+static char* state_label(sprec *r) {
+
+	if (r->state == RUNNING || r->co) return "RUNNING";
+	if (r->state == READY) return "READY";
+
+	return r->cause == BC_RSS ? "OVERMEM" :
+		r->cause == BC_PRESSURE ? "PRESSURE" :
+		r->cause == BC_WAIT ? "WAITING" :
+		r->cause == BC_EVENT ? "EVENT" :
+		r->cause == BC_TRIGGER ? "TRIGGER" : "BLOCKED";
+
+}
+
+/*
+ * show
+ *
+ * Prints copy of page.
+ *
+ */
+
+static void show(int retries, long long took) {
+
+	sphdr *h = (sphdr *)copy;
+	sprec *r = (sprec *)(copy + sizeof(sphdr));
+	char prio[16];
+	int i, alive = !kill(h->owner, 0) || errno == EPERM;
+
+	printf("sched %d%s, updated %.1f s ago\n", h->owner, alive ? "" : " (gone)",
+			(now(CLOCK_REALTIME) - h->stamp) / 1e9);
+
+	printf("quantum %d s, width %d, %d ready (", h->quantum, h->width, h->nready);
+
+	for (i = PRIO_LEVELS - 1; i >= 0; i--)
+		if (h->nready_prio[i]) printf(" prio %d: %d", i, h->nready_prio[i]);
+
+	printf(" ), %d blocked\n", h->nblocked);
+
+	printf("%lu spawns, %lu kills, %lu ticks, %lu bytes piped, %lu throttled, "
+			"%lu triggers, %lu green switches, worst jitter %lu us\n",
+			h->spawns, h->kills, h->ticks, h->pipe_bytes, h->out_throttled,
+			h->triggers, h->green_switches, h->jitter_ns_max / 1000);
+
+	printf("\n%8s  %-16s %-9s %4s %6s %6s\n", "PID", "NAME", "STATE", "PRIO", "IPC", "MISS");
+
+	for (i = 0; i < h->count && i < h->cap; i++) {
+
+		/* Inherited priority shows after the base one */
+		if (r[i].eprio != r[i].prio) snprintf(prio, sizeof(prio), "%d>%d", r[i].prio, r[i].eprio);
+		else snprintf(prio, sizeof(prio), "%d", r[i].prio);
+
+		printf("%8d  %-16.16s %-9s %4s", r[i].pid, r[i].name, state_label(&r[i]), prio);
+
+		if (r[i].ipc >= 0) printf(" %6.2f", r[i].ipc);
+		else printf(" %6s", "-");
+
+		if (r[i].miss >= 0) printf(" %5.0f%%", r[i].miss * 100);
+		else printf(" %6s", "-");
+
+		printf("%s\n", r[i].green ? "  green" : "");
+
+	}
+
+	printf("\ncopied in %.1f us, %d retries\n", took / 1e3, retries);
+
+}
+
+int main(int argc, char **argv) {
+
+	char name[256];
+	int interval = argc > 2 ? atoi(argv[2]) : 0, retries;
+	long long t;
+
+	if (argc < 2) {
+
+		fprintf(stderr, "Usage: %s <name> [interval]\n", argv[0]);
+		return -1;
+
+	}
+
+	snprintf(name, sizeof(name), "/%s", argv[1][0] == '/' ? argv[1] + 1 : argv[1]);
+
+	if ((pfd = shm_open(name, O_RDONLY, 0)) == -1 || remap() ||
+			memcmp(map, SPAGE_MAGIC, 8)) {
+
+		fprintf(stderr, "ERROR: No status page '%s'.\n", name);
+		return -1;
+
+	}
+
+	do {
+
+		t = now(CLOCK_MONOTONIC);
+
+		if ((retries = snap()) == -1) {
+
+			fprintf(stderr, "ERROR: Could not map status page '%s'.\n", name);
+			return -1;
+
+		}
+
+		if (retries == -2) {
+
+			fprintf(stderr, "ERROR: Scheduler %d died while writing status page '%s'.\n",
+					((sphdr *)map)->owner, name);
+			return -1;
+
+		}
+
+		show(retries, now(CLOCK_MONOTONIC) - t);
+
+		if (interval) {
+
+			printf("\n");
+			fflush(stdout);
+			sleep(interval);
+
+		}
+
+	} while (interval);
+
+	return 0;
+
+}
+
@@ -0,0 +1,366 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	state
+ *
+ * @Description: Persistent process table snapshots and warm restart
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "state.h"
+#include "proc.h"
+#include "output.h"
+#include "topo.h"
+#include "limit.h"
+
+/* Current mapping */
+static char *spath = NULL;
+static shdr *smap = NULL;
+static size_t ssize = 0;
+static unsigned long long self_start = 0;
+static struct timespec last_snap;
+
+/* Snapshot left by previous scheduler, consumed by state_adopt() */
+static srec *old = NULL;
+static int nold = 0;
+
+/*
+ * state_size
+ *
+ * Returns size of a state file holding cap records.
+ *
+ */
+
+static size_t state_size(int cap) {
+
+	return sizeof(shdr) + cap * sizeof(srec);
+
+}
+
+/*
+ * state_map
+ *
+ * (Re)maps state file with room for cap records. Returns 0 on success.
+ *
+ */
+
+static int state_map(int cap) {
+
+	int sfd;
+	void *map;
+
+	if ((sfd = open(spath, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) == -1) return -1;
+
+	if (ftruncate(sfd, state_size(cap)) == -1) {
+
+		close(sfd);
+		return -1;
+
+	}
+
+	map = mmap(NULL, state_size(cap), PROT_READ | PROT_WRITE, MAP_SHARED, sfd, 0);
+	close(sfd);
+
+	if (map == MAP_FAILED) return -1;
+
+	if (smap) munmap(smap, ssize);
+
+	smap = map;
+	ssize = state_size(cap);
+	smap->cap = cap;
+
+	return 0;
+
+}
+
+/*
+ * state_reattach
+ *
+ * Opens output pipe of adopted process through /proc/<pid>/fd. 
+ *
+ */
+
+static void state_reattach(pnode *proc, srec *rec) {
+
+	char path[64];
+	int r;
+
+	snprintf(path, sizeof(path), "/proc/%d/fd/%d", rec->pid, rec->cfd);
+
+	if ((r = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) == -1) return;
+
+	out_attach(proc, r, rec->cfd);
+	out_throttle(proc, rec->budget, rec->policy);
+
+}
+
+/*
+ * state_signal
+ *
+ * Signals adopted process through a pidfd, after checking start time again
+ * so the signal can't land on a process that reused the pid. Falls back on
+ * kill() if pidfds are not supported. Returns 0 on success.
+ *
+ */
+
+static int state_signal(srec *rec, int sig) {
+
+	int pfd = syscall(SYS_pidfd_open, rec->pid, 0), ret;
+
+	if (pfd == -1) 
+		return proc_starttime(rec->pid) == rec->start ? kill(rec->pid, sig) : -1;
+
+	ret = proc_starttime(rec->pid) == rec->start ?
+		syscall(SYS_pidfd_send_signal, pfd, sig, NULL, 0) : -1;
+
+	close(pfd);
+
+	return ret;
+
+}
+
+/*
+ * state_open
+ *
+ * Maps state file. Reads snapshot left by a dead scheduler, if any.
+ *
+ */
+
+void state_open(char *path) {
+
+	int sfd, i, torn = 0;
+	struct stat st;
+
+	spath = path;
+	self_start = proc_starttime(getpid());
+
+	if ((sfd = open(path, O_RDONLY | O_CREAT | O_CLOEXEC, 0600)) == -1) {
+
+		fprintf(stderr, "ERROR: Could not open state file '%s'.\n", path);
+		exit(-1);
+
+	}
+
+	/* Read previous snapshot */
+	if (!fstat(sfd, &st) && st.st_size >= sizeof(shdr)) {
+
+		shdr *h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, sfd, 0);
+
+		if (h != MAP_FAILED && !memcmp(h->magic, STATE_MAGIC, 8)) {
+
+			/* Never steal children from a live scheduler */
+			if (h->owner != getpid() && 
+					proc_starttime(h->owner) == h->owner_start) {
+
+				fprintf(stderr, "ERROR: State file '%s' is in use by pid %d.\n",
+						path, h->owner);
+				exit(-1);
+
+			}
+
+			/* Odd seq means the scheduler died halfway through a
+			 * snapshot, the table is torn and can't be trusted */
+			if (h->seq & 1) {
+
+				sprintf(errstr, "ERROR: Previous snapshot is torn, nothing adopted.");
+				torn = 1;
+
+			} else if (st.st_size >= state_size(h->count)) {
+
+				nold = h->count;
+				old = malloc(nold * sizeof(srec) + 1);
+				memcpy(old, (char *)h + sizeof(shdr), nold * sizeof(srec));
+
+				/* Idle record is not adopted, a new idle is forked */
+				for (i = 0; i < nold; i++)
+					if (old[i].pid == h->idle) old[i].state = -1;
+
+			}
+
+		}
+
+		if (h != MAP_FAILED) munmap(h, st.st_size);
+
+	}
+
+	close(sfd);
+
+	if (state_map(nold > 64 ? nold * 2 : 64) == -1) {
+
+		fprintf(stderr, "ERROR: Could not map state file '%s'.\n", path);
+		exit(-1);
+
+	}
+
+	/* Start over from an empty, even snapshot, or every later one would
+	 * read as torn too */
+	if (torn) {
+
+		smap->count = 0;
+		smap->seq = 0;
+
+	}
+
+}
+
+/*
+ * state_adopt
+ *
+ * Puts surviving children of previous scheduler back in queues, in the
+ * same order and state. Old idle process is killed.
+ *
+ */
+
+void state_adopt() {
+
+	int i, n = 0, total = 0;
+	pnode *proc;
+
+	for (i = 0; i < nold; i++) {
+
+		/* Old idle process */
+		if (old[i].state == -1) {
+
+			state_signal(&old[i], SIGKILL);
+			continue;
+
+		}
+
+		total++;
+
+		/* Stop it, skips processes that died or whose pid was reused */
+		if (state_signal(&old[i], SIGSTOP)) continue;
+
+		old[i].name[sizeof(old[i].name) - 1] = 0;
+
+		proc = pnode_create(old[i].pid, old[i].name);
+		proc->start = old[i].start;
+		proc_track(proc);
+
+		state_reattach(proc, &old[i]);
+		topo_adopt(proc, old[i].node);
+
+		proc->prio = proc->eprio = old[i].prio;
+
+		/* Waits are not kept, what was waited on may be gone */
+		proc->cause = old[i].cause == BC_WAIT || old[i].cause == BC_EVENT ? 
+				BC_USER : old[i].cause;
+		proc->rss_max = old[i].rss_max;
+		limit_rss_used |= proc->rss_max != 0;
+
+		if (old[i].state == BLOCKED) pnode_add_blocked(proc);
+		else pnode_add_ready(proc);
+
+		n++;
+
+	}
+
+	if (total) sprintf(errstr, "Adopted %d of %d processes from previous scheduler.", 
+			n, total);
+
+	free(old);
+	old = NULL;
+	nold = 0;
+
+}
+
+/*
+ * state_rec
+ *
+ * Fills a snapshot record from a node.
+ *
+ */
+
+static void state_rec(srec *rec, pnode *proc) {
+
+	rec->pid = proc->pid;
+	rec->state = proc->state;
+	rec->start = proc->start;
+	rec->cfd = proc->och ? proc->och->cfd : -1;
+	rec->budget = proc->och ? proc->och->budget : 0;
+	rec->policy = proc->och ? proc->och->policy : 0;
+	rec->node = topo_node(proc);
+	rec->cause = proc->cause;
+	rec->prio = proc->prio;
+	rec->rss_max = proc->rss_max;
+
+	strncpy(rec->name, proc->name, sizeof(rec->name) - 1);
+	rec->name[sizeof(rec->name) - 1] = 0;
+
+}
+
+/*
+ * state_write
+ *
+ * Takes snapshot of process table, at most once every STATE_PERIOD ms.
+ *
+ */
+
+void state_write() {
+
+	struct timespec now;
+	srec *rec;
+	pnode *tmp;
+	int n = 0;
+
+	if (!smap) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if ((now.tv_sec - last_snap.tv_sec) * 1000 + 
+			(now.tv_nsec - last_snap.tv_nsec) / 1000000 < STATE_PERIOD) return;
+
+	last_snap = now;
+
+	/* Grow file if process table outgrew it */
+	if (nready + nblocked + 1 > smap->cap && 
+			state_map((nready + nblocked + 1) * 2) == -1) return;
+
+	rec = (srec *)((char *)smap + sizeof(shdr));
+
+	smap->seq++;
+	__sync_synchronize();
+
+	memcpy(smap->magic, STATE_MAGIC, 8);
+	smap->owner = getpid();
+	smap->owner_start = self_start;
+	smap->idle = idle_proc ? idle_proc->pid : 0;
+	smap->quantum = QUANTUM;
+
+	if (idle_proc) state_rec(&rec[n++], idle_proc);
+
+	/* Ready queue, starting with running process */
+	if ((tmp = head)) 
+		do if (!tmp->green) state_rec(&rec[n++], tmp); while ((tmp = tmp->next) && tmp != head);
+
+	/* Blocked queue. Green tasks go with the scheduler, nothing to adopt */
+	for (tmp = blocked; tmp; tmp = tmp->next) if (!tmp->green) state_rec(&rec[n++], tmp);
+
+	smap->count = n;
+
+	__sync_synchronize();
+	smap->seq++;
+
+}
+
+/*
+ * state_flush
+ *
+ * Takes a snapshot regardless of when the last one was taken.
+ *
+ */
+
+void state_flush() {
+
+	last_snap.tv_sec = 0;
+	last_snap.tv_nsec = 0;
+
+	state_write();
+
+}
@@ -0,0 +1,84 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	state.h
+ *
+ * @Description: Persistent process table. The ready and blocked queues are
+ * 		copied into a memory mapped state file several times a second.
+ * 		The mapping is shared, so the snapshot survives the scheduler
+ * 		dying. A scheduler restarted on the same file re-adopts the
+ * 		children still alive, reattaches to their output pipe and carries
+ * 		on scheduling them instead of leaving them stopped forever.
+ *
+ * 		Children keep the read end of their output pipe open, so the
+ * 		pipe outlives the scheduler. The restarted scheduler opens it
+ * 		again through /proc/<pid>/fd/<n>.
+ *
+ * 		Children are matched by pid and start time, so a pid that was
+ * 		reused by an unrelated process is never adopted.
+ *
+ * @Constants:
+ *
+ * 	STATE_MAGIC	Identifies a state file
+ *
+ * 	STATE_PERIOD	Minimum time between snapshots in ms
+ *
+ * @Functions:
+ *
+ * 	state_open	Maps state file and reads snapshot left by a dead
+ * 			scheduler, if any.
+ *
+ * 	state_adopt	Puts children from previous snapshot back in the
+ * 			ready and blocked queues.
+ *
+ * 	state_write	Takes a snapshot of the process table if the last
+ * 			one is older than STATE_PERIOD.
+ *
+ * 	state_flush	Takes a snapshot now, before going to sleep.
+ *
+ */
+
+#define __state_h_
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define STATE_MAGIC	"SCHEDST5"
+#define STATE_PERIOD	100
+
+typedef struct srec {
+	int			pid;
+	int			state;
+	unsigned long long	start;
+	int			cfd;		/* Read end of output pipe in child */
+	int			policy;		/* Output budget and policy */
+	int			node;		/* NUMA node, -1 if unbound */
+	int			cause;		/* Why it is blocked */
+	int			prio;		/* Base priority */
+	long			rss_max;
+	long			budget;
+	char			name[32];
+} srec;
+
+typedef struct shdr {
+	char			magic[8];
+	unsigned int		seq;		/* Odd while a snapshot is written */
+	int			owner;		/* Scheduler pid and start time */
+	unsigned long long	owner_start;
+	int			idle;
+	int			quantum;
+	int			count;
+	int			cap;
+} shdr;
+
+void state_open(char *path);
+
+void state_adopt();
+
+void state_write();
+
+void state_flush();
+
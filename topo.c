@@ -0,0 +1,440 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	topo
+ *
+ * @Description: Cpu and NUMA placement
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "topo.h"
+
+struct placement {
+	cpu_set_t	cpus;
+	int		node;		/* -1 if cpus span several nodes */
+};
+
+/* For placements sent to another process */
+const int topo_place_size = sizeof(struct placement);
+
+typedef struct tnode_info {
+	cpu_set_t	cpus;
+	int		tasks;
+} tnode_info;
+
+/* Set with -a */
+int topo_auto = 0;
+
+int topo_nnodes = 0;
+static tnode_info nodes[TOPO_MAX_NODES];
+
+/*
+ * parse_cpulist
+ *
+ * Parses cpu list like 0-3,8,10-11. Returns 0 on success, -1 on error.
+ *
+ */
+
+static int parse_cpulist(char *str, cpu_set_t *set) {
+
+	char *p = str, *end;
+	long lo, hi;
+
+	CPU_ZERO(set);
+
+	while (*p && *p != '\n') {
+
+		lo = hi = strtol(p, &end, 10);
+		if (end == p || lo < 0) return -1;
+
+		if (*end == '-') {
+
+			p = end + 1;
+			hi = strtol(p, &end, 10);
+			if (end == p || hi < lo) return -1;
+
+		}
+
+		if (hi >= CPU_SETSIZE) return -1;
+
+		while (lo <= hi) CPU_SET(lo++, set);
+
+		if (*end == ',') end++;
+		else if (*end && *end != '\n') return -1;
+
+		p = end;
+
+	}
+
+	return CPU_COUNT(set) ? 0 : -1;
+
+}
+
+/*
+ * topo_init
+ *
+ * Reads nodes and their cpus from sysfs. Nodes without cpus, memory only,
+ * are left empty and never placed on. Without NUMA support, all cpus the
+ * scheduler may use form node 0.
+ *
+ */
+
+void topo_init() {
+
+	char path[64], buf[1024];
+	FILE *f;
+	int i;
+
+	for (i = 0, topo_nnodes = 0; i < TOPO_MAX_NODES; i++) {
+
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", i);
+
+		if ((f = fopen(path, "r")) == NULL) continue;
+
+		if (!fgets(buf, sizeof(buf), f) || parse_cpulist(buf, &nodes[i].cpus))
+			CPU_ZERO(&nodes[i].cpus);
+
+		if (CPU_COUNT(&nodes[i].cpus)) topo_nnodes = i + 1;
+
+		fclose(f);
+
+	}
+
+	if (!topo_nnodes) {
+
+		sched_getaffinity(0, sizeof(cpu_set_t), &nodes[0].cpus);
+		topo_nnodes = 1;
+
+	}
+
+}
+
+/*
+ * node_of
+ *
+ * Returns node holding all cpus of set, -1 if they span several nodes.
+ *
+ */
+
+static int node_of(cpu_set_t *set) {
+
+	cpu_set_t and;
+	int i;
+
+	for (i = 0; i < topo_nnodes; i++) {
+
+		CPU_AND(&and, set, &nodes[i].cpus);
+		if (CPU_COUNT(&and) && CPU_EQUAL(&and, set)) return i;
+
+	}
+
+	return -1;
+
+}
+
+/*
+ * node_mask
+ *
+ * Builds node mask for mempolicy syscalls.
+ *
+ */
+
+static void node_mask(unsigned long *mask, int node) {
+
+	memset(mask, 0, TOPO_MAX_NODES / 8);
+
+	if (node >= 0) mask[node / (8 * sizeof(long))] |= 1UL << (node % (8 * sizeof(long)));
+
+}
+
+/*
+ * set_threads
+ *
+ * Sets affinity of every thread of a process.
+ *
+ */
+
+static int set_threads(int pid, cpu_set_t *set) {
+
+	char path[64];
+	DIR *dir;
+	struct dirent *ent;
+	int ret = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+	if ((dir = opendir(path)) == NULL) 
+		return sched_setaffinity(pid, sizeof(cpu_set_t), set);
+
+	while ((ent = readdir(dir)))
+		if (ent->d_name[0] != '.')
+			ret |= sched_setaffinity(atoi(ent->d_name), sizeof(cpu_set_t), set);
+
+	closedir(dir);
+
+	return ret;
+
+}
+
+/*
+ * place_node
+ *
+ * Moves placement to another node, keeping node occupancy up to date.
+ *
+ */
+
+static void place_node(struct placement *place, int node) {
+
+	if (place->node >= 0) nodes[place->node].tasks--;
+	if (node >= 0) nodes[node].tasks++;
+
+	place->node = node;
+
+}
+
+/*
+ * topo_place
+ *
+ * With auto placement, binds new process to least busy node having cpus.
+ * Returns NULL otherwise, process inherits scheduler's placement.
+ *
+ */
+
+struct placement* topo_place() {
+
+	struct placement *place;
+	int i, best = -1;
+
+	if (!topo_auto) return NULL;
+
+	for (i = 0; i < topo_nnodes; i++)
+		if (CPU_COUNT(&nodes[i].cpus) && (best == -1 || nodes[i].tasks < nodes[best].tasks))
+			best = i;
+
+	if (best == -1) return NULL;
+
+	place = malloc(sizeof(struct placement));
+	place->cpus = nodes[best].cpus;
+	place->node = -1;
+
+	place_node(place, best);
+
+	return place;
+
+}
+
+/*
+ * topo_apply
+ *
+ * Applies placement to calling process. Called by a new child before it runs
+ * anything, so its first allocations already land on the right node.
+ *
+ */
+
+void topo_apply(struct placement *place) {
+
+	unsigned long mask[TOPO_MAX_NODES / (8 * sizeof(long))];
+
+	if (!place) return;
+
+	sched_setaffinity(0, sizeof(cpu_set_t), &place->cpus);
+
+	if (place->node >= 0 && topo_nnodes > 1) {
+
+		node_mask(mask, place->node);
+		syscall(SYS_set_mempolicy, MPOL_BIND, mask, TOPO_MAX_NODES + 1);
+
+	}
+
+}
+
+/*
+ * topo_set_cpus
+ *
+ * Pins running process to cpus in list. Returns 0 on success, -1 with error
+ * set otherwise.
+ *
+ */
+
+int topo_set_cpus(pnode *proc, char *cpulist) {
+
+	cpu_set_t set;
+
+	if (parse_cpulist(cpulist, &set)) {
+
+		sprintf(errstr, "ERROR: \"%s\" is not a valid cpu list.", cpulist);
+		return -1;
+
+	}
+
+	if (set_threads(proc->pid, &set)) {
+
+		sprintf(errstr, "ERROR: Could not set affinity of process %d.", proc->pid);
+		return -1;
+
+	}
+
+	if (!proc->place) {
+
+		proc->place = malloc(sizeof(struct placement));
+		proc->place->node = -1;
+
+	}
+
+	proc->place->cpus = set;
+	place_node(proc->place, node_of(&set));
+
+	return 0;
+
+}
+
+/*
+ * topo_set_node
+ *
+ * Binds running process to node: pins it to the node's cpus and migrates its
+ * memory there. Memory it allocates later follows its cpus under the default
+ * first touch policy, the kernel only lets a process set its own mempolicy.
+ * Returns 0 on success, -1 with error set otherwise.
+ *
+ */
+
+int topo_set_node(pnode *proc, int node) {
+
+	unsigned long from[TOPO_MAX_NODES / (8 * sizeof(long))];
+	unsigned long to[TOPO_MAX_NODES / (8 * sizeof(long))];
+	int i;
+
+	if (node < 0 || node >= topo_nnodes || !CPU_COUNT(&nodes[node].cpus)) {
+
+		sprintf(errstr, "ERROR: Node %d does not exist.", node);
+		return -1;
+
+	}
+
+	if (set_threads(proc->pid, &nodes[node].cpus)) {
+
+		sprintf(errstr, "ERROR: Could not set affinity of process %d.", proc->pid);
+		return -1;
+
+	}
+
+	/* Move pages from every other node */
+	if (topo_nnodes > 1) {
+
+		node_mask(from, -1);
+		node_mask(to, node);
+
+		for (i = 0; i < topo_nnodes; i++)
+			if (i != node) from[i / (8 * sizeof(long))] |= 1UL << (i % (8 * sizeof(long)));
+
+		syscall(SYS_migrate_pages, proc->pid, TOPO_MAX_NODES + 1, from, to);
+
+	}
+
+	if (!proc->place) {
+
+		proc->place = malloc(sizeof(struct placement));
+		proc->place->node = -1;
+
+	}
+
+	proc->place->cpus = nodes[node].cpus;
+	place_node(proc->place, node);
+
+	return 0;
+
+}
+
+/*
+ * topo_adopt
+ *
+ * Accounts for a process bound to node by a previous scheduler.
+ *
+ */
+
+void topo_adopt(pnode *proc, int node) {
+
+	if (node < 0 || node >= topo_nnodes || !CPU_COUNT(&nodes[node].cpus)) return;
+
+	proc->place = malloc(sizeof(struct placement));
+	proc->place->node = -1;
+
+	sched_getaffinity(proc->pid, sizeof(cpu_set_t), &proc->place->cpus);
+	place_node(proc->place, node);
+
+}
+
+/*
+ * topo_node
+ *
+ * Returns node process is bound to, -1 if none.
+ *
+ */
+
+int topo_node(pnode *proc) {
+
+	return proc->place ? proc->place->node : -1;
+
+}
+
+/*
+ * topo_release
+ *
+ * Drops placement of process.
+ *
+ */
+
+void topo_release(pnode *proc) {
+
+	topo_free(proc->place);
+
+	proc->place = NULL;
+
+}
+
+/*
+ * topo_free
+ *
+ * Drops placement chosen for a process that never started.
+ *
+ */
+
+void topo_free(struct placement *place) {
+
+	if (!place) return;
+
+	place_node(place, -1);
+	free(place);
+
+}
+
+/*
+ * topo_status
+ *
+ * Formats process count per node, like "Nodes 0:3 1:2".
+ *
+ */
+
+char* topo_status(char *buf, int size) {
+
+	int i, len;
+
+	len = snprintf(buf, size, "Nodes");
+
+	for (i = 0; i < topo_nnodes && len < size; i++)
+		if (CPU_COUNT(&nodes[i].cpus))
+			len += snprintf(buf + len, size - len, " %d:%d", i, nodes[i].tasks);
+
+	return buf;
+
+}
@@ -0,0 +1,68 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	topo.h
+ *
+ * @Description: Cpu and NUMA placement. Node topology is read from sysfs once.
+ * 		A process can be pinned to a list of cpus or bound to a node, in
+ * 		which case it runs on the node's cpus and its memory is moved to
+ * 		and allocated from that node. With auto placement, every new
+ * 		process is bound at launch to the node running the fewest.
+ *
+ * @Functions:
+ *
+ * 	topo_init	Reads node topology from sysfs.
+ *
+ * 	topo_place	Chooses placement of a new process. Returns NULL
+ * 			if it should inherit the scheduler's.
+ *
+ * 	topo_apply	Applies placement to calling process, in a new child.
+ *
+ * 	topo_set_cpus	Pins a process to a cpu list like 0-3,8. Returns 0
+ * 			on success.
+ *
+ * 	topo_set_node	Binds a process to a node. Returns 0 on success.
+ *
+ * 	topo_adopt	Accounts for process placed by a previous scheduler.
+ *
+ * 	topo_node	Returns node a process is bound to, -1 if none.
+ *
+ * 	topo_release	Drops placement of a process that is going away.
+ *
+ * 	topo_free	Drops placement of a launch that failed.
+ *
+ * 	topo_status	Formats number of processes per node.
+ *
+ */
+
+#define __topo_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define TOPO_MAX_NODES	64
+
+extern int topo_auto;
+extern int topo_nnodes;
+extern const int topo_place_size;
+
+void topo_init();
+
+struct placement* topo_place();
+
+void topo_apply(struct placement *place);
+
+int topo_set_cpus(pnode *proc, char *cpulist);
+
+int topo_set_node(pnode *proc, int node);
+
+void topo_adopt(pnode *proc, int node);
+
+int topo_node(pnode *proc);
+
+void topo_release(pnode *proc);
+
+void topo_free(struct placement *place);
+
+char* topo_status(char *buf, int size);
+
@@ -0,0 +1,427 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	trig
+ *
+ * @Description: Output triggers
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "trig.h"
+#include "proc.h"
+
+#ifndef __output_h_
+	#include "output.h"
+#endif
+
+#ifndef __metrics_h_
+	#include "metrics.h"
+#endif
+
+/* Logs a line, in ui.c */
+void log_add_line(char *buffer);
+
+typedef struct rule {
+	char	pat[TRIG_LEN + 1];
+	int	action;
+	int	target;			/* Pid acted on, 0 for the printer */
+} rule;
+
+typedef struct fire {
+	int	pid;
+	int	rule;
+} fire;
+
+static char *actions[] = {"block", "run", "kill"};
+
+static rule rules[TRIG_MAX];
+static int nrules = 0;
+
+/* Automaton: transitions of state s on class c at delta[s * ncls + c], and
+ * rules matched on reaching each state as a bit mask */
+static unsigned char cls[256];
+static int ncls = 0, *delta = NULL;
+static unsigned long long *out = NULL;
+
+/* Bumped on every compile, channels holding an older state restart */
+static int gen = 1;
+
+static fire queue[TRIG_QUEUE];
+static int nqueue = 0;
+
+/*
+ * compile
+ *
+ * Builds automaton out of rules. Patterns are entered in a trie, failure
+ * links are found breadth first, then missing transitions are filled in
+ * from the failure state so a scan never backtracks.
+ *
+ */
+
+static void compile() {
+
+	int len = 1, n = 1, s, t, c, i, j, head = 0, tail = 0, *fail, *bfs;
+
+	gen++;
+
+	free(delta);
+	free(out);
+	delta = NULL;
+	out = NULL;
+
+	if (!nrules) return;
+
+	/* Bytes in no pattern all fall in class 0 */
+	memset(cls, 0, sizeof(cls));
+	ncls = 1;
+
+	for (i = 0; i < nrules; i++) {
+
+		len += strlen(rules[i].pat);
+
+		for (j = 0; rules[i].pat[j]; j++)
+			if (!cls[(unsigned char)rules[i].pat[j]]) cls[(unsigned char)rules[i].pat[j]] = ncls++;
+
+	}
+
+	delta = malloc(len * ncls * sizeof(int));
+	out = calloc(len, sizeof(unsigned long long));
+	fail = calloc(len, sizeof(int));
+	bfs = malloc(len * sizeof(int));
+
+	memset(delta, -1, len * ncls * sizeof(int));
+
+	/* Trie */
+	for (i = 0; i < nrules; i++) {
+
+		for (s = 0, j = 0; rules[i].pat[j]; j++) {
+
+			c = cls[(unsigned char)rules[i].pat[j]];
+
+			if (delta[s * ncls + c] == -1) delta[s * ncls + c] = n++;
+			s = delta[s * ncls + c];
+
+		}
+
+		out[s] |= 1ULL << i;
+
+	}
+
+	/* Children of root fail to root, missing ones loop on it */
+	for (c = 0; c < ncls; c++) {
+
+		if (delta[c] == -1) delta[c] = 0;
+		else bfs[tail++] = delta[c];
+
+	}
+
+	while (head < tail) {
+
+		s = bfs[head++];
+
+		for (c = 0; c < ncls; c++) {
+
+			t = delta[s * ncls + c];
+
+			/* Missing transition goes where the failure state would */
+			if (t == -1) {
+
+				delta[s * ncls + c] = delta[fail[s] * ncls + c];
+				continue;
+
+			}
+
+			fail[t] = delta[fail[s] * ncls + c];
+			out[t] |= out[fail[t]];
+			bfs[tail++] = t;
+
+		}
+
+	}
+
+	free(fail);
+	free(bfs);
+
+}
+
+/*
+ * parse_action
+ *
+ * Returns action named by string, -1 if none.
+ *
+ */
+
+static int parse_action(char *name) {
+
+	int i;
+
+	for (i = 0; i < 3; i++)
+		if (!strcasecmp(name, actions[i])) return i;
+
+	return -1;
+
+}
+
+/*
+ * trig_add
+ *
+ * Adds rule taking action on target, 0 for the process printing pattern.
+ * Returns 0 on success, -1 with error set otherwise.
+ *
+ */
+
+int trig_add(char *pattern, char *action, int target) {
+
+	int a = parse_action(action);
+
+	if (a == -1) {
+
+		sprintf(errstr, "ERROR: Action must be block, run or kill.");
+		return -1;
+
+	}
+
+	if (!*pattern || strlen(pattern) > TRIG_LEN) {
+
+		sprintf(errstr, "ERROR: Pattern must be 1 to %d characters.", TRIG_LEN);
+		return -1;
+
+	}
+
+	if (nrules == TRIG_MAX) {
+
+		sprintf(errstr, "ERROR: Too many triggers, %d at most.", TRIG_MAX);
+		return -1;
+
+	}
+
+	strcpy(rules[nrules].pat, pattern);
+	rules[nrules].action = a;
+	rules[nrules].target = target;
+	nrules++;
+
+	compile();
+
+	return 0;
+
+}
+
+/*
+ * trig_remove
+ *
+ * Removes every rule of pattern. Returns 0 on success, -1 with error set
+ * if there is none.
+ *
+ */
+
+int trig_remove(char *pattern) {
+
+	int i, j;
+
+	for (i = j = 0; i < nrules; i++)
+		if (strcmp(rules[i].pat, pattern)) rules[j++] = rules[i];
+
+	if (j == nrules) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: No trigger on \"%s\".", pattern);
+		return -1;
+
+	}
+
+	nrules = j;
+
+	compile();
+
+	return 0;
+
+}
+
+/*
+ * trig_load
+ *
+ * Adds rules of file, an action and the pattern making up the rest of the
+ * line on each. Blank lines and lines starting with # are skipped. Returns
+ * 0 on success, -1 with error set otherwise.
+ *
+ */
+
+int trig_load(char *path) {
+
+	char line[256], *start, *p;
+	FILE *f;
+	int lineno = 0;
+
+	if ((f = fopen(path, "r")) == NULL) {
+
+		snprintf(errstr, sizeof(errstr), "ERROR: Could not open trigger file '%s'.", path);
+		return -1;
+
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+
+		lineno++;
+		line[strcspn(line, "\r\n")] = 0;
+
+		for (start = line; *start == ' ' || *start == '\t'; start++);
+		if (!*start || *start == '#') continue;
+
+		/* Action ends at first blank, pattern starts past the blanks after it */
+		p = start + strcspn(start, " \t");
+
+		if (*p) *p++ = 0;
+		while (*p == ' ' || *p == '\t') p++;
+
+		if (trig_add(p, start, 0)) {
+
+			/* Error ends with a period, line number goes before it */
+			snprintf(errstr + strlen(errstr) - 1, sizeof(errstr) - strlen(errstr) + 1,
+					" (line %d).", lineno);
+			fclose(f);
+			return -1;
+
+		}
+
+	}
+
+	fclose(f);
+
+	return 0;
+
+}
+
+/*
+ * trig_scan
+ *
+ * Runs count bytes of output of proc through the automaton, from the state
+ * its channel was left in, queueing rules matched. A rule already queued for
+ * the same process isn't queued again, matches a full queue has no room for
+ * are counted as dropped.
+ *
+ */
+
+void trig_scan(pnode *proc, char *buf, int count) {
+
+	ochan *och = proc->och;
+	unsigned long long hit;
+	int s, i, r, pid, q;
+
+	if (!delta) return;
+
+	s = och->tgen == gen ? och->tstate : 0;
+
+	for (i = 0; i < count; i++) {
+
+		s = delta[s * ncls + cls[(unsigned char)buf[i]]];
+
+		if (!(hit = out[s])) continue;
+
+		for (r = 0; hit; r++, hit >>= 1) {
+
+			if (!(hit & 1)) continue;
+
+			pid = rules[r].target ? rules[r].target : proc->pid;
+
+			/* Taking an action twice does nothing more, queue it once */
+			for (q = 0; q < nqueue && (queue[q].pid != pid || queue[q].rule != r); q++);
+
+			if (q < nqueue) continue;
+
+			if (nqueue == TRIG_QUEUE) {
+
+				mstat.triggers_dropped++;
+				continue;
+
+			}
+
+			queue[nqueue].pid = pid;
+			queue[nqueue++].rule = r;
+
+		}
+
+	}
+
+	och->tstate = s;
+	och->tgen = gen;
+
+}
+
+/*
+ * trig_run
+ *
+ * Takes actions queued, on processes still there and not in that state
+ * already.
+ *
+ */
+
+void trig_run() {
+
+	char line[TRIG_LEN + 64];
+	pnode *proc;
+	rule *r;
+	int i;
+
+	for (i = 0; i < nqueue; i++) {
+
+		r = &rules[queue[i].rule];
+
+		if (!(proc = pnode_get_node_by_pid(queue[i].pid))) continue;
+
+		if (r->action == TRIG_BLOCK && proc->state != BLOCKED) {
+
+			block_node(proc);
+			proc->cause = BC_TRIGGER;
+
+		} else if (r->action == TRIG_RUN && proc->state == BLOCKED)
+			run_node(proc);
+
+		else if (r->action == TRIG_KILL)
+			kill_node(proc);
+
+		else continue;
+
+		mstat.triggers++;
+
+		snprintf(line, sizeof(line), "Trigger \"%s\": %s %d\n", r->pat, actions[r->action],
+				queue[i].pid);
+		log_add_line(line);
+
+	}
+
+	nqueue = 0;
+
+}
+
+/*
+ * trig_status
+ *
+ * Logs rules, one per line, and formats their number into buf.
+ *
+ */
+
+char* trig_status(char *buf, int size) {
+
+	char line[TRIG_LEN + 64];
+	int i, n;
+
+	for (i = 0; i < nrules; i++) {
+
+		n = snprintf(line, sizeof(line), "\"%s\" %s", rules[i].pat, actions[rules[i].action]);
+
+		if (rules[i].target) snprintf(line + n, sizeof(line) - n, " %d", rules[i].target);
+
+		strcat(line, "\n");
+		log_add_line(line);
+
+	}
+
+	snprintf(buf, size, "%d trigger%s.", nrules, nrules == 1 ? "" : "s");
+
+	return buf;
+
+}
+
@@ -0,0 +1,80 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	trig.h
+ *
+ * @Description: Output triggers. A trigger is a pattern and an action, block,
+ * 		run or kill, taken on the process that printed the pattern, or
+ * 		on another one given by pid. Rules come from the trigger
+ * 		command or a file given with -t, one per line:
+ *
+ * 			block throttled
+ * 			kill FATAL
+ *
+ * 		Every time rules change they are compiled once into a single
+ * 		Aho-Corasick automaton, turned into a table of transitions on
+ * 		classes of bytes (bytes no pattern has share one class). Output
+ * 		is run through it as it is read, before lines are assembled or
+ * 		throttled, one table lookup per byte whatever the number of
+ * 		rules. Each channel keeps its own state, so a pattern split
+ * 		across two reads still matches.
+ *
+ * 		Actions are queued while output is scanned and taken afterwards
+ * 		from the main loop, on processes still around. A rule is
+ * 		queued once per process between runs, matches beyond a
+ * 		full queue are dropped and counted. A process blocked by a
+ * 		trigger shows as TRIGGER.
+ *
+ * @Constants:
+ *
+ * 	TRIG_MAX	Most rules
+ *
+ * 	TRIG_LEN	Longest pattern
+ *
+ * 	TRIG_QUEUE	Most actions waiting to be taken
+ *
+ * @Functions:
+ *
+ * 	trig_add	Adds rule and recompiles. Returns 0 on success, -1
+ * 			with error set otherwise.
+ *
+ * 	trig_remove	Removes rules of a pattern and recompiles. Returns
+ * 			0 on success, -1 with error set otherwise.
+ *
+ * 	trig_load	Adds rules of a file. Returns 0 on success, -1 with
+ * 			error set otherwise.
+ *
+ * 	trig_scan	Runs output of a process through the automaton,
+ * 			queueing actions of patterns matched.
+ *
+ * 	trig_run	Takes queued actions.
+ *
+ * 	trig_status	Logs rules, formats their number.
+ *
+ */
+
+#define __trig_h_
+
+#ifndef __pnode_h_
+	#include "pnode.h"
+#endif
+
+#define TRIG_MAX	64
+#define TRIG_LEN	64
+#define TRIG_QUEUE	256
+
+#define TRIG_BLOCK	0
+#define TRIG_RUN	1
+#define TRIG_KILL	2
+
+int trig_add(char *pattern, char *action, int target);
+
+int trig_remove(char *pattern);
+
+int trig_load(char *path);
+
+void trig_scan(pnode *proc, char *buf, int count);
+
+void trig_run();
+
+char* trig_status(char *buf, int size);
+
@@ -45,31 +45,21 @@ void show_help() {
 	/* Print help label */
 	mvwprintw(helpscr, 0, (help_xmax / 2) - 2, "HELP");
 
-	/* Print commands */
-	int desc_x = help_xmax * 0.3;
+	/* Print commands, spaced out if window is tall enough */
+	int desc_x = help_xmax * 0.4;
+	int step = (help_ymax - 6) / ncommands >= 3 ? 3 : 
+		(help_ymax - 6) / ncommands >= 2 ? 2 : 1;
+	int i;
 
 	mvwprintw(helpscr, 2, 2, "Here is a list of all the commands: ");
 	
-	mvwprintw(helpscr, 4, 4, "spawn <name>");
-	mvwprintw(helpscr, 4, desc_x, "Spawns a new process. Outputs <name>.");
+	for (i = 0; i < ncommands && 4 + i * step < help_ymax - 1; i++) {
 
-	mvwprintw(helpscr, 7, 4, "exec <file>");
-	mvwprintw(helpscr, 7, desc_x, "Exec program in directory. Pipes output.");
+		mvwprintw(helpscr, 4 + i * step, 4, "%.*s", desc_x - 5, commands[i].usage);
+		mvwprintw(helpscr, 4 + i * step, desc_x, "%.*s", help_xmax - desc_x - 1,
+				commands[i].help);
 
-	mvwprintw(helpscr, 10, 4, "kill <pid>");
-	mvwprintw(helpscr, 10, desc_x, "Kills process using pid.");
-	
-	mvwprintw(helpscr, 13, 4, "block <pid>");
-	mvwprintw(helpscr, 13, desc_x, "Puts process in blocked queue.");
-
-	mvwprintw(helpscr, 16, 4, "run <pid>");
-	mvwprintw(helpscr, 16, desc_x, "Puts process back in ready queue.");
-
-	mvwprintw(helpscr, 19, 4, "quit");
-	mvwprintw(helpscr, 19, desc_x, "Quits.");
-
-	mvwprintw(helpscr, 22, 4, "help");
-	mvwprintw(helpscr, 22, desc_x, "This window.");
+	}
 
 	/* Print bottom label */
 	mvwprintw(helpscr, help_ymax - 1, (help_xmax / 2) - 17, 
@@ -81,8 +71,10 @@ void show_help() {
 	keypad(helpscr, TRUE);
 	char ch;
 
-	/* Block until user presses key */
+	/* Block until user presses key, processes keep taking turns */
+	clock_allow();
 	while ((ch = getch()) == ERR || ch == 255); 
+	clock_hold();
 
 	/* Turn off keystrokes and kill window */
 	keypad(helpscr, FALSE);
@@ -90,6 +82,144 @@ void show_help() {
 
 }
 
+/*
+ * show_pages()
+ *
+ * Shows lines read by gets from cursor in a window titled label, one page
+ * at a time, until the user presses something else than space.
+ *
+ */
+
+static void show_pages(char *label, char* (*gets)(void *, char *, int), void *cur) {
+
+	WINDOW *logscr;
+	char line[256];
+	int ch = ' ', y, more = 1;
+
+	int log_xmax = ncols * 0.8;
+	int log_ymax = nrows * 0.8;
+
+	logscr = newwin(log_ymax, log_xmax, 
+				(nrows - log_ymax) / 2, (ncols - log_xmax) / 2);
+
+	keypad(logscr, TRUE);
+
+	/* Page through log until user presses something else than space */
+	while (more && (ch == ' ' || ch == KEY_NPAGE || ch == KEY_DOWN)) {
+
+		werase(logscr);
+
+		/* Print window frame and label */
+		wattron(logscr, COLOR_PAIR(4));
+		box(logscr, 0, 0);
+		wattroff(logscr, COLOR_PAIR(4));
+
+		mvwprintw(logscr, 0, (log_xmax - (int)strlen(label)) / 2, "%s", label);
+
+		/* Print one page */
+		for (y = 1; y < log_ymax - 1; y++) {
+
+			if (!gets(cur, line, sizeof(line))) {
+				
+				more = 0;
+				break;
+
+			}
+
+			line[strcspn(line, "\n")] = 0;
+			mvwprintw(logscr, y, 2, "%.*s", log_xmax - 4, line);
+
+		}
+
+		mvwprintw(logscr, log_ymax - 1, (log_xmax / 2) - 19, 
+				more ? " Space for next page, any key to close " 
+				     : " End of log, press any key to close ");
+
+		wrefresh(logscr);
+
+		/* Block until user presses key, processes keep taking turns */
+		clock_allow();
+		while ((ch = getch()) == ERR || ch == 255); 
+		clock_hold();
+
+	}
+
+	keypad(logscr, FALSE);
+	delwin(logscr);
+
+}
+
+/*
+ * log_gets, archive_gets
+ *
+ * Read next line of a log or of the archive for show_pages.
+ *
+ */
+
+static char* log_gets(void *cur, char *buf, int size) {
+
+	return plog_gets(cur, buf, size);
+
+}
+
+static char* archive_gets(void *cur, char *buf, int size) {
+
+	return arch_gets(cur, buf, size);
+
+}
+
+/*
+ * show_log()
+ *
+ * Shows persistent log of a process in a window, one page at a time, starting
+ * at the first line logged at or after since (seconds since epoch).
+ *
+ */
+
+void show_log(int pid, long long since) {
+
+	pcursor cur;
+	char label[32];
+
+	if (plog_find(&cur, pid, since)) {
+
+		sprintf(errstr, "ERROR: No log for process %d in that range.", pid);
+		return;
+
+	}
+
+	snprintf(label, sizeof(label), "LOG %d", pid);
+	show_pages(label, log_gets, &cur);
+
+	plog_close(&cur);
+
+}
+
+/*
+ * show_archive()
+ *
+ * Shows output archived from since until until (seconds since epoch) in a
+ * window, one page at a time, each line with its time and pid.
+ *
+ */
+
+void show_archive(long long since, long long until) {
+
+	acursor cur;
+
+	if (arch_find(&cur, since, until)) {
+
+		sprintf(errstr, "ERROR: Nothing archived in that range.");
+		return;
+
+	}
+
+	show_pages("ARCHIVE", archive_gets, &cur);
+
+	arch_end(&cur);
+
+}
+
 /*
  * log_add_line
  *
@@ -200,6 +330,14 @@ void print_ui() {
 	/* Print label "Output:" */
 	mvprintw(VPADDING, HPADDING, "Output: \n");	
 
+	/* Print processes per node when placement matters */
+	if (topo_nnodes > 1 || topo_auto) {
+
+		char nodes[64];
+		mvprintw(VPADDING, HPADDING + 9, "%s", topo_status(nodes, sizeof(nodes)));
+
+	}
+
 	/* Print label "Process Table:" */
 	mvprintw(VPADDING, ncols * 0.6 - HPADDING, "Process Table (PID, Name, State):");
 
@@ -299,6 +437,46 @@ int ani_char() {
 
 }
 
+/*
+ * print_proc
+ *
+ * Prints pid and name of process, and its priority unless lowest. Priority
+ * inherited from waiters is marked with a star. With counters, follows IPC
+ * and cache miss ratio once known.
+ *
+ */
+
+static void print_proc(int y, int x, pnode *proc) {
+
+	mvprintw(y, x, "%d\t%s", proc->pid, proc->name);
+
+	if (proc->eprio) printw(" %d%s", proc->eprio, proc->eprio != proc->prio ? "*" : "");
+
+	if (proc->perf && proc->perf->ipc >= 0) printw(" %.2f", proc->perf->ipc);
+	if (proc->perf && proc->perf->miss >= 0) printw(" %.0f%%", proc->perf->miss * 100);
+
+}
+
+/*
+ * print_blocked_state
+ *
+ * Prints state of blocked process, with the reason if it was not blocked by
+ * the user.
+ *
+ */
+
+static void print_blocked_state(int y, pnode *proc) {
+
+	char *label = proc->cause == BC_RSS ? "OVERMEM" : 
+			proc->cause == BC_PRESSURE ? "PRESSURE" : 
+			proc->cause == BC_WAIT ? "WAITING" : 
+			proc->cause == BC_EVENT ? "EVENT" : 
+			proc->cause == BC_TRIGGER ? "TRIGGER" : "BLOCKED";
+
+	mvprintw(y, ncols - HPADDING - strlen(label), "%s", label);
+
+}
+
 /*
  * print_proc_table()
  *
@@ -323,7 +501,7 @@ void print_proc_table() {
 	if (head) {
 		
 		/* Print PID, name and state */
-		mvprintw(y + i, x, "%d\t%s", head->pid, head->name);	
+		print_proc(y + i, x, head);	
 		mvprintw(y + i, ncols - HPADDING - 7, "RUNNING");
 
 		i++;
@@ -338,8 +516,10 @@ void print_proc_table() {
 				tmp = tmp->next;
 
 				/* Print PID, name and state */
-				mvprintw(y + i, x, "%d\t%s", tmp->pid, tmp->name);
-				mvprintw(y + i, ncols - HPADDING - 5, "READY");
+				print_proc(y + i, x, tmp);
+
+				if (tmp->co) mvprintw(y + i, ncols - HPADDING - 7, "RUNNING");
+				else mvprintw(y + i, ncols - HPADDING - 5, "READY");
 
 				i++;
 			}
@@ -351,7 +531,8 @@ void print_proc_table() {
 	/* Print idle process */
 	attron(COLOR_PAIR(3));
 	
-	mvprintw(y + i, x, "%d\tIdle\n", idle_proc->pid);
+	if (idle_proc) mvprintw(y + i, x, "%d\tIdle\n", idle_proc->pid);
+	else mvprintw(y + i, x, "-\tIdle\n");
 	
 	attroff(COLOR_PAIR(3));
 
@@ -367,8 +548,8 @@ void print_proc_table() {
 	if (blocked) {
 	
 		/* Print PID, name and state */
-		mvprintw(y + i, x, "%d\t%s", blocked->pid, blocked->name);
-		mvprintw(y + i, ncols - HPADDING - 7, "BLOCKED");
+		print_proc(y + i, x, blocked);
+		print_blocked_state(y + i, blocked);
 
 		i++;
 
@@ -381,8 +562,8 @@ void print_proc_table() {
 			
 				tmp = tmp->next;
 
-				mvprintw(y + i, x, "%d\t%s", tmp->pid, tmp->name);
-				mvprintw(y + i, ncols - HPADDING - 7, "BLOCKED");
+				print_proc(y + i, x, tmp);
+				print_blocked_state(y + i, tmp);
 				i++;
 
 			}
@@ -413,8 +594,13 @@ void update_screen() {
 	print_proc_table();
 	
 	print_ui();
-	
+
+	/* Companions are moved around the ring by the clock interrupt, so it
+	 * only comes in once the table is drawn, while the terminal is
+	 * written */
+	clock_allow();
 	refresh();
+	clock_hold();
 
 }
 
@@ -14,6 +14,10 @@
  *
  *	show_help	Shows help window
  *
+ *	show_log	Shows persistent log of a process from a given time
+ *
+ *	show_archive	Shows archived output of a time range
+ *
  *	history_add	Adds a command into the history
  *
  *	history_get_prev	Gets previous command in history
@@ -48,6 +52,22 @@
 	#include "pnode.h"
 #endif
 
+#ifndef __plog_h_
+	#include "plog.h"
+#endif
+
+#ifndef __arch_h_
+	#include "arch.h"
+#endif
+
+#ifndef __comm_h_
+	#include "comm.h"
+#endif
+
+#ifndef __perf_h_
+	#include "perf.h"
+#endif
+
 #define VPADDING 	1
 #define HPADDING 	2
 #define	HEADER		3
@@ -63,6 +83,10 @@ extern char *logtable[128];
 extern char comm[64];
 extern char errstr[128];
 
+void show_log(int pid, long long since);
+
+void show_archive(long long since, long long until);
+
 void print_ui();
 
 void print_log();
@@ -0,0 +1,324 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	uring
+ *
+ * @Description: Minimal io_uring
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "uring.h"
+#include "metrics.h"
+
+/* Not in headers older than 6.7 */
+#define URING_OP_READ_MULTISHOT	49
+
+/* Buffer group of provided buffers */
+#define URING_BGID	0
+
+/* Completion nobody waits for, like that of a cancel */
+#define URING_NOTAG	0
+
+typedef struct ring {
+	int			fd;
+	unsigned		*sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+	unsigned		*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+	unsigned		queued;		/* Posted, not submitted yet */
+	struct io_uring_buf_ring *br;		/* Provided buffers */
+	char			*bufs;
+} ring;
+
+static ring r = { .fd = -1 };
+
+/*
+ * enter
+ *
+ * Submits to and waits on ring.
+ *
+ */
+
+static int enter(unsigned submit, unsigned wait, unsigned flags) {
+
+	mstat.io_syscalls++;
+
+	return syscall(SYS_io_uring_enter, r.fd, submit, wait, flags, NULL, 0);
+
+}
+
+/*
+ * recycle
+ *
+ * Gives buffer bid back to the kernel.
+ *
+ */
+
+static void recycle(unsigned short bid) {
+
+	unsigned short tail = r.br->tail;
+	struct io_uring_buf *buf = &r.br->bufs[tail & (URING_BUFS - 1)];
+
+	buf->addr = (unsigned long)(r.bufs + bid * URING_BUFSIZE);
+	buf->len = URING_BUFSIZE;
+	buf->bid = bid;
+
+	__atomic_store_n(&r.br->tail, tail + 1, __ATOMIC_RELEASE);
+
+}
+
+/*
+ * supported
+ *
+ * Asks kernel whether it knows multishot reads.
+ *
+ */
+
+static int supported() {
+
+	struct io_uring_probe *probe;
+	int ok;
+
+	if (!(probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op))))
+		return 0;
+
+	ok = !syscall(SYS_io_uring_register, r.fd, IORING_REGISTER_PROBE, probe, 256) &&
+		probe->last_op >= URING_OP_READ_MULTISHOT &&
+		(probe->ops[URING_OP_READ_MULTISHOT].flags & IO_URING_OP_SUPPORTED);
+
+	free(probe);
+
+	return ok;
+
+}
+
+/*
+ * uring_init
+ *
+ * Creates ring, maps it and registers provided buffers.
+ *
+ */
+
+int uring_init() {
+
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	char *sq, *cq;
+	int i;
+
+	if (r.fd != -1) return 0;
+
+	memset(&p, 0, sizeof(p));
+
+	if ((r.fd = syscall(SYS_io_uring_setup, URING_ENTRIES, &p)) == -1) return -1;
+
+	/* Needs one mapping for both rings, and no completion ever dropped */
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP) ||
+			!supported())
+		goto fail;
+
+	i = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) > (unsigned)i)
+		i = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+	sq = cq = mmap(NULL, i, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			r.fd, IORING_OFF_SQ_RING);
+
+	r.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQES);
+
+	if (sq == MAP_FAILED || r.sqes == MAP_FAILED) goto fail;
+
+	r.sq_head = (unsigned *)(sq + p.sq_off.head);
+	r.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r.sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	r.sq_flags = (unsigned *)(sq + p.sq_off.flags);
+	r.sq_array = (unsigned *)(sq + p.sq_off.array);
+	r.cq_head = (unsigned *)(cq + p.cq_off.head);
+	r.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r.cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	r.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	/* Ring of buffers must be page aligned */
+	r.br = mmap(NULL, URING_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	r.bufs = malloc(URING_BUFS * URING_BUFSIZE);
+
+	if (r.br == MAP_FAILED || !r.bufs) goto fail;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)r.br;
+	reg.ring_entries = URING_BUFS;
+	reg.bgid = URING_BGID;
+
+	if (syscall(SYS_io_uring_register, r.fd, IORING_REGISTER_PBUF_RING, &reg, 1)) goto fail;
+
+	for (i = 0; i < URING_BUFS; i++) recycle(i);
+
+	return 0;
+
+fail:
+	/* Mappings are left, they are only lost once */
+	close(r.fd);
+	r.fd = -1;
+
+	return -1;
+
+}
+
+/*
+ * get_sqe
+ *
+ * Returns next free submission entry, zeroed. Submits what is queued if the
+ * queue is full.
+ *
+ */
+
+static struct io_uring_sqe* get_sqe() {
+
+	unsigned tail = *r.sq_tail, idx;
+	struct io_uring_sqe *sqe;
+
+	while (tail - __atomic_load_n(r.sq_head, __ATOMIC_ACQUIRE) >= URING_ENTRIES)
+		if (uring_submit() == -1 && errno != EINTR && errno != EBUSY) return NULL;
+
+	idx = tail & *r.sq_mask;
+	sqe = &r.sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+
+	r.sq_array[idx] = idx;
+	__atomic_store_n(r.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	r.queued++;
+
+	return sqe;
+
+}
+
+/*
+ * uring_read
+ *
+ * Posts multishot read of fd into provided buffers.
+ *
+ */
+
+int uring_read(int fd, void *tag) {
+
+	struct io_uring_sqe *sqe;
+
+	if (r.fd == -1 || !(sqe = get_sqe())) return -1;
+
+	sqe->opcode = URING_OP_READ_MULTISHOT;
+	sqe->fd = fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	sqe->user_data = (unsigned long)tag;
+
+	return 0;
+
+}
+
+/*
+ * uring_cancel
+ *
+ * Posts cancel of requests of tag. They complete with -ECANCELED.
+ *
+ */
+
+int uring_cancel(void *tag) {
+
+	struct io_uring_sqe *sqe;
+
+	if (r.fd == -1 || !(sqe = get_sqe())) return -1;
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (unsigned long)tag;
+	sqe->user_data = URING_NOTAG;
+
+	return 0;
+
+}
+
+/*
+ * uring_submit
+ *
+ * Submits everything posted, all in one call.
+ *
+ */
+
+int uring_submit() {
+
+	int n;
+
+	if (r.fd == -1 || !r.queued) return 0;
+
+	if ((n = enter(r.queued, 0, 0)) > 0) r.queued -= n;
+
+	return n;
+
+}
+
+/*
+ * uring_reap
+ *
+ * Consumes completions straight from the ring, recycling buffers once cb is
+ * done with them. Only enters the kernel when completions overflowed the
+ * ring and wait there.
+ *
+ */
+
+int uring_reap(uring_cb cb) {
+
+	struct io_uring_cqe *cqe;
+	unsigned head, flags;
+	int n = 0;
+
+	if (r.fd == -1) return 0;
+
+	if (__atomic_load_n(r.sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+		enter(0, 0, IORING_ENTER_GETEVENTS);
+
+	head = *r.cq_head;
+
+	while (head != __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE)) {
+
+		cqe = &r.cqes[head & *r.cq_mask];
+		flags = cqe->flags;
+
+		if (cqe->user_data != URING_NOTAG)
+			cb((void *)(unsigned long)cqe->user_data,
+				flags & IORING_CQE_F_BUFFER ?
+					r.bufs + (flags >> IORING_CQE_BUFFER_SHIFT) * URING_BUFSIZE : NULL,
+				cqe->res, flags & IORING_CQE_F_MORE);
+
+		if (flags & IORING_CQE_F_BUFFER) recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+
+		__atomic_store_n(r.cq_head, ++head, __ATOMIC_RELEASE);
+		n++;
+
+	}
+
+	return n;
+
+}
+
+/*
+ * uring_fd
+ *
+ * Returns ring descriptor.
+ *
+ */
+
+int uring_fd() {
+
+	return r.fd;
+
+}
+
@@ -0,0 +1,68 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	uring.h
+ *
+ * @Description: Minimal io_uring, through the raw system calls. Reads are
+ * 		multishot: posted once per descriptor, they keep completing as
+ * 		data comes in until the descriptor hits end of file. Data lands
+ * 		in buffers of a ring registered with the kernel (provided
+ * 		buffers), handed back as soon as a completion is consumed.
+ *
+ * 		Completions are read straight from the ring shared with the
+ * 		kernel, without a system call. One is only needed to submit
+ * 		new requests, so once every pipe has its read posted, draining
+ * 		output costs nothing however many processes there are.
+ *
+ * 		Needs Linux 6.7 for multishot reads. uring_init fails on older
+ * 		kernels, or where io_uring is disabled, and callers fall back
+ * 		on epoll.
+ *
+ * @Constants:
+ *
+ * 	URING_ENTRIES	Submission queue size
+ *
+ * 	URING_BUFS	Number of provided buffers
+ *
+ * 	URING_BUFSIZE	Size of a provided buffer
+ *
+ * @Functions:
+ *
+ * 	uring_init	Sets up ring and buffers. Returns 0 on success,
+ * 			-1 if io_uring can't be used.
+ *
+ * 	uring_read	Posts a multishot read, tag identifies completions.
+ *
+ * 	uring_cancel	Cancels requests of a tag.
+ *
+ * 	uring_submit	Submits posted requests, if any.
+ *
+ * 	uring_reap	Calls back for every completion. Returns number of
+ * 			completions.
+ *
+ * 	uring_fd	Returns ring descriptor, readable when completions
+ * 			are waiting, -1 without a ring.
+ *
+ */
+
+#define __uring_h_
+
+#define URING_ENTRIES	256
+#define URING_BUFS	64
+#define URING_BUFSIZE	4096
+
+/* Completion of a tag. res is bytes read, 0 at end of file or -errno. more
+ * is 0 once the request is done */
+typedef void (*uring_cb)(void *tag, char *buf, int res, int more);
+
+int uring_init();
+
+int uring_read(int fd, void *tag);
+
+int uring_cancel(void *tag);
+
+int uring_submit();
+
+int uring_reap(uring_cb cb);
+
+int uring_fd();
+
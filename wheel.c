@@ -0,0 +1,325 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	wheel
+ *
+ * @Description: Hierarchical timer wheel
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "wheel.h"
+
+/* Slots are circular lists around a sentinel */
+static wtimer slots[WHEEL_LEVELS][WHEEL_SLOTS];
+
+static int wheel_fd = -1;
+static long npending = 0;
+
+/* Last tick processed and time of tick 0 */
+static unsigned long long cur = 0;
+static struct timespec epoch;
+
+/*
+ * wheel_init
+ *
+ * Creates timerfd and empties slots. Returns -1 on failure.
+ *
+ */
+
+static int wheel_init() {
+
+	int i, j;
+
+	if (wheel_fd != -1) return 0;
+
+	if ((wheel_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1) 
+		return -1;
+
+	for (i = 0; i < WHEEL_LEVELS; i++)
+		for (j = 0; j < WHEEL_SLOTS; j++)
+			slots[i][j].next = slots[i][j].prev = &slots[i][j];
+
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+	cur = 0;
+
+	return 0;
+
+}
+
+/*
+ * now_tick
+ *
+ * Returns current tick.
+ *
+ */
+
+static unsigned long long now_tick() {
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((now.tv_sec - epoch.tv_sec) * 1000000000LL + 
+			(now.tv_nsec - epoch.tv_nsec)) / 1000000 / WHEEL_TICK;
+
+}
+
+/*
+ * link
+ *
+ * Puts timer in the slot of the finest wheel its expiry fits.
+ *
+ */
+
+static void link_timer(wtimer *t) {
+
+	unsigned long long delta = t->expires > cur ? t->expires - cur : 0;
+	wtimer *slot;
+	int level = 0;
+
+	/* Already due timers go in the next slot */
+	if (!delta) t->expires = cur + 1, delta = 1;
+
+	while (level < WHEEL_LEVELS - 1 && delta >= 1ULL << (WHEEL_BITS * (level + 1))) level++;
+
+	/* Beyond the last wheel, park at its farthest slot and cascade again */
+	if (delta >= 1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+		slot = &slots[level][((cur >> (WHEEL_BITS * level)) - 1) & WHEEL_MASK];
+	else
+		slot = &slots[level][(t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+
+	t->next = slot;
+	t->prev = slot->prev;
+	slot->prev->next = t;
+	slot->prev = t;
+
+}
+
+/*
+ * unlink_timer
+ *
+ * Takes timer out of its list.
+ *
+ */
+
+static void unlink_timer(wtimer *t) {
+
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = t->prev = NULL;
+
+}
+
+/*
+ * splice
+ *
+ * Moves every timer of a slot to a list.
+ *
+ */
+
+static void splice(wtimer *slot, wtimer *list) {
+
+	list->next = list->prev = list;
+
+	if (slot->next == slot) return;
+
+	list->next = slot->next;
+	list->prev = slot->prev;
+	list->next->prev = list;
+	list->prev->next = list;
+
+	slot->next = slot->prev = slot;
+
+}
+
+/*
+ * cascade
+ *
+ * Moves timers of the current slot of a wheel into finer ones.
+ *
+ */
+
+static void cascade(int level) {
+
+	wtimer list, *t;
+
+	splice(&slots[level][(cur >> (WHEEL_BITS * level)) & WHEEL_MASK], &list);
+
+	while ((t = list.next) != &list) {
+
+		unlink_timer(t);
+		link_timer(t);
+
+	}
+
+}
+
+/*
+ * wheel_arm
+ *
+ * Arms timerfd for next occupied slot of first wheel, or its next wrap when
+ * upper wheels may have to cascade. Disarms it if no timer is left.
+ *
+ */
+
+static void wheel_arm() {
+
+	struct itimerspec its;
+	unsigned long long ticks, now = now_tick();
+	int i, wrap = WHEEL_SLOTS - (cur & WHEEL_MASK);
+	wtimer *slot;
+
+	memset(&its, 0, sizeof(its));
+
+	if (npending) {
+
+		for (i = 1; i < wrap; i++) {
+
+			slot = &slots[0][(cur + i) & WHEEL_MASK];
+			if (slot->next != slot) break;
+
+		}
+
+		/* Tick to reach, relative to now as time went by since cur */
+		ticks = cur + i > now ? cur + i - now : 1;
+
+		its.it_value.tv_sec = ticks * WHEEL_TICK / 1000;
+		its.it_value.tv_nsec = (ticks * WHEEL_TICK % 1000) * 1000000;
+
+	}
+
+	timerfd_settime(wheel_fd, 0, &its, NULL);
+
+}
+
+/*
+ * wheel_add
+ *
+ * Starts timer. Callback runs with arg from wheel_run() once ms elapsed,
+ * rounded up to the next tick. Returns -1 if the timerfd could not be
+ * created, the timer would never fire.
+ *
+ */
+
+int wheel_add(wtimer *t, unsigned long ms, void (*fn)(void *arg), void *arg) {
+
+	if (wheel_init()) return -1;
+
+	if (t->next) wheel_cancel(t);
+
+	/* Nothing to cascade, skip ticks that went by idle */
+	if (!npending) cur = now_tick();
+
+	/* Catch up first so expiry is relative to now */
+	t->expires = now_tick() + (ms + WHEEL_TICK - 1) / WHEEL_TICK;
+	t->fn = fn;
+	t->arg = arg;
+
+	link_timer(t);
+	npending++;
+
+	/* Only a first timer or an earlier first wheel slot changes when to
+	 * wake up */
+	if (npending == 1 || t->expires - cur < WHEEL_SLOTS) wheel_arm();
+
+	return 0;
+
+}
+
+/*
+ * wheel_cancel
+ *
+ * Stops pending timer.
+ *
+ */
+
+void wheel_cancel(wtimer *t) {
+
+	if (!t->next) return;
+
+	unlink_timer(t);
+	npending--;
+
+	if (!npending) wheel_arm();
+
+}
+
+/*
+ * wheel_run
+ *
+ * Processes every tick since last run: cascades upper wheels when the first
+ * one wraps and runs timers of each slot in a batch.
+ *
+ */
+
+void wheel_run() {
+
+	unsigned long long expirations, now;
+	wtimer list, *t;
+	int level;
+
+	if (wheel_fd == -1) return;
+
+	/* Clear readiness */
+	if (read(wheel_fd, &expirations, sizeof(expirations)) < 0 && !npending) return;
+
+	now = now_tick();
+
+	while (cur < now) {
+
+		cur++;
+
+		/* First wheel wrapped, pull down next slot of the ones above,
+		 * coarsest first so what it drops in finer wheels cascades too */
+		for (level = 1; level < WHEEL_LEVELS && 
+				!(cur & ((1ULL << (WHEEL_BITS * level)) - 1)); level++);
+
+		while (--level > 0) cascade(level);
+
+		splice(&slots[0][cur & WHEEL_MASK], &list);
+
+		while ((t = list.next) != &list) {
+
+			unlink_timer(t);
+			npending--;
+
+			t->fn(t->arg);
+
+		}
+
+	}
+
+	wheel_arm();
+
+}
+
+/*
+ * wheel_pollfd
+ *
+ * Returns timerfd driving the wheel, -1 if no timer was ever added.
+ *
+ */
+
+int wheel_pollfd() {
+
+	return wheel_fd;
+
+}
+
+/*
+ * wheel_pending
+ *
+ * Returns number of pending timers.
+ *
+ */
+
+long wheel_pending() {
+
+	return npending;
+
+}
@@ -0,0 +1,70 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	wheel.h
+ *
+ * @Description: Hierarchical timer wheel. WHEEL_LEVELS wheels of WHEEL_SLOTS
+ * 		slots each, the first one WHEEL_TICK ms per slot, every next one
+ * 		WHEEL_SLOTS times coarser. A timer goes in the finest wheel its
+ * 		expiry fits, at the slot of its expiry time, so adding and
+ * 		cancelling are O(1) list operations however many timers there
+ * 		are. Each time the first wheel wraps, the next slot of the wheel
+ * 		above is emptied into the finer ones (cascade).
+ *
+ * 		The whole wheel runs off one timerfd. It is armed for the next
+ * 		occupied slot of the first wheel, or for its next wrap if it is
+ * 		empty, and disarmed when no timer is left, so idle stays
+ * 		tickless. When it fires, every tick since the last run is
+ * 		processed and all timers that expired are run in one batch.
+ * 		Callbacks may add or cancel timers.
+ *
+ * @Constants:
+ *
+ * 	WHEEL_TICK	Resolution in ms
+ *
+ * 	WHEEL_BITS	Slots per wheel, as a power of two
+ *
+ * 	WHEEL_LEVELS	Number of wheels
+ *
+ * @Functions:
+ *
+ * 	wheel_add	Starts a timer, callback runs in ms milliseconds.
+ * 			Returns -1 if the wheel could not be set up.
+ *
+ * 	wheel_cancel	Stops a timer that did not fire yet.
+ *
+ * 	wheel_run	Runs expired timers and rearms the timerfd.
+ *
+ * 	wheel_pollfd	Returns the timerfd, readable once timers are due.
+ *
+ * 	wheel_pending	Returns number of timers not fired yet.
+ *
+ */
+
+#define __wheel_h_
+
+#define WHEEL_TICK	1
+#define WHEEL_BITS	8
+#define WHEEL_SLOTS	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS	4
+
+typedef struct wtimer wtimer;
+
+struct wtimer {
+	wtimer			*next;		/* NULL if not pending */
+	wtimer			*prev;
+	unsigned long long	expires;	/* Tick it fires at */
+	void			(*fn)(void *arg);
+	void			*arg;
+};
+
+int wheel_add(wtimer *t, unsigned long ms, void (*fn)(void *arg), void *arg);
+
+void wheel_cancel(wtimer *t);
+
+void wheel_run();
+
+int wheel_pollfd();
+
+long wheel_pending();
+
@@ -0,0 +1,396 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	zygote
+ *
+ * @Description: Prefork pool
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+#include "zygote.h"
+#include "proc.h"
+
+#ifndef __output_h_
+	#include "output.h"
+#endif
+
+#ifndef __topo_h_
+	#include "topo.h"
+#endif
+
+/* Room for a placement, checked against topo_place_size */
+#define ZYGOTE_PLACE	256
+
+/* Seconds to wait for a worker before forking instead */
+#define ZYGOTE_WAIT	1
+
+/* Ms without launches before the pool is refilled */
+#define ZYGOTE_QUIET	20
+
+typedef struct zreq {
+	int		exec;			/* 0 to spawn, 1 to exec */
+	int		placed;			/* 0 to inherit placement */
+	unsigned long	place[ZYGOTE_PLACE / sizeof(long)];
+	char		name[32];
+	int		argc;
+	char		args[ZYGOTE_ARGS];	/* Arguments of exec */
+} zreq;
+
+typedef struct zreply {
+	int	pid;				/* -1 if not launched */
+	int	cfd;				/* Read end of pipe in worker */
+} zreply;
+
+int zygote_pid = 0;
+
+/* Scheduler end of socket to workers */
+static int zsock = -1;
+
+/* Workers waiting for a request, shared by all */
+static volatile int *idle;
+
+/*
+ * send_fds
+ *
+ * Sends message with descriptors attached. Returns -1 on failure.
+ *
+ */
+
+static int send_fds(int sock, void *buf, int len, int *fds, int nfds) {
+
+	char cbuf[CMSG_SPACE(2 * sizeof(int))];
+	struct iovec iov = {buf, len};
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+
+	return sendmsg(sock, &msg, MSG_NOSIGNAL) == len ? 0 : -1;
+
+}
+
+/*
+ * recv_fds
+ *
+ * Receives message and the two descriptors attached to it, -1 for missing
+ * ones. Returns length of message, 0 once the other end is closed.
+ *
+ */
+
+static int recv_fds(int sock, void *buf, int len, int *fds) {
+
+	char cbuf[CMSG_SPACE(2 * sizeof(int))];
+	struct iovec iov = {buf, len};
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int n;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	fds[0] = fds[1] = -1;
+
+	if ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) <= 0) return n;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(fds, CMSG_DATA(cmsg), 2 * sizeof(int));
+
+	return n;
+
+}
+
+/*
+ * worker
+ *
+ * Waits to be handed a request, then becomes the process asked for.
+ *
+ */
+
+static void worker(int sock, int taken, int spid) {
+
+	char *argv[ZYGOTE_ARGS / 2 + 1], *p;
+	zreq req;
+	zreply rep;
+	int fds[2], i, n;
+
+	/* Descriptors of the zygote would keep it from seeing the scheduler go */
+	out_child(sock, taken);
+
+	/* Can't be waited for by the scheduler until orphaned */
+	while (getppid() != spid) {
+
+		if (kill(spid, 0)) _exit(0);
+		usleep(100);
+
+	}
+
+	/* Idle workers all wait on the same socket, one gets the request */
+	__sync_fetch_and_add(idle, 1);
+
+	n = recv_fds(sock, &req, sizeof(req), fds);
+
+	__sync_fetch_and_sub(idle, 1);
+
+	if (n != sizeof(req) || fds[1] == -1) _exit(0);
+
+	/* Pipe descriptors were renumbered on the way. A scheduler that gave
+	 * up waiting is not answered */
+	rep.pid = getpid();
+	rep.cfd = fds[0];
+
+	if (send(sock, &rep, sizeof(rep), MSG_NOSIGNAL) != sizeof(rep)) _exit(0);
+
+	/* Zygote forks a replacement */
+	write(taken, "", 1);
+
+	if (!req.exec)
+		spawn_child(req.name, fds, req.placed ? (struct placement *)req.place : NULL);
+
+	for (i = 0, p = req.args; i < req.argc; i++, p += strlen(p) + 1) argv[i] = p;
+	argv[i] = NULL;
+
+	exec_child(argv, fds, req.placed ? (struct placement *)req.place : NULL);
+
+}
+
+/*
+ * refill
+ *
+ * Forks a worker through an intermediate process, so it ends up a child of
+ * the scheduler.
+ *
+ */
+
+static void refill(int sock, int taken, int spid) {
+
+	int mid;
+
+	if (!(mid = fork())) {
+
+		if (!fork()) worker(sock, taken, spid);
+
+		_exit(0);
+
+	}
+
+	if (mid != -1) waitpid(mid, NULL, 0);
+
+}
+
+/*
+ * zygote
+ *
+ * Main loop of the zygote. Forks a worker for every one taken, once launches
+ * went quiet for ZYGOTE_QUIET ms, so forking does not compete with a burst
+ * for cpu. The scheduler forks by itself while the pool is dry. Exits once
+ * the scheduler closes its end.
+ *
+ */
+
+static void zygote(int sock, int n) {
+
+	struct pollfd pfds[2];
+	int spid = getppid(), taken[2], owed = 0, i;
+	char buf[ZYGOTE_MAX];
+	ssize_t len;
+
+	signal(SIGHUP, SIG_IGN);
+
+	out_child(sock, sock);
+
+	if (pipe(taken) == -1) _exit(0);
+
+	for (i = 0; i < n; i++) refill(sock, taken[1], spid);
+
+	/* Requests on the socket are for the workers, only watch for hangup */
+	pfds[0].fd = sock;
+	pfds[0].events = 0;
+	pfds[1].fd = taken[0];
+	pfds[1].events = POLLIN;
+
+	while (1) {
+
+		if (poll(pfds, 2, owed ? ZYGOTE_QUIET : -1) < 0) continue;
+
+		if (pfds[0].revents) _exit(0);
+
+		if (pfds[1].revents && (len = read(taken[0], buf, sizeof(buf))) > 0) {
+
+			owed += len;
+			continue;
+
+		}
+
+		for (; owed > 0; owed--) refill(sock, taken[1], spid);
+
+	}
+
+}
+
+/*
+ * zygote_init
+ *
+ * Makes scheduler a subreaper and forks zygote.
+ *
+ */
+
+int zygote_init(int n) {
+
+	struct timeval tv = {ZYGOTE_WAIT, 0};
+	int sv[2];
+
+	if (n < 1 || n > ZYGOTE_MAX) {
+
+		sprintf(errstr, "ERROR: Pool size must be 1 to %d.", ZYGOTE_MAX);
+		return -1;
+
+	}
+
+	idle = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (idle == MAP_FAILED || topo_place_size > ZYGOTE_PLACE || 
+			prctl(PR_SET_CHILD_SUBREAPER, 1) == -1 ||
+			socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+
+		sprintf(errstr, "ERROR: Could not start zygote.");
+		return -1;
+
+	}
+
+	if (!(zygote_pid = fork())) {
+
+		close(sv[0]);
+		zygote(sv[1], n);
+
+	}
+
+	close(sv[1]);
+
+	if (zygote_pid == -1) {
+
+		close(sv[0]);
+		sprintf(errstr, "ERROR: Could not start zygote.");
+		return -1;
+
+	}
+
+	/* Don't hang on a zygote that stopped refilling */
+	setsockopt(sv[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	zsock = sv[0];
+
+	return 0;
+
+}
+
+/*
+ * abandon
+ *
+ * Drops the pool once a worker did not answer in time. Replies are refused
+ * first, so a worker that did not answer yet exits instead of becoming the
+ * process. One that answered meanwhile already is, unknown to the scheduler
+ * and stopped for good, so it is killed and reaped.
+ *
+ */
+
+static void abandon() {
+
+	zreply rep;
+
+	shutdown(zsock, SHUT_RD);
+
+	if (recv(zsock, &rep, sizeof(rep), MSG_DONTWAIT) == sizeof(rep) && rep.pid > 0) {
+
+		kill(rep.pid, SIGKILL);
+		while (waitpid(rep.pid, NULL, 0) == -1 && errno == EINTR);
+
+	}
+
+	close(zsock);
+	zsock = -1;
+
+}
+
+/*
+ * zygote_launch
+ *
+ * Sends request to the pool. If no worker answers in time, the pool is
+ * dropped and processes are forked from then on.
+ *
+ */
+
+int zygote_launch(char *name, char **argv, int pfd[2], struct placement *place, int *cfd) {
+
+	zreq req;
+	zreply rep;
+	int len = 0, i;
+
+	/* Pool ran dry, forking beats waiting for a refill */
+	if (zsock == -1 || *idle <= 0) return -1;
+
+	memset(&req, 0, sizeof(req));
+	strncpy(req.name, name, sizeof(req.name) - 1);
+
+	if (place) {
+
+		memcpy(req.place, place, topo_place_size);
+		req.placed = 1;
+
+	}
+
+	/* Arguments that don't fit are left to fork */
+	for (i = 0; argv && argv[i]; i++) {
+
+		if (len + strlen(argv[i]) + 1 > ZYGOTE_ARGS) return -1;
+
+		strcpy(req.args + len, argv[i]);
+		len += strlen(argv[i]) + 1;
+
+	}
+
+	req.exec = argv != NULL;
+	req.argc = i;
+
+	/* The clock interrupt may cut the wait short */
+	while ((i = send_fds(zsock, &req, sizeof(req), pfd, 2)) && errno == EINTR);
+	while (!i && (i = recv(zsock, &rep, sizeof(rep), 0)) == -1 && errno == EINTR);
+
+	if (i != sizeof(rep)) {
+
+		abandon();
+		return -1;
+
+	}
+
+	*cfd = rep.cfd;
+
+	return rep.pid;
+
+}
+
@@ -0,0 +1,54 @@
+/*
+ * @Author:	Jeff Berube
+ * @Title:	zygote.h
+ *
+ * @Description: Prefork pool. With -z, the scheduler forks a small helper,
+ * 		the zygote, once at startup. The zygote keeps a pool of
+ * 		workers forked ahead of time, all waiting on the same socket
+ * 		to the scheduler. A spawn or exec sends the request on it
+ * 		along with the output pipe (SCM_RIGHTS). The kernel hands it
+ * 		to one idle worker, which answers with its pid and becomes
+ * 		the new process. It tells the zygote through a pipe, and the
+ * 		zygote forks a replacement in the background. Launching then
+ * 		costs a message each way instead of a fork of the scheduler.
+ *
+ * 		Workers are forked through an intermediate process that exits
+ * 		right away. The scheduler is a child subreaper, so orphaned
+ * 		workers become its children and are waited for and reaped
+ * 		like forked ones. A worker only reports ready once that
+ * 		happened.
+ *
+ * 		Without a pool, when no worker is idle, the zygote is gone or
+ * 		a request does not fit in a message, processes are forked as
+ * 		before.
+ *
+ * @Constants:
+ *
+ * 	ZYGOTE_MAX	Largest pool
+ *
+ * 	ZYGOTE_ARGS	Room for arguments of an exec, NUL separated
+ *
+ * @Functions:
+ *
+ * 	zygote_init	Starts zygote with n workers. Returns 0 on success,
+ * 			-1 with error set otherwise.
+ *
+ * 	zygote_launch	Hands a spawn, or an exec if argv is not NULL, to a
+ * 			worker. Returns its pid and the number it knows the
+ * 			read end of the pipe by, -1 to fork instead.
+ *
+ */
+
+#define __zygote_h_
+
+#define ZYGOTE_MAX	64
+#define ZYGOTE_ARGS	2048
+
+struct placement;
+
+extern int zygote_pid;
+
+int zygote_init(int n);
+
+int zygote_launch(char *name, char **argv, int pfd[2], struct placement *place, int *cfd);
+